@@ -0,0 +1,34 @@
+#pragma once
+// Counts heap allocations by replacing the global operator new. Include it
+// from exactly one file of a benchmark binary.
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+inline std::atomic<uint64_t> allocations{0};
+inline std::atomic<uint64_t> allocatedBytes{0};
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+// The only delete that frees; kept out of line, or GCC sees free() applied
+// to the result of operator new where it is inlined
+[[gnu::noinline]] void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p) noexcept {
+    ::operator delete(p);
+}
+void operator delete(void* p, size_t) noexcept {
+    ::operator delete(p);
+}
+void operator delete[](void* p, size_t) noexcept {
+    ::operator delete(p);
+}
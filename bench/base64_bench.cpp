@@ -0,0 +1,68 @@
+// Decodes the same base64 payload with the OpenSSL BIO chain utils.cpp
+// used to build per field and with the vectorized decoder, and reports
+// throughput for each.
+#include "base64.hpp"
+#include <openssl/bio.h>
+#include <openssl/evp.h>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::vector<unsigned char> bioDecode(const std::string& input) {
+    BIO* bio = BIO_new_mem_buf(input.data(), input.size());
+    BIO* b64 = BIO_new(BIO_f_base64());
+    BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
+    bio = BIO_push(b64, bio);
+
+    std::vector<unsigned char> output(input.size());
+    int len = BIO_read(bio, output.data(), input.size());
+    output.resize(len);
+
+    BIO_free_all(bio);
+    return output;
+}
+
+template <typename F>
+static double bestMBps(size_t bytes, int rounds, F&& decode) {
+    double best = 0;
+    for (int r = 0; r < rounds; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        decode();
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, bytes / sec / 1e6);
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4 << 20;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    std::mt19937 rng(42);
+    std::vector<unsigned char> raw(size);
+    for (auto& b : raw) b = static_cast<unsigned char>(rng());
+    std::string encoded(4 * ((size + 2) / 3), '\0');
+    EVP_EncodeBlock(reinterpret_cast<unsigned char*>(encoded.data()), raw.data(), static_cast<int>(size));
+
+    std::vector<unsigned char> out(base64MaxDecodedSize(encoded.size()));
+    if (bioDecode(encoded) != raw ||
+        base64Decode(encoded.data(), encoded.size(), out.data()) != size ||
+        !std::equal(raw.begin(), raw.end(), out.begin())) {
+        std::cerr << "decoders disagree\n";
+        return 1;
+    }
+
+    double bio = bestMBps(encoded.size(), rounds, [&] { bioDecode(encoded); });
+    double fast = bestMBps(encoded.size(), rounds, [&] { base64Decode(encoded.data(), encoded.size(), out.data()); });
+
+    std::cout << "base64 decode, " << encoded.size() << " chars, best of " << rounds << "\n"
+              << std::fixed << std::setprecision(0)
+              << "  openssl BIO      " << std::setw(8) << bio << " MB/s\n"
+              << "  " << std::left << std::setw(16) << base64KernelName() << std::right << " "
+              << std::setw(8) << fast << " MB/s  (" << std::setprecision(1) << fast / bio << "x)\n";
+    return 0;
+}
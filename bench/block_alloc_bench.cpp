@@ -0,0 +1,78 @@
+// Decrypts and parses a run of synthetic blocks, with and without the arena
+// chunk pool, and counts the heap allocations each block costs by replacing
+// the global operator new. Only the second pass over the blocks counts, so
+// that the pool, the heap and the thread pool are warm.
+#include "alloc_count.hpp"
+#include "synthetic_block.hpp"
+#include "config.hpp"
+#include "decryptor.hpp"
+#include "keyring.hpp"
+#include "log_record.hpp"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Runs in a child process, so that each setting gets a fresh pool
+static void measure(const char* label, const std::vector<std::string>& envelopes, const std::string& keyFile) {
+    Keyring keyring;
+    keyring.addKeyFile(keyFile);
+    uint64_t count = 0, bytes = 0;
+    double ms = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        count = bytes = 0;
+        ms = 0;
+        for (const auto& envelope : envelopes) {
+            uint64_t before = allocations, beforeBytes = allocatedBytes;
+            auto start = std::chrono::steady_clock::now();
+            {
+                BlockPayload payload = decryptBlock(envelope, keyring);
+                LogArena arena;
+                std::vector<LogRecord> records = parseAndSortLogs(payload.logs, arena);
+            }
+            ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            count += allocations - before;
+            bytes += allocatedBytes - beforeBytes;
+        }
+    }
+    double blocks = static_cast<double>(envelopes.size());
+    ChunkPool::Stats pool = ChunkPool::instance().stats();
+    std::cout << std::fixed << std::setprecision(1) << "  " << std::left << std::setw(16) << label << std::right
+              << std::setw(10) << count / blocks << std::setw(14) << std::setprecision(2) << bytes / blocks / 1e6
+              << std::setw(11) << ms / blocks << "   " << pool.reused << " of " << pool.taken
+              << " chunks reused\n";
+}
+
+int main(int argc, char** argv) {
+    size_t blocks = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8;
+    size_t logs = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+
+    SyntheticKey key;
+    unsigned char aesKey[32];
+    RAND_bytes(aesKey, sizeof(aesKey));
+    std::vector<std::string> envelopes;
+    for (size_t b = 0; b < blocks; ++b) {
+        envelopes.push_back(syntheticEnvelope(syntheticPlaintext(logs, b), key.pkey, aesKey).json);
+    }
+
+    std::cout << blocks << " blocks of " << logs << " logs, " << std::fixed << std::setprecision(1)
+              << envelopes[0].size() / 1e6 << " MB envelopes, decrypted and parsed\n"
+              << "                   allocs/block  heap MB/block  ms/block\n"
+              << std::flush;
+    for (int pooled = 0; pooled < 2; ++pooled) {
+        pid_t child = fork();
+        if (child == 0) {
+            Config::performance.arena_pool_mb = pooled ? 64 : 0;
+            measure(pooled ? "arena pool" : "no arena pool", envelopes, key.path());
+            std::fflush(stdout);
+            _exit(0);
+        }
+        waitpid(child, nullptr, 0);
+    }
+    return 0;
+}
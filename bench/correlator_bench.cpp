@@ -0,0 +1,112 @@
+// Streams synthetic records, newest first as a chain walk delivers them,
+// through the Correlator and through a map of per-key timestamp deques that
+// stores every event in the window, and compares throughput and memory.
+// Then checks that a second walk over newer blocks, as a watch round after
+// the initial sync, still fires alerts; exits 1 if it does not.
+#include "correlator.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000000;
+    size_t sourceCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    Correlator::Options options{5, 300, true, 100, 60, true};
+
+    std::vector<std::string> sources;
+    for (size_t i = 0; i < sourceCount; ++i) sources.push_back("10." + std::to_string(i >> 16) + "." +
+                                                                std::to_string((i >> 8) & 255) + "." + std::to_string(i & 255));
+    uint16_t types[] = {internLogType("auth"), internLogType("app"), internLogType("kernel"), internLogType("net")};
+    static const uint16_t threat[] = {7};
+
+    // 1000 events per second, one in 20 tagged with a threat rule; sources
+    // are skewed so a few are noisy enough to trip the limits
+    std::mt19937_64 rng(5);
+    std::vector<LogRecord> records(count);
+    int64_t now = 1700000000 + static_cast<int64_t>(count / 1000);
+    for (size_t i = 0; i < count; ++i) {
+        LogRecord& r = records[i];
+        r.timestamp = now - static_cast<int64_t>(i / 1000);
+        size_t s = rng() % 8 ? rng() % sourceCount : rng() % 16;
+        r.source = sources[s];
+        r.typeId = types[rng() % 4];
+        r.fields = LogRecord::Timestamp | LogRecord::Source | LogRecord::Type;
+        if (rng() % 20 == 0) {
+            r.patterns = threat;
+            r.patternCount = 1;
+        }
+    }
+
+    Correlator correlator(options);
+    std::vector<Correlator::Alert> alerts;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& r : records) correlator.observe(r, alerts);
+    double tCorrelator = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    auto st = correlator.stats();
+
+    // Exact windows: every event timestamp kept until it leaves the window
+    std::unordered_map<std::string, std::deque<int64_t>> attempts, requests;
+    uint64_t exactAlerts = 0;
+    size_t peakEvents = 0, liveEvents = 0;
+    auto slide = [&](std::deque<int64_t>& q, int64_t t, uint32_t window, uint32_t limit) {
+        while (!q.empty() && q.front() - t >= window) {
+            q.pop_front();
+            --liveEvents;
+        }
+        q.push_back(t);
+        ++liveEvents;
+        exactAlerts += q.size() == limit;
+    };
+    start = std::chrono::steady_clock::now();
+    for (const auto& r : records) {
+        std::string source(r.source);
+        if (r.patternCount) slide(attempts[std::to_string(r.patterns[0]) + "|" + source], r.timestamp, 300, 5);
+        slide(requests[std::to_string(r.typeId) + "|" + source], r.timestamp, 60, 100);
+        peakEvents = std::max(peakEvents, liveEvents);
+    }
+    double tExact = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t keys = attempts.size() + requests.size();
+    // Rough: node, key string and one deque map and chunk per key, 8 bytes per event
+    double exactBytes = keys * (64.0 + 32 + 64 + 512) + peakEvents * 8.0;
+
+    std::cout << count << " events from " << sourceCount << " sources over " << count / 1000 << " s\n" << std::fixed
+              << std::setprecision(2) << "  correlator      " << std::setw(7) << count / tCorrelator / 1e6
+              << " M events/s  " << std::setw(8) << st.memoryBytes / 1048576.0 << " MiB  " << st.alerts << " alerts, "
+              << st.keys << " keys live at the end\n"
+              << "  exact deques    " << std::setw(7) << count / tExact / 1e6 << " M events/s  " << std::setw(8)
+              << exactBytes / 1048576.0 << " MiB  " << exactAlerts << " threshold crossings, " << keys
+              << " keys never freed, " << peakEvents << " events held at peak\n";
+
+    // One source failing every second, walked newest first twice, the
+    // second time from a head 10000 s newer
+    Correlator rounds(options);
+    std::string source = "10.9.9.9";
+    auto walk = [&](int64_t newest) {
+        rounds.beginWalk();
+        auto before = rounds.stats();
+        for (int64_t i = 0; i < 1000; ++i) {
+            LogRecord r;
+            r.timestamp = newest - i;
+            r.source = source;
+            r.typeId = types[0];
+            r.fields = LogRecord::Timestamp | LogRecord::Source | LogRecord::Type;
+            r.patterns = threat;
+            r.patternCount = 1;
+            rounds.observe(r, alerts);
+        }
+        auto after = rounds.stats();
+        return std::make_pair(after.alerts - before.alerts, after.late - before.late);
+    };
+    auto first = walk(1700010000);
+    auto second = walk(1700020000);
+    std::cout << "  two walks, the second newer: " << first.first << " then " << second.first << " alerts, "
+              << first.second << " then " << second.second << " events late\n";
+    return second.first && !second.second ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+// Parses a multi-megabyte block plaintext {"logs": ["...", ...], "prev_cid":
+// "..."} the old way, as nlohmann::json DOMs of the plaintext and of every
+// log, and the current way, validated as UTF-8 and streamed through
+// JsonStreamScanner into an arena, then parsed into LogRecords. Also times
+// the string scanning and UTF-8 validation against plain byte loops.
+#include "json_scan.hpp"
+#include "json_stream.hpp"
+#include "log_arena.hpp"
+#include "log_record.hpp"
+#include "json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Keeps the optimizer from dropping the work being timed
+static volatile size_t sink;
+
+static std::string makePlaintext(size_t count) {
+    static const char* types[] = {"auth", "net", "kernel", "app"};
+    static const char* messages[] = {"failed login for user root from 10.0.0.", "connection refused on port ",
+                                     "Permission Denied for /etc/shadow ", "ssh login failed \\\"quoted\\\" ",
+                                     "unicode \\u00e9\\u4e2d ", "utf-8 caf\xc3\xa9 \xe4\xb8\xad\xe6\x96\x87 "};
+    std::mt19937 rng(7);
+    nlohmann::json logs = nlohmann::json::array();
+    for (size_t i = 0; i < count; ++i) {
+        size_t id = rng() % 1000000;
+        std::string line = "{\"event_id\": " + std::to_string(id) + ", \"type\": \"" + types[rng() % 4] +
+                           "\", \"message\": \"" + messages[rng() % 6] + std::to_string(id) +
+                           "\", \"timestamp\": " + std::to_string(1700000000 + id) + ", \"source\": \"host" +
+                           std::to_string(id % 5) + "\"";
+        if (id % 7 == 0) line += ", \"extra\": {\"nested\": [1, 2, {\"a\": \"b\"}]}";
+        logs.push_back(line + "}");
+    }
+    return nlohmann::json{{"logs", logs}, {"prev_cid", "QmPrevious"}}.dump();
+}
+
+class LogCollector : public JsonStreamScanner::Handler {
+public:
+    void beginString(const std::string& key, bool inArray) override {
+        inLog_ = key == "logs" && inArray;
+        if (inLog_) arena.beginString();
+    }
+    void stringData(const char* data, size_t len) override {
+        if (inLog_) arena.appendString(data, len);
+    }
+    void endString() override {
+        if (inLog_) logs.push_back(arena.endString());
+    }
+
+    LogArena arena;
+    std::vector<std::string_view> logs;
+
+private:
+    bool inLog_ = false;
+};
+
+static const char* naiveFindSpecial(const char* p, const char* end) {
+    for (; p < end; ++p) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\' || c < 0x20) return p;
+    }
+    return end;
+}
+
+static bool naiveValidUtf8(std::string_view text) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        if (static_cast<unsigned char>(*p) < 0x80) {
+            ++p;
+            continue;
+        }
+        size_t length = utf8SequenceLength(p, end);
+        if (!length) return false;
+        p += length;
+    }
+    return true;
+}
+
+// Best of a few runs, in MB/s of input
+template <typename F>
+static double throughput(size_t bytes, F&& run) {
+    double best = 0;
+    for (int i = 0; i < 3; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, bytes / s / 1e6);
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50000;
+    std::string plaintext = makePlaintext(count);
+    size_t bytes = plaintext.size();
+
+    double dom = throughput(bytes, [&] {
+        auto payload = nlohmann::json::parse(plaintext);
+        std::vector<nlohmann::json> logs;
+        for (const auto& line : payload["logs"]) logs.push_back(nlohmann::json::parse(line.get<std::string>()));
+        sink = logs.size();
+    });
+
+    double streamed = throughput(bytes, [&] {
+        LogCollector collector;
+        JsonStreamScanner scanner(collector);
+        Utf8Validator utf8;
+        // Fed as the decryptor does, in its chunk size
+        for (size_t i = 0; i < bytes; i += 64 * 1024) {
+            size_t n = std::min<size_t>(64 * 1024, bytes - i);
+            if (!utf8.feed(plaintext.data() + i, n)) std::abort();
+            scanner.feed(plaintext.data() + i, n);
+        }
+        if (!utf8.finish()) std::abort();
+        scanner.finish();
+        LogArena arena;
+        sink = parseAndSortLogs(collector.logs, arena).size();
+    });
+
+    const char* begin = plaintext.data();
+    const char* end = begin + bytes;
+    auto scanWith = [&](auto find) {
+        return throughput(bytes, [&] {
+            size_t stops = 0;
+            for (const char* p = begin; (p = find(p, end)) < end; ++p) ++stops;
+            sink = stops;
+        });
+    };
+    double scalarScan = scanWith(naiveFindSpecial);
+    double simdScan = scanWith([](const char* p, const char* e) { return findStringSpecial(p, e); });
+    double scalarUtf8 = throughput(bytes, [&] { sink = naiveValidUtf8(plaintext); });
+    double simdUtf8 = throughput(bytes, [&] { sink = isValidUtf8(plaintext); });
+
+    std::cout << "block plaintext of " << count << " logs, " << std::fixed << std::setprecision(1) << bytes / 1e6
+              << " MB\n"
+              << "  nlohmann::json DOMs      " << std::setw(8) << dom << " MB/s\n"
+              << "  stream + LogRecord       " << std::setw(8) << streamed << " MB/s  (" << streamed / dom << "x)\n"
+              << "  string scan, bytewise    " << std::setw(8) << scalarScan << " MB/s\n"
+              << "  string scan, 16 at once  " << std::setw(8) << simdScan << " MB/s  (" << simdScan / scalarScan
+              << "x)\n"
+              << "  UTF-8 check, bytewise    " << std::setw(8) << scalarUtf8 << " MB/s\n"
+              << "  UTF-8 check, 16 at once  " << std::setw(8) << simdUtf8 << " MB/s  (" << simdUtf8 / scalarUtf8
+              << "x)\n";
+    return 0;
+}
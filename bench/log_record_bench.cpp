@@ -0,0 +1,81 @@
+// Parses and sorts the same block of inner logs into nlohmann::json DOMs
+// (the old representation) and into LogRecords, and reports time and heap
+// bytes per record for each.
+#include "log_record.hpp"
+#include "json.hpp"
+#include <malloc.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static size_t heapInUse() {
+    return mallinfo2().uordblks;
+}
+
+static std::vector<std::string> makeLines(size_t count) {
+    static const char* types[] = {"auth", "net", "kernel", "app"};
+    static const char* messages[] = {"failed login for user root from 10.0.0.", "connection refused on port ",
+                                     "Permission Denied for /etc/shadow ", "ssh login failed \\\"quoted\\\" ",
+                                     "unicode \\u00e9\\u4e2d "};
+    std::mt19937 rng(7);
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < count; ++i) {
+        size_t id = rng() % 1000000;
+        std::string line = "{\"event_id\": " + std::to_string(id) + ", \"type\": \"" + types[rng() % 4] +
+                           "\", \"message\": \"" + messages[rng() % 5] + std::to_string(id) +
+                           "\", \"timestamp\": " + std::to_string(1700000000 + id) + ", \"source\": \"host" +
+                           std::to_string(id % 5) + "\"";
+        if (id % 7 == 0) line += ", \"extra\": {\"nested\": [1, 2, {\"a\": \"b\"}]}";
+        lines.push_back(line + "}");
+    }
+    return lines;
+}
+
+struct Result {
+    double ms;
+    double bytesPerRecord;
+};
+
+template <typename F>
+static Result measure(size_t count, F&& run) {
+    size_t before = heapInUse();
+    auto start = std::chrono::steady_clock::now();
+    auto kept = run();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    double bytes = static_cast<double>(heapInUse() - before) / count;
+    return {ms, bytes};
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    auto lines = makeLines(count);
+    std::vector<std::string_view> views(lines.begin(), lines.end());
+
+    Result dom = measure(count, [&] {
+        std::vector<nlohmann::json> logs;
+        for (const auto& s : lines) logs.push_back(nlohmann::json::parse(s));
+        std::sort(logs.begin(), logs.end(), [](const auto& a, const auto& b) { return a["event_id"] > b["event_id"]; });
+        return logs;
+    });
+
+    Result compact = measure(count, [&] {
+        auto arena = std::make_unique<LogArena>();
+        auto records = parseAndSortLogs(views, *arena);
+        return std::make_pair(std::move(arena), std::move(records));
+    });
+
+    std::cout << "parse + sort " << count << " logs\n"
+              << std::fixed << std::setprecision(1)
+              << "  nlohmann::json  " << std::setw(8) << dom.ms << " ms  " << std::setw(7) << dom.bytesPerRecord
+              << " B/record\n"
+              << "  LogRecord       " << std::setw(8) << compact.ms << " ms  " << std::setw(7)
+              << compact.bytesPerRecord << " B/record\n"
+              << "  speedup " << dom.ms / compact.ms << "x, memory " << dom.bytesPerRecord / compact.bytesPerRecord
+              << "x smaller\n";
+    return 0;
+}
@@ -0,0 +1,59 @@
+// Sorts the same records with the previous comparison sort and with the
+// radix sort, for random, already sorted and reversed input.
+#include "log_record.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+static std::vector<LogRecord> makeRecords(size_t count) {
+    std::mt19937_64 rng(11);
+    std::vector<LogRecord> records(count);
+    for (auto& r : records) {
+        r.eventId = static_cast<int64_t>(rng() % 100000000);
+        r.timestamp = 1700000000 + r.eventId;
+        r.fields = LogRecord::EventId | LogRecord::Timestamp;
+    }
+    return records;
+}
+
+static void comparisonSort(std::vector<LogRecord>& records) {
+    std::sort(records.begin(), records.end(), [](const LogRecord& a, const LogRecord& b) {
+        bool ha = a.has(LogRecord::EventId), hb = b.has(LogRecord::EventId);
+        if (ha != hb) return ha;
+        return a.eventId > b.eventId;
+    });
+}
+
+template <typename F>
+static double timeSort(const std::vector<LogRecord>& input, F&& sort) {
+    double best = 1e300;
+    for (int rep = 0; rep < 5; ++rep) {
+        auto records = input;
+        auto start = std::chrono::steady_clock::now();
+        sort(records);
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    auto random = makeRecords(count);
+    auto sorted = random;
+    sortLogRecords(sorted);
+    auto reversed = sorted;
+    std::reverse(reversed.begin(), reversed.end());
+
+    std::cout << "sort " << count << " records (best of 5)\n" << std::fixed << std::setprecision(2);
+    for (auto [name, input] : {std::pair{"random", &random}, {"sorted", &sorted}, {"reversed", &reversed}}) {
+        double cmp = timeSort(*input, comparisonSort);
+        double radix = timeSort(*input, sortLogRecords);
+        std::cout << "  " << std::left << std::setw(9) << name << std::right << "  std::sort " << std::setw(8) << cmp
+                  << " ms  radix " << std::setw(8) << radix << " ms  " << cmp / radix << "x\n";
+    }
+    return 0;
+}
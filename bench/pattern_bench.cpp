@@ -0,0 +1,105 @@
+// Scans the same messages for LoggingConfig::default_patterns with a naive
+// lowercase-and-std::string::find loop and with PatternMatcher, for short
+// log-sized messages and for long texts, of prose and of machine tokens.
+#include "pattern_matcher.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static const std::vector<std::string> kProse = {
+    "user", "session", "request", "completed", "from", "host", "GET", "/api/v1/items", "status=200", "latency", "ms",
+    "worker", "queue", "backend", "cache", "hit", "Connection", "established", "to", "node-17", "bytes", "sent", "OK",
+    "retrying"};
+
+// Machine-generated tokens, where the prefilter finds few candidates
+static const std::vector<std::string> kTokens = {
+    "0x7f3a9c21", "4096", "trace=9b2e41d0c7", "200", "1700001500", "10.0.3.17:8443", "#5521", "=", "[3/8]",
+    "9f86d081884c7d65", "->", "+1.25", "/", "2023-11-14T22:13:20Z", "(0)", "17"};
+
+// Messages of words from vocabulary; one in hitEvery contains a random pattern
+static std::vector<std::string> makeMessages(size_t count, size_t words, size_t hitEvery,
+                                             const std::vector<std::string>& vocabulary,
+                                             const std::vector<std::string>& patterns) {
+    std::mt19937 rng(13);
+    std::vector<std::string> messages(count);
+    for (size_t m = 0; m < count; ++m) {
+        std::string& s = messages[m];
+        for (size_t w = 0; w < words; ++w) {
+            s += vocabulary[rng() % vocabulary.size()];
+            s += ' ';
+        }
+        s += std::to_string(rng());
+        if (hitEvery && m % hitEvery == 0) {
+            s.insert(rng() % s.size(), " " + patterns[rng() % patterns.size()] + " ");
+        }
+    }
+    return messages;
+}
+
+static size_t naiveScan(const std::vector<std::string>& patterns, const std::string& message) {
+    std::string lowered(message);
+    for (auto& c : lowered) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    size_t found = 0;
+    for (const auto& p : patterns) {
+        found += lowered.find(p) != std::string::npos;
+    }
+    return found;
+}
+
+// Best of 5, in GB/s of message text; sink keeps the work from being dropped
+template <typename F>
+static double throughput(const std::vector<std::string>& messages, F&& scan, size_t& sink) {
+    size_t bytes = 0;
+    for (const auto& m : messages) bytes += m.size();
+    double best = 1e300;
+    for (int rep = 0; rep < 5; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& m : messages) sink += scan(m);
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return bytes / best / 1e9;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    std::vector<std::string> patterns;
+    for (auto p : Config::logging.default_patterns) {
+        for (auto& c : p) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        patterns.push_back(std::move(p));
+    }
+    PatternMatcher matcher(patterns);
+    std::vector<uint16_t> ids;
+    size_t sink = 0;
+
+    std::cout << matcher.size() << " patterns, prefilter " << PatternMatcher::kernelName() << "\n"
+              << std::fixed << std::setprecision(3);
+    struct Case {
+        const char* name;
+        size_t count, words, hitEvery;
+        const std::vector<std::string>* vocabulary;
+    };
+    for (const Case& c : {Case{"prose, 1% hits", count, 12, 100, &kProse}, Case{"prose, no hits", count, 12, 0, &kProse},
+                          Case{"prose 4 KiB, 1 hit", count / 50, 600, 1, &kProse},
+                          Case{"tokens, 1% hits", count, 12, 100, &kTokens},
+                          Case{"tokens 4 KiB, 1 hit", count / 50, 600, 1, &kTokens}}) {
+        auto messages = makeMessages(c.count, c.words, c.hitEvery, *c.vocabulary, patterns);
+        double naive = throughput(messages, [&](const std::string& m) { return naiveScan(patterns, m); }, sink);
+        double ac = throughput(messages, [&](const std::string& m) {
+            matcher.match(m, ids);
+            return ids.size();
+        }, sink);
+        double any = throughput(messages, [&](const std::string& m) { return size_t(matcher.matchesAny(m)); }, sink);
+        std::cout << "  " << std::left << std::setw(19) << c.name << std::right << "  naive find " << std::setw(7)
+                  << naive << " GB/s  match " << std::setw(7) << ac << " GB/s (" << std::setprecision(1)
+                  << ac / naive << "x)  matchesAny " << std::setprecision(3) << std::setw(7) << any << " GB/s\n";
+    }
+    volatile size_t keep = sink;
+    (void)keep;
+    return 0;
+}
@@ -0,0 +1,174 @@
+// Matches synthetic log messages against the default literals plus a set of
+// regex rules: std::regex per rule, the literal matcher followed by the
+// combined lazy DFA on every message, and RuleSet, where the required
+// literals of the regexes decide which messages enter the DFA.
+#include "rule_set.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+static const std::vector<std::string> kRegexes = {
+    ".*overflow.*",
+    "failed (password|login) for (invalid user )?\\w+ from \\d+\\.\\d+\\.\\d+\\.\\d+",
+    "segfault at [0-9a-f]+ ip [0-9a-f]+",
+    "(union\\s+select|select\\s+.+\\s+from\\s+information_schema)",
+    "\\.\\./\\.\\./",
+    "<script[^>]*>",
+    "cmd\\.exe|/bin/(ba)?sh -c",
+    "user \\w+ added to group (wheel|sudo|admin)",
+    "oom-killer|out of memory: kill process \\d+",
+    "certificate (expired|verify failed)",
+    "too many authentication failures for \\w+",
+    "port ?scan(ning)? detected from \\S+",
+    "wget https?://\\S+\\.(sh|py|pl)",
+    "chmod [0-7]*7[0-7]* /tmp/\\S+",
+    "invalid (session|csrf) token",
+    "denied \\{ (read|write|execute) \\} for pid=\\d+",
+    "ssh-rsa [a-z0-9+/]{40,}",
+    "^kernel: .*tainted",
+    "login ok for root from \\S+$",
+    "base64 -d \\| (ba)?sh",
+};
+
+static const std::vector<std::string> kBenign = {
+    "GET /api/v1/items/{id} 200 in {n} ms",
+    "session {id} opened for user {user} by (uid=0)",
+    "worker {n} finished batch {id}: {n} records, {n} bytes",
+    "cache hit ratio {n}% over the last {n} s",
+    "connection from 10.0.{n}.{n} port {n} closed",
+    "scheduled job nightly-backup started at {n}",
+    "health check ok: db={n}ms queue={n}ms",
+    "user {user} updated profile field email",
+};
+
+static const std::vector<std::string> kHostile = {
+    "Failed password for invalid user {user} from 10.0.{n}.{n} port {n} ssh2",
+    "nginx[{n}]: segfault at {id} ip {id} sp {id} error 4",
+    "GET /index.php?id=1 UNION SELECT password FROM users 403",
+    "GET /static/../../etc/passwd 400",
+    "Out of memory: Kill process {n} (java) score {n}",
+    "user {user} added to group wheel",
+    "kernel: module {user} loaded, kernel tainted",
+    "buffer overflow detected in {user}",
+};
+
+static std::string fill(const std::string& tmpl, std::mt19937& rng) {
+    static const char* users[] = {"alice", "bob", "deploy", "svc-backup", "mallory"};
+    std::string out;
+    for (size_t i = 0; i < tmpl.size(); ++i) {
+        if (tmpl.compare(i, 3, "{n}") == 0) {
+            out += std::to_string(rng() % 1000);
+            i += 2;
+        } else if (tmpl.compare(i, 4, "{id}") == 0) {
+            char hex[17];
+            std::snprintf(hex, sizeof hex, "%016llx", static_cast<unsigned long long>(rng()) * 2654435761ull);
+            out += hex;
+            i += 3;
+        } else if (tmpl.compare(i, 6, "{user}") == 0) {
+            out += users[rng() % std::size(users)];
+            i += 5;
+        } else {
+            out += tmpl[i];
+        }
+    }
+    return out;
+}
+
+// One in hostileEvery messages comes from a hostile template
+static std::vector<std::string> makeMessages(size_t count, size_t hostileEvery) {
+    std::mt19937 rng(17);
+    std::vector<std::string> messages;
+    for (size_t i = 0; i < count; ++i) {
+        const auto& templates = i % hostileEvery == 0 ? kHostile : kBenign;
+        messages.push_back(fill(templates[rng() % templates.size()], rng));
+    }
+    return messages;
+}
+
+template <typename F>
+static double seconds(F&& run) {
+    double best = 1e300;
+    for (int rep = 0; rep < 3; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    std::vector<RuleSet::Rule> rules;
+    for (const auto& p : Config::logging.default_patterns) rules.push_back({p, false, 0});
+    for (const auto& r : kRegexes) rules.push_back({r, true, 0});
+    RuleSet ruleSet(rules, static_cast<size_t>(Config::logging.regex_cache_states));
+    PatternMatcher literals(Config::logging.default_patterns);
+    RegexSet regexSet(kRegexes, static_cast<size_t>(Config::logging.regex_cache_states));
+    std::vector<std::regex> stdRegexes;
+    for (const auto& r : kRegexes) stdRegexes.emplace_back(r, std::regex::ECMAScript | std::regex::icase);
+
+    auto st = ruleSet.stats();
+    std::cout << st.literals << " literals, " << st.regexes << " regexes (" << st.unfiltered
+              << " without a literal prefilter)\n" << std::fixed;
+
+    for (size_t hostileEvery : {100, 10}) {
+        auto messages = makeMessages(count, hostileEvery);
+        size_t bytes = 0;
+        for (const auto& m : messages) bytes += m.size();
+        std::vector<uint16_t> ids;
+        size_t hitsStd = 0, hitsDfa = 0, hitsRules = 0;
+
+        // std::regex is slow enough that a slice stands for the whole run
+        size_t slice = std::min<size_t>(messages.size(), 5000);
+        double tStd = seconds([&] {
+            hitsStd = 0;
+            for (size_t i = 0; i < slice; ++i) {
+                for (const auto& re : stdRegexes) hitsStd += std::regex_search(messages[i], re);
+            }
+        }) * messages.size() / slice;
+        double tDfa = seconds([&] {
+            hitsDfa = 0;
+            for (const auto& m : messages) {
+                literals.match(m, ids);
+                hitsDfa += ids.size();
+                regexSet.match(m, ids);
+                hitsDfa += ids.size();
+            }
+        });
+        auto before = ruleSet.stats();
+        double tRules = seconds([&] {
+            hitsRules = 0;
+            for (const auto& m : messages) {
+                ruleSet.match(m, ids);
+                hitsRules += ids.size();
+            }
+        });
+        auto after = ruleSet.stats();
+        double entered = double(after.regexRuns - before.regexRuns) / double(after.messages - before.messages);
+
+        auto line = [&](const char* name, double t, size_t hits, const char* what) {
+            std::cout << "  " << std::left << std::setw(24) << name << std::right << std::setprecision(3) << std::setw(9)
+                      << count / t / 1e6 << " M msg/s " << std::setprecision(1) << std::setw(8) << bytes / t / 1e6
+                      << " MB/s  " << hits << what << "\n";
+        };
+        std::cout << count << " messages, 1 in " << hostileEvery << " hostile, " << bytes / count << " bytes on average\n";
+        line("std::regex per rule", tStd, hitsStd, " regex hits in the first 5000");
+        line("literals + DFA on all", tDfa, hitsDfa, " rule hits");
+        line("RuleSet, prefiltered", tRules, hitsRules, " rule hits");
+        std::cout << "  " << std::setprecision(1) << entered * 100 << "% of messages entered the DFA; RuleSet is "
+                  << tStd / tRules << "x std::regex, " << std::setprecision(2) << tDfa / tRules
+                  << "x the unfiltered DFA\n";
+    }
+    auto dfa = regexSet.stats();
+    std::cout << "DFA: " << dfa.nfaStates << " NFA states, " << dfa.dfaStates << " DFA states cached, "
+              << dfa.cacheResets << " cache resets\n";
+    return 0;
+}
@@ -0,0 +1,116 @@
+// Indexes synthetic records and times queries against the index and
+// against a case-insensitive scan of every message, as grepping the JSONL
+// output would do.
+#include "text_index.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static const char* kUsers[] = {"alice", "bob", "deploy", "svc-backup", "mallory", "root", "postgres", "www-data"};
+static const char* kTemplates[] = {
+    "Accepted publickey for {user} from 10.{a}.{b}.{c} port {n} ssh2",
+    "Failed password for invalid user {user} from 10.{a}.{b}.{c} port {n} ssh2",
+    "session opened for user {user} by (uid=0)",
+    "GET /api/v1/items/{n} 200 in {n} ms",
+    "worker {n} finished batch: {n} records",
+    "connection from 10.{a}.{b}.{c} port {n} closed",
+    "buffer overflow detected pid {n}",
+    "kernel: oom-killer invoked, killed process {n}",
+};
+
+static std::string fill(const std::string& tmpl, std::mt19937& rng) {
+    std::string out;
+    for (size_t i = 0; i < tmpl.size(); ++i) {
+        if (tmpl.compare(i, 3, "{n}") == 0) {
+            out += std::to_string(rng() % 50000);
+            i += 2;
+        } else if (tmpl.compare(i, 6, "{user}") == 0) {
+            out += kUsers[rng() % std::size(kUsers)];
+            i += 5;
+        } else if (tmpl[i] == '{' && i + 2 < tmpl.size() && tmpl[i + 2] == '}') {
+            out += std::to_string(rng() % 256);
+            i += 2;
+        } else {
+            out += tmpl[i];
+        }
+    }
+    return out;
+}
+
+template <typename F>
+static double millis(F&& run) {
+    double best = 1e300;
+    for (int rep = 0; rep < 3; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000000;
+    std::string dir = (std::filesystem::temp_directory_path() / "search_bench_index").string();
+    std::filesystem::remove_all(dir);
+
+    std::mt19937 rng(23);
+    std::vector<std::string> messages, sources;
+    messages.reserve(count);
+    for (size_t i = 0; i < count; ++i) messages.push_back(fill(kTemplates[rng() % std::size(kTemplates)], rng));
+    for (int i = 0; i < 1000; ++i) sources.push_back("host" + std::to_string(i));
+
+    size_t bytes = 0;
+    for (const auto& m : messages) bytes += m.size();
+    uint16_t type = internLogType("auth");
+    TextIndex index(dir);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        LogRecord r;
+        r.message = messages[i];
+        r.source = sources[i % sources.size()];
+        r.typeId = type;
+        r.fields = LogRecord::Message | LogRecord::Source | LogRecord::Type;
+        index.add(static_cast<uint32_t>(i), r);
+    }
+    double build = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    index.save();
+    double save = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    auto st = index.stats();
+    double load = millis([&] { TextIndex reloaded(dir); });
+
+    std::cout << count << " records, " << bytes / 1048576 << " MiB of messages\n" << std::fixed << std::setprecision(2)
+              << "  indexed at " << count / build / 1e6 << " M records/s; " << st.terms << " terms, " << st.postings
+              << " postings in " << st.bytes / 1048576.0 << " MiB (" << double(st.bytes) / st.postings
+              << " bytes each); saved in " << save << " ms, loaded in " << load << " ms\n";
+
+    // The scan looks for the first term only, lowercased, as a lower bound
+    // on what grep over the JSONL output costs
+    for (const char* query : {"mallory AND host17", "10.1.2.3", "overflow OR oom-killer", "failed AND password AND root",
+                              "ssh2 host5"}) {
+        std::vector<uint32_t> ids;
+        double tIndex = millis([&] { ids = index.search(query); });
+        std::string needle = std::string(query).substr(0, std::string(query).find(' '));
+        size_t scanned = 0;
+        double tScan = millis([&] {
+            scanned = 0;
+            std::string lowered;
+            for (const auto& m : messages) {
+                lowered.assign(m);
+                for (char& c : lowered) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                scanned += lowered.find(needle) != std::string::npos;
+            }
+        });
+        std::cout << "  " << std::left << std::setw(32) << query << std::right << std::setw(10) << ids.size()
+                  << " hits " << std::setw(9) << tIndex << " ms   scan for '" << needle << "' " << std::setw(9) << tScan
+                  << " ms\n";
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
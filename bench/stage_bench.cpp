@@ -0,0 +1,253 @@
+// Times each stage of turning a block into output on its own, on fixed
+// inputs: base64 decoding of d, RSA unwrapping of the session key, AES-GCM
+// decryption, scanning the plaintext for log lines, the whole envelope
+// decoder, parsing and sorting the logs, and writing them as JSONL. Reports
+// the median time per operation, throughput and heap allocations per
+// operation.
+//
+//   stage_bench [--logs N] [--json FILE] [--baseline FILE] [--threshold PCT]
+//
+// --json writes the results; --baseline compares them with results written
+// earlier and exits 1 if a stage got more than PCT percent (default 10)
+// slower or allocates that much more.
+#include "alloc_count.hpp"
+#include "synthetic_block.hpp"
+#include "base64.hpp"
+#include "config.hpp"
+#include "decryptor.hpp"
+#include "json_scan.hpp"
+#include "json_stream.hpp"
+#include "keyring.hpp"
+#include "log_record.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Keeps the optimizer from dropping the work being timed
+static volatile size_t sink;
+
+struct Stage {
+    std::string name;
+    size_t bytes;                   // input per operation, for MB/s
+    std::function<void()> run;
+};
+
+struct Result {
+    std::string name;
+    double nsPerOp;
+    double mbPerSec;
+    double allocsPerOp;
+    uint64_t iterations;
+};
+
+// Runs for at least kMinTime and 3 operations, at most
+// DevelopmentConfig::benchmark_iterations, after one to warm up
+static constexpr double kMinTime = 0.5;
+
+static Result measure(const Stage& stage) {
+    stage.run();
+    size_t limit = static_cast<size_t>(std::max(Config::development.benchmark_iterations, 3));
+    std::vector<double> times;
+    uint64_t before = allocations;
+    double total = 0;
+    while (times.size() < limit && (total < kMinTime || times.size() < 3)) {
+        auto start = std::chrono::steady_clock::now();
+        stage.run();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        times.push_back(s);
+        total += s;
+    }
+    uint64_t allocs = allocations - before;
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    return {stage.name, median * 1e9, stage.bytes / median / 1e6, static_cast<double>(allocs) / times.size(),
+            times.size()};
+}
+
+class LogCollector : public JsonStreamScanner::Handler {
+public:
+    void beginString(const std::string& key, bool inArray) override {
+        inLog_ = key == "logs" && inArray;
+        if (inLog_) arena.beginString();
+    }
+    void stringData(const char* data, size_t len) override {
+        if (inLog_) arena.appendString(data, len);
+    }
+    void endString() override {
+        if (inLog_) logs.push_back(arena.endString());
+    }
+
+    LogArena arena;
+    std::vector<std::string_view> logs;
+
+private:
+    bool inLog_ = false;
+};
+
+static std::string field(const std::string& envelope, const std::string& name) {
+    std::string key = "\"" + name + "\": \"";
+    size_t start = envelope.find(key) + key.size();
+    return envelope.substr(start, envelope.find('"', start) - start);
+}
+
+// Returns false if any stage regressed against the baseline
+static bool compare(const std::vector<Result>& results, const nlohmann::json& baseline, size_t logs, double threshold) {
+    if (baseline.value("logs", size_t(0)) != logs) {
+        std::cout << "baseline was taken with " << baseline.value("logs", size_t(0)) << " logs, not compared\n";
+        return true;
+    }
+    std::map<std::string, nlohmann::json> before;
+    for (const auto& stage : baseline["stages"]) before[stage["name"]] = stage;
+
+    bool ok = true;
+    std::cout << "\nagainst the baseline (threshold " << threshold * 100 << "%)\n";
+    for (const auto& r : results) {
+        auto it = before.find(r.name);
+        if (it == before.end()) {
+            std::cout << "  " << std::left << std::setw(18) << r.name << std::right << "  not in the baseline\n";
+            continue;
+        }
+        double ns = it->second["ns_per_op"];
+        double allocs = it->second["allocs_per_op"];
+        double time = r.nsPerOp / ns - 1;
+        bool slower = time > threshold;
+        bool heavier = r.allocsPerOp > allocs * (1 + threshold) + 0.5;
+        std::cout << "  " << std::left << std::setw(18) << r.name << std::right << std::showpos << std::setw(8)
+                  << time * 100 << "% time" << std::noshowpos << std::setw(10) << allocs << " -> " << r.allocsPerOp
+                  << " allocs" << (slower || heavier ? "   REGRESSION" : "") << "\n";
+        ok = ok && !slower && !heavier;
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    size_t logs = 20000;
+    std::string jsonPath, baselinePath;
+    double threshold = 0.10;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Usage: stage_bench [--logs N] [--json FILE] [--baseline FILE] [--threshold PCT]\n";
+            return 2;
+        }
+        if (arg == "--logs") logs = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--json") jsonPath = argv[++i];
+        else if (arg == "--baseline") baselinePath = argv[++i];
+        else if (arg == "--threshold") threshold = std::strtod(argv[++i], nullptr) / 100;
+        else {
+            std::cerr << "Unknown option " << arg << "\n";
+            return 2;
+        }
+    }
+
+    SyntheticKey key;
+    unsigned char aesKey[32];
+    RAND_bytes(aesKey, sizeof(aesKey));
+    const std::string plaintext = syntheticPlaintext(logs);
+    const SyntheticEnvelope envelope = syntheticEnvelope(plaintext, key.pkey, aesKey);
+    const std::string d = field(envelope.json, "d");
+
+    // One keyring without a session cache, so that every unwrap does RSA,
+    // and one with, as blocks sharing a session key see it
+    Keyring rsaKeyring(0), keyring;
+    rsaKeyring.addKeyFile(key.path());
+    keyring.addKeyFile(key.path());
+
+    // Inputs of the later stages, made once
+    LogCollector lines;
+    {
+        JsonStreamScanner scanner(lines);
+        scanner.feed(plaintext.data(), plaintext.size());
+        scanner.finish();
+    }
+    size_t lineBytes = 0;
+    for (auto line : lines.logs) lineBytes += line.size();
+    LogArena recordArena;
+    const std::vector<LogRecord> records = parseAndSortLogs(lines.logs, recordArena);
+    std::string jsonl;
+    for (const auto& record : records) {
+        appendLogRecordJson(jsonl, record);
+        jsonl += '\n';
+    }
+
+    std::vector<unsigned char> decoded(base64MaxDecodedSize(d.size()));
+    std::vector<unsigned char> plain(envelope.cipher.size());
+    std::string out;
+    out.reserve(jsonl.size());
+
+    std::vector<Stage> stages = {
+        {"base64_decode", d.size(), [&] { sink = base64Decode(d.data(), d.size(), decoded.data()); }},
+        {"rsa_unwrap", envelope.wrappedKey.size(), [&] { sink = rsaKeyring.unwrap(envelope.wrappedKey).size(); }},
+        {"aes_gcm_decrypt", envelope.cipher.size(), [&] {
+             int len = 0;
+             EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+             EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, aesKey, envelope.nonce);
+             EVP_DecryptUpdate(ctx, plain.data(), &len, envelope.cipher.data(), static_cast<int>(envelope.cipher.size()));
+             EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, sizeof(envelope.tag), const_cast<unsigned char*>(envelope.tag));
+             if (EVP_DecryptFinal_ex(ctx, plain.data() + len, &len) <= 0) std::abort();
+             EVP_CIPHER_CTX_free(ctx);
+         }},
+        {"plaintext_scan", plaintext.size(), [&] {
+             LogCollector collector;
+             JsonStreamScanner scanner(collector);
+             Utf8Validator utf8;
+             if (!utf8.feed(plaintext.data(), plaintext.size()) || !utf8.finish()) std::abort();
+             scanner.feed(plaintext.data(), plaintext.size());
+             scanner.finish();
+             sink = collector.logs.size();
+         }},
+        {"decrypt_block", envelope.json.size(), [&] { sink = decryptBlock(envelope.json, keyring).logs.size(); }},
+        {"parse_and_sort", lineBytes, [&] {
+             LogArena arena;
+             sink = parseAndSortLogs(lines.logs, arena).size();
+         }},
+        {"serialize_jsonl", jsonl.size(), [&] {
+             out.clear();
+             for (const auto& record : records) {
+                 appendLogRecordJson(out, record);
+                 out += '\n';
+             }
+             sink = out.size();
+         }},
+    };
+
+    std::cout << "stages of a block of " << logs << " logs (" << std::fixed << std::setprecision(1)
+              << envelope.json.size() / 1e6 << " MB envelope)\n"
+              << "  stage                     ns/op        MB/s   allocs/op\n";
+    std::vector<Result> results;
+    nlohmann::json json = {{"logs", logs}, {"stages", nlohmann::json::array()}};
+    for (const auto& stage : stages) {
+        Result r = measure(stage);
+        results.push_back(r);
+        std::cout << "  " << std::left << std::setw(18) << r.name << std::right << std::setprecision(0)
+                  << std::setw(14) << r.nsPerOp << std::setprecision(1) << std::setw(12) << r.mbPerSec
+                  << std::setw(12) << r.allocsPerOp << "\n";
+        json["stages"].push_back({{"name", r.name}, {"ns_per_op", r.nsPerOp}, {"mb_per_s", r.mbPerSec},
+                                  {"allocs_per_op", r.allocsPerOp}, {"iterations", r.iterations}});
+    }
+
+    if (!jsonPath.empty()) {
+        std::ofstream file(jsonPath);
+        file << json.dump(2) << "\n";
+        if (!file) {
+            std::cerr << "Cannot write " << jsonPath << "\n";
+            return 2;
+        }
+    }
+    if (!baselinePath.empty()) {
+        std::ifstream file(baselinePath);
+        if (!file) {
+            std::cerr << "Cannot read " << baselinePath << "\n";
+            return 2;
+        }
+        if (!compare(results, nlohmann::json::parse(file), logs, threshold)) return 1;
+    }
+    return 0;
+}
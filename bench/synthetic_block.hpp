@@ -0,0 +1,102 @@
+#pragma once
+// Synthetic blocks for the benchmarks: a plaintext of generated logs,
+// encrypted into an envelope the way the publisher does it.
+#include "json.hpp"
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <unistd.h>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+inline std::string base64Encode(const unsigned char* data, size_t len) {
+    std::string out(4 * ((len + 2) / 3), '\0');
+    out.resize(EVP_EncodeBlock(reinterpret_cast<unsigned char*>(out.data()), data, static_cast<int>(len)));
+    return out;
+}
+
+// {"logs": [...], "prev_cid": ...} with count logs; block seeds the content
+inline std::string syntheticPlaintext(size_t count, size_t block = 0) {
+    static const char* types[] = {"auth", "net", "kernel", "app"};
+    static const char* messages[] = {"failed login for user root from 10.0.0.", "connection refused on port ",
+                                     "Permission Denied for /etc/shadow ", "unicode é中 "};
+    std::mt19937 rng(static_cast<unsigned>(block));
+    nlohmann::json logs = nlohmann::json::array();
+    for (size_t i = 0; i < count; ++i) {
+        size_t id = block * count + i;
+        nlohmann::json log = {{"event_id", id}, {"type", types[rng() % 4]},
+                              {"message", messages[rng() % 4] + std::to_string(id)},
+                              {"timestamp", 1700000000 + id}, {"source", "host" + std::to_string(id % 5)}};
+        logs.push_back(log.dump());
+    }
+    return nlohmann::json{{"logs", logs}, {"prev_cid", "bafyprevious" + std::to_string(block)}}.dump();
+}
+
+// A fresh RSA key, also written to a PEM file for Keyring::addKeyFile
+class SyntheticKey {
+public:
+    SyntheticKey() : pkey(EVP_RSA_gen(2048)) {
+        int fd = mkstemp(path_);
+        FILE* fp = fd < 0 ? nullptr : fdopen(fd, "w");
+        if (!pkey || !fp || !PEM_write_PrivateKey(fp, pkey, nullptr, nullptr, 0, nullptr, nullptr))
+            throw std::runtime_error("Cannot create a benchmark key");
+        fclose(fp);
+    }
+    ~SyntheticKey() {
+        unlink(path_);
+        EVP_PKEY_free(pkey);
+    }
+
+    SyntheticKey(const SyntheticKey&) = delete;
+    SyntheticKey& operator=(const SyntheticKey&) = delete;
+
+    const char* path() const { return path_; }
+
+    EVP_PKEY* pkey;
+
+private:
+    char path_[32] = "/tmp/netsec_bench_key_XXXXXX";
+};
+
+struct SyntheticEnvelope {
+    std::vector<unsigned char> cipher;
+    std::vector<unsigned char> wrappedKey;
+    unsigned char nonce[12];
+    unsigned char tag[16];
+    std::string json;   // {"d", "k", "n", "t"}
+};
+
+// Encrypts plaintext under aesKey (32 bytes) wrapped for key. d comes first,
+// as the publisher writes it, so a decoder holds the ciphertext back until
+// k and n arrive.
+inline SyntheticEnvelope syntheticEnvelope(const std::string& plaintext, EVP_PKEY* key, const unsigned char* aesKey) {
+    SyntheticEnvelope e;
+    RAND_bytes(e.nonce, sizeof(e.nonce));
+    e.cipher.resize(plaintext.size());
+    int len = 0;
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, aesKey, e.nonce);
+    EVP_EncryptUpdate(ctx, e.cipher.data(), &len, reinterpret_cast<const unsigned char*>(plaintext.data()),
+                      static_cast<int>(plaintext.size()));
+    EVP_EncryptFinal_ex(ctx, e.cipher.data() + len, &len);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, sizeof(e.tag), e.tag);
+    EVP_CIPHER_CTX_free(ctx);
+
+    EVP_PKEY_CTX* rsa = EVP_PKEY_CTX_new(key, nullptr);
+    EVP_PKEY_encrypt_init(rsa);
+    EVP_PKEY_CTX_set_rsa_padding(rsa, RSA_PKCS1_OAEP_PADDING);
+    size_t wrappedLen = 0;
+    EVP_PKEY_encrypt(rsa, nullptr, &wrappedLen, aesKey, 32);
+    e.wrappedKey.resize(wrappedLen);
+    EVP_PKEY_encrypt(rsa, e.wrappedKey.data(), &wrappedLen, aesKey, 32);
+    e.wrappedKey.resize(wrappedLen);
+    EVP_PKEY_CTX_free(rsa);
+
+    e.json = "{\"d\": \"" + base64Encode(e.cipher.data(), e.cipher.size()) + "\", \"k\": \"" +
+             base64Encode(e.wrappedKey.data(), e.wrappedKey.size()) + "\", \"n\": \"" +
+             base64Encode(e.nonce, sizeof(e.nonce)) + "\", \"t\": \"" + base64Encode(e.tag, sizeof(e.tag)) + "\"}";
+    return e;
+}
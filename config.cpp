@@ -32,6 +32,7 @@ CacheConfig cache;
 DevelopmentConfig development;
 SecurityConfig security;
 PerformanceConfig performance;
+StoreConfig store;
 
 // === Configuration Management ===
 
@@ -90,6 +91,8 @@ void load_config_from_file(const std::string& config_file) {
             if (net.contains("buffer_size")) network.buffer_size = net["buffer_size"];
             if (net.contains("max_connections")) network.max_connections = net["max_connections"];
             if (net.contains("thread_pool_size")) network.thread_pool_size = net["thread_pool_size"];
+            if (net.contains("daemon_socket")) network.daemon_socket = net["daemon_socket"];
+            if (net.contains("daemon_cache_mb")) network.daemon_cache_mb = net["daemon_cache_mb"];
             if (net.contains("enable_ssl")) network.enable_ssl = net["enable_ssl"];
             if (net.contains("cert_file")) network.cert_file = net["cert_file"];
             if (net.contains("key_file")) network.key_file = net["key_file"];
@@ -102,9 +105,15 @@ void load_config_from_file(const std::string& config_file) {
             if (ipfs_config.contains("api_url")) ipfs.api_url = ipfs_config["api_url"];
             if (ipfs_config.contains("gateway_url")) ipfs.gateway_url = ipfs_config["gateway_url"];
             if (ipfs_config.contains("ipns_key_name")) ipfs.ipns_key_name = ipfs_config["ipns_key_name"];
+            if (ipfs_config.contains("ipns_cache_ttl")) ipfs.ipns_cache_ttl = ipfs_config["ipns_cache_ttl"];
             if (ipfs_config.contains("timeout")) ipfs.timeout = ipfs_config["timeout"];
             if (ipfs_config.contains("max_retries")) ipfs.max_retries = ipfs_config["max_retries"];
             if (ipfs_config.contains("allow_offline")) ipfs.allow_offline = ipfs_config["allow_offline"];
+            if (ipfs_config.contains("public_gateways")) ipfs.public_gateways = ipfs_config["public_gateways"].get<std::vector<std::string>>();
+            if (ipfs_config.contains("enable_hedged_requests")) ipfs.enable_hedged_requests = ipfs_config["enable_hedged_requests"];
+            if (ipfs_config.contains("chain_manifest")) ipfs.chain_manifest = ipfs_config["chain_manifest"];
+            if (ipfs_config.contains("watch_min_interval_ms")) ipfs.watch_min_interval_ms = ipfs_config["watch_min_interval_ms"];
+            if (ipfs_config.contains("watch_max_interval_ms")) ipfs.watch_max_interval_ms = ipfs_config["watch_max_interval_ms"];
         }
         
         // Load encryption configuration
@@ -118,6 +127,8 @@ void load_config_from_file(const std::string& config_file) {
             if (enc.contains("password_file")) encryption.password_file = enc["password_file"];
             if (enc.contains("ipns_key_file")) encryption.ipns_key_file = enc["ipns_key_file"];
             if (enc.contains("rsa_key_size")) encryption.rsa_key_size = enc["rsa_key_size"];
+            if (enc.contains("private_key_pems")) encryption.private_key_pems = enc["private_key_pems"].get<std::vector<std::string>>();
+            if (enc.contains("session_key_cache_size")) encryption.session_key_cache_size = enc["session_key_cache_size"];
         }
         
         // Load logging configuration
@@ -129,6 +140,11 @@ void load_config_from_file(const std::string& config_file) {
             if (log.contains("max_log_files")) logging.max_log_files = log["max_log_files"];
             if (log.contains("enable_console")) logging.enable_console = log["enable_console"];
             if (log.contains("enable_file")) logging.enable_file = log["enable_file"];
+            if (log.contains("output_file")) logging.output_file = log["output_file"];
+            if (log.contains("flush_interval_ms")) logging.flush_interval_ms = log["flush_interval_ms"];
+            if (log.contains("use_io_uring")) logging.use_io_uring = log["use_io_uring"];
+            if (log.contains("patterns_file")) logging.patterns_file = log["patterns_file"];
+            if (log.contains("regex_cache_states")) logging.regex_cache_states = log["regex_cache_states"];
         }
         
         // Load cache configuration
@@ -176,9 +192,22 @@ void load_config_from_file(const std::string& config_file) {
             if (perf.contains("io_timeout")) performance.io_timeout = perf["io_timeout"];
             if (perf.contains("enable_connection_pooling")) performance.enable_connection_pooling = perf["enable_connection_pooling"];
             if (perf.contains("pool_size")) performance.pool_size = perf["pool_size"];
+            if (perf.contains("merge_window")) performance.merge_window = perf["merge_window"];
+            if (perf.contains("arena_pool_mb")) performance.arena_pool_mb = perf["arena_pool_mb"];
         }
         
-        std::cout << "Configuration loaded from: " << config_file << std::endl;
+        // Load segment store configuration
+        if (config.contains("store")) {
+            auto& store_config = config["store"];
+            if (store_config.contains("enabled")) store.enabled = store_config["enabled"];
+            if (store_config.contains("store_dir")) store.store_dir = store_config["store_dir"];
+            if (store_config.contains("segment_records")) store.segment_records = store_config["segment_records"];
+            if (store_config.contains("index_stride")) store.index_stride = store_config["index_stride"];
+            if (store_config.contains("compress")) store.compress = store_config["compress"];
+            if (store_config.contains("full_text_index")) store.full_text_index = store_config["full_text_index"];
+        }
+        
+        std::cerr << "Configuration loaded from: " << config_file << std::endl;
         
     } catch (const std::exception& e) {
         std::cerr << "Error loading configuration: " << e.what() << std::endl;
@@ -198,6 +227,8 @@ void save_config_to_file(const std::string& config_file) {
             {"buffer_size", network.buffer_size},
             {"max_connections", network.max_connections},
             {"thread_pool_size", network.thread_pool_size},
+            {"daemon_socket", network.daemon_socket},
+            {"daemon_cache_mb", network.daemon_cache_mb},
             {"enable_ssl", network.enable_ssl},
             {"cert_file", network.cert_file},
             {"key_file", network.key_file},
@@ -209,9 +240,15 @@ void save_config_to_file(const std::string& config_file) {
             {"api_url", ipfs.api_url},
             {"gateway_url", ipfs.gateway_url},
             {"ipns_key_name", ipfs.ipns_key_name},
+            {"ipns_cache_ttl", ipfs.ipns_cache_ttl},
             {"timeout", ipfs.timeout},
             {"max_retries", ipfs.max_retries},
-            {"allow_offline", ipfs.allow_offline}
+            {"allow_offline", ipfs.allow_offline},
+            {"public_gateways", ipfs.public_gateways},
+            {"enable_hedged_requests", ipfs.enable_hedged_requests},
+            {"chain_manifest", ipfs.chain_manifest},
+            {"watch_min_interval_ms", ipfs.watch_min_interval_ms},
+            {"watch_max_interval_ms", ipfs.watch_max_interval_ms}
         };
         
         // Encryption configuration
@@ -223,7 +260,9 @@ void save_config_to_file(const std::string& config_file) {
             {"private_key_file", encryption.private_key_file},
             {"password_file", encryption.password_file},
             {"ipns_key_file", encryption.ipns_key_file},
-            {"rsa_key_size", encryption.rsa_key_size}
+            {"rsa_key_size", encryption.rsa_key_size},
+            {"private_key_pems", encryption.private_key_pems},
+            {"session_key_cache_size", encryption.session_key_cache_size}
         };
         
         // Logging configuration
@@ -233,7 +272,12 @@ void save_config_to_file(const std::string& config_file) {
             {"max_log_size", logging.max_log_size},
             {"max_log_files", logging.max_log_files},
             {"enable_console", logging.enable_console},
-            {"enable_file", logging.enable_file}
+            {"enable_file", logging.enable_file},
+            {"output_file", logging.output_file},
+            {"flush_interval_ms", logging.flush_interval_ms},
+            {"use_io_uring", logging.use_io_uring},
+            {"patterns_file", logging.patterns_file},
+            {"regex_cache_states", logging.regex_cache_states}
         };
         
         // Cache configuration
@@ -276,7 +320,19 @@ void save_config_to_file(const std::string& config_file) {
             {"enable_async_io", performance.enable_async_io},
             {"io_timeout", performance.io_timeout},
             {"enable_connection_pooling", performance.enable_connection_pooling},
-            {"pool_size", performance.pool_size}
+            {"pool_size", performance.pool_size},
+            {"merge_window", performance.merge_window},
+            {"arena_pool_mb", performance.arena_pool_mb}
+        };
+        
+        // Segment store configuration
+        config["store"] = {
+            {"enabled", store.enabled},
+            {"store_dir", store.store_dir},
+            {"segment_records", store.segment_records},
+            {"index_stride", store.index_stride},
+            {"compress", store.compress},
+            {"full_text_index", store.full_text_index}
         };
         
         // Ensure directory exists
@@ -369,12 +425,28 @@ bool validate_config() {
         valid = false;
     }
     
+    if (network.daemon_cache_mb < 0) {
+        std::cerr << "Invalid daemon cache size: " << network.daemon_cache_mb << " MB" << std::endl;
+        valid = false;
+    }
+    
     // Validate IPFS configuration
     if (ipfs.timeout <= 0) {
         std::cerr << "Invalid IPFS timeout: " << ipfs.timeout << std::endl;
         valid = false;
     }
     
+    if (ipfs.ipns_cache_ttl <= 0) {
+        std::cerr << "Invalid IPNS cache TTL: " << ipfs.ipns_cache_ttl << std::endl;
+        valid = false;
+    }
+    
+    if (ipfs.watch_min_interval_ms <= 0 || ipfs.watch_max_interval_ms < ipfs.watch_min_interval_ms) {
+        std::cerr << "Invalid watch interval: " << ipfs.watch_min_interval_ms << " to " << ipfs.watch_max_interval_ms
+                  << " ms" << std::endl;
+        valid = false;
+    }
+    
     // Validate encryption configuration
     if (encryption.key_size <= 0) {
         std::cerr << "Invalid key size: " << encryption.key_size << std::endl;
@@ -397,6 +469,16 @@ bool validate_config() {
         valid = false;
     }
     
+    if (logging.flush_interval_ms < 0) {
+        std::cerr << "Invalid flush interval: " << logging.flush_interval_ms << std::endl;
+        valid = false;
+    }
+    
+    if (logging.regex_cache_states <= 0) {
+        std::cerr << "Invalid regex cache size: " << logging.regex_cache_states << std::endl;
+        valid = false;
+    }
+    
     // Validate cache configuration
     if (cache.ttl <= 0) {
         std::cerr << "Invalid cache TTL: " << cache.ttl << std::endl;
@@ -460,6 +542,23 @@ bool validate_config() {
         valid = false;
     }
     
+    if (performance.merge_window <= 0) {
+        std::cerr << "Invalid merge window: " << performance.merge_window << std::endl;
+        valid = false;
+    }
+    
+    if (performance.arena_pool_mb < 0) {
+        std::cerr << "Invalid arena pool size: " << performance.arena_pool_mb << std::endl;
+        valid = false;
+    }
+    
+    // Validate segment store configuration
+    if (store.segment_records <= 0 || store.index_stride <= 0 || store.index_stride > store.segment_records) {
+        std::cerr << "Invalid segment store layout: " << store.segment_records << " records, stride "
+                  << store.index_stride << std::endl;
+        valid = false;
+    }
+    
     return valid;
 }
 
@@ -44,6 +44,9 @@ namespace Config {
         std::string get_config_path() const { return project_root + "/" + config_dir; }
         std::string get_logs_path() const { return project_root + "/" + logs_dir; }
         std::string get_cache_path() const { return project_root + "/" + cache_dir; }
+        std::string get_test_data_path() const { return project_root + "/" + test_data_dir; }
+        std::string get_deps_path() const { return project_root + "/" + deps_dir; }
+        std::string get_external_path() const { return project_root + "/" + external_dir; }
     };
     
     // === Network Configuration ===
@@ -56,6 +59,11 @@ namespace Config {
         int max_connections = 100;
         int thread_pool_size = 4;
         
+        // 'daemon' serves clients on this Unix socket and keeps up to
+        // daemon_cache_mb of decoded blocks for all of them
+        std::string daemon_socket = "cache/daemon.sock";
+        int daemon_cache_mb = 64;
+        
         // SSL/TLS Configuration
         bool enable_ssl = true;
         std::string cert_file = "certs/server.crt";
@@ -68,10 +76,23 @@ namespace Config {
         std::string api_url = "http://localhost:5001";
         std::string gateway_url = "http://localhost:8080";
         std::string ipns_key_name = "cli-netsectool";
+        int ipns_cache_ttl = 30; // seconds a resolved head is served from memory
         int timeout = 30;
         int max_retries = 3;
         bool allow_offline = true;
         
+        // Public gateways tried after the local one, ranked at runtime by
+        // latency and error rate; slow requests are hedged to the runner-up
+        std::vector<std::string> public_gateways = {"https://ipfs.io", "https://dweb.link"};
+        bool enable_hedged_requests = true;
+        
+        // Blocks already processed, so 'sync' only fetches what is new
+        std::string chain_manifest = "cache/chain.manifest";
+        
+        // 'watch' polls the head this often, backing off while it does not change
+        int watch_min_interval_ms = 500;
+        int watch_max_interval_ms = 10000;
+        
         // IPFS URLs for installation
         constexpr static const char* IPFS_DOWNLOAD_URL = "https://dist.ipfs.tech/kubo/v0.20.0/kubo_v0.20.0_linux-amd64.tar.gz";
         constexpr static const char* NLOHMANN_JSON_URL = "https://github.com/nlohmann/json/releases/download/v3.12.0/json.hpp";
@@ -88,6 +109,11 @@ namespace Config {
         std::string password_file = "keys/p.zip";
         std::string ipns_key_file = "keys/ipns_key.txt";
         
+        // Decrypted PEM keys loaded into the keyring at startup; envelopes
+        // carrying a "kid" are routed to the matching key
+        std::vector<std::string> private_key_pems = {"keys/private_key.pem"};
+        int session_key_cache_size = 1024;
+        
         // RSA Configuration
         int rsa_key_size = 2048;
         constexpr static const char* RSA_PADDING = "RSA_PKCS1_OAEP_PADDING";
@@ -102,6 +128,15 @@ namespace Config {
         bool enable_console = true;
         bool enable_file = true;
         
+        // Decrypted log output (JSONL), rotated by max_log_size/max_log_files
+        std::string output_file = "./logs_output.jsonl";
+        int flush_interval_ms = 200; // fdatasync at most this often
+        bool use_io_uring = false;
+        
+        // Extra threat rules, one literal or regex per line; skipped if missing
+        std::string patterns_file = "test_data/patterns.txt";
+        int regex_cache_states = 4096; // lazy DFA states kept before the cache is rebuilt
+        
         // Log patterns
         std::vector<std::string> default_patterns = {
             "ERROR",
@@ -342,6 +377,18 @@ namespace Config {
         int io_timeout = 30;
         bool enable_connection_pooling = true;
         int pool_size = 10;
+        int merge_window = 8; // blocks held back to order events across overlapping blocks
+        int arena_pool_mb = 64; // idle log arena memory kept for reuse by later blocks; 0 frees it at once
+    };
+    
+    // === Segment Store Configuration ===
+    struct StoreConfig {
+        bool enabled = true;
+        std::string store_dir = "store";
+        int segment_records = 65536; // records per immutable segment file; short ones are merged up to it
+        int index_stride = 128; // records per sparse index entry and compressed frame
+        bool compress = true;
+        bool full_text_index = true; // token -> record postings for 'search', saved with the segments
     };
     
     // === Global Configuration Instance ===
@@ -354,6 +401,7 @@ namespace Config {
     extern DevelopmentConfig development;
     extern SecurityConfig security;
     extern PerformanceConfig performance;
+    extern StoreConfig store;
     
     // === Configuration Management Functions ===
     void initialize_config();
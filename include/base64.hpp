@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Malformed base64; offset is the position of the offending character
+// counted from the start of the input (or of the stream, for Base64Decoder)
+class Base64Error : public std::runtime_error {
+public:
+    Base64Error(const std::string& what, size_t offset)
+        : std::runtime_error(what + " at offset " + std::to_string(offset)), offset(offset) {}
+
+    size_t offset;
+};
+
+// Room needed in the output buffer to decode len characters
+constexpr size_t base64MaxDecodedSize(size_t len) {
+    return (len + 3) / 4 * 3;
+}
+
+// Decodes standard-alphabet base64 into out, which must have room for
+// base64MaxDecodedSize(len) bytes, and returns the number of bytes written.
+// Trailing padding is optional. Bulk input is decoded 32 or 16 characters
+// at a time with AVX2 or SSE4.1 when the CPU has them, scalar otherwise.
+size_t base64Decode(const char* in, size_t len, unsigned char* out);
+
+// Kernel picked for this CPU: "avx2", "sse4.1" or "scalar"
+const char* base64KernelName();
+
+// Incremental base64 decoder. Input may be split at any byte; whole
+// 4-character groups are decoded as soon as they arrive and the remainder
+// is carried over to the next call.
+class Base64Decoder {
+public:
+    // Appends the bytes decoded from data to out
+    void feed(const char* data, size_t len, std::vector<unsigned char>& out);
+
+    // Flushes an unpadded tail; throws if the input stopped mid-group
+    void finish(std::vector<unsigned char>& out);
+
+private:
+    char carry_[4] = {};
+    size_t carryLen_ = 0;
+    size_t consumed_ = 0;       // characters fed so far, for error offsets
+    bool padded_ = false;
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include "mapped_file.hpp"
+#include "utils.hpp"
+
+// On-disk cache of raw encrypted envelopes keyed by CID. CIDs are immutable,
+// so entries never go stale; the cache is only bounded by size, evicting the
+// least recently used blocks. Recency survives restarts through file mtimes.
+class BlockCache {
+public:
+    BlockCache(std::string dir, uint64_t maxBytes);
+
+    // Maps the cached envelope for cid, or returns std::nullopt on a miss
+    std::optional<MappedFile> get(const std::string& cid);
+
+    // Streams one envelope into the cache as it is downloaded. The file
+    // appears under its final name only once fully written and synced by
+    // commit(), so a crash never leaves a torn entry; an abandoned writer
+    // leaves no trace.
+    class Writer {
+    public:
+        void write(const char* data, size_t len);
+        void commit();
+
+    private:
+        friend class BlockCache;
+        Writer(BlockCache& cache, std::string cid);
+
+        BlockCache& cache_;
+        std::string cid_;
+        AtomicFile file_;
+        bool failed_ = false;
+    };
+
+    // Returns nullptr if cid is not cacheable, already cached, or the
+    // directory cannot be written
+    std::unique_ptr<Writer> writer(const std::string& cid);
+
+    uint64_t sizeBytes() const;
+    size_t entryCount() const;
+
+private:
+    struct Entry {
+        uint64_t size;
+        std::list<std::string>::iterator lru;
+    };
+
+    void load();
+    void evictLocked(uint64_t incoming);
+    void admit(const std::string& cid, uint64_t size);
+    std::string pathFor(const std::string& cid) const;
+
+    std::string dir_;
+    uint64_t maxBytes_;
+    mutable std::mutex mutex_;
+    std::list<std::string> lru_;   // front = most recently used
+    std::unordered_map<std::string, Entry> entries_;
+    uint64_t totalBytes_ = 0;
+};
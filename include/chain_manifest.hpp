@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "log_record.hpp"
+
+// What is known about the blocks of the log chain already processed: for
+// each CID its prev_cid link, event_id and timestamp ranges and record
+// count. Blocks are immutable, so entries never change; the file is an
+// append-only list, one block per line, written with a single write and
+// fdatasync per batch. A torn last line after a crash is skipped on load.
+//
+// With the manifest, catching up from a new IPNS head means fetching only
+// the blocks in front of the first known CID, and the rest of the chain
+// behind it can be followed without decrypting anything.
+class ChainManifest {
+public:
+    struct Entry {
+        std::string prevCID;
+        int64_t minEventId, maxEventId;     // min > max when no record has one
+        int64_t minTimestamp, maxTimestamp;
+        uint32_t records;
+    };
+
+    explicit ChainManifest(std::string path);
+    ~ChainManifest();
+
+    ChainManifest(const ChainManifest&) = delete;
+    ChainManifest& operator=(const ChainManifest&) = delete;
+
+    // Configured from IPFSConfig::chain_manifest
+    static std::unique_ptr<ChainManifest> fromConfig();
+
+    // Entry of a block with the given link and parsed logs
+    static Entry describe(const std::string& prevCID, const std::vector<LogRecord>& logs);
+
+    // Thread safe, so a walk can check CIDs from its fetch thread
+    bool contains(const std::string& cid) const;
+    std::optional<Entry> find(const std::string& cid) const;
+
+    // Appends the blocks not known yet; throws std::runtime_error if the
+    // file cannot be written, in which case none of them is added
+    void add(const std::vector<std::pair<std::string, Entry>>& blocks);
+
+    // Follows prev_cid links from cid through known blocks
+    struct Tail {
+        std::string missing;    // first CID not in the manifest; empty if the chain is complete
+        size_t blocks;
+        uint64_t records;
+    };
+    Tail follow(const std::string& cid) const;
+
+    size_t size() const;
+
+private:
+    void load();
+
+    std::string path_;
+    int fd_ = -1;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "log_record.hpp"
+
+class Keyring;
+
+// One decrypted block of the log chain, with its inner logs parsed and sorted.
+// The records' strings live in arena.
+struct ChainBlock {
+    size_t index = 0;           // position in the walk, 0 = first block fetched
+    std::string cid;
+    std::string prevCID;
+    LogArena arena;
+    std::vector<LogRecord> logs;
+};
+
+// Raised when a block of the chain cannot be fetched or decrypted. Blocks
+// before it have already been delivered, so the walk can resume from cid.
+class ChainWalkError : public std::runtime_error {
+public:
+    ChainWalkError(const std::string& cid, const std::string& what)
+        : std::runtime_error(what), cid(cid) {}
+
+    std::string cid;
+};
+
+// Walks a log chain by following prev_cid links as a staged pipeline:
+//   fetch + decrypt  ->  parse + sort inner logs  ->  sink (caller's thread)
+// Fetching and parsing are tasks on ThreadPool::instance(). The next fetch
+// starts as soon as the previous block's prev_cid is known, so parsing and
+// output of earlier blocks overlap with network I/O, and several blocks are
+// parsed at once when the pool has the workers. At most queueSize blocks
+// are fetched ahead of the sink.
+class ChainWalker {
+public:
+    using Sink = std::function<void(ChainBlock&)>;
+    using StopAt = std::function<bool(const std::string& cid)>;
+
+    ChainWalker(Keyring& keyring, size_t queueSize);
+
+    // Delivers blocks starting at startCID until the chain ends, maxBlocks
+    // blocks were delivered (0 = no limit) or stopAt returns true for the
+    // next CID, which is then not fetched. stopAt runs on a pool worker, one
+    // call at a time. Returns the number delivered. Must not be called from
+    // a task on the pool, which it waits for without helping.
+    size_t walk(const std::string& startCID, size_t maxBlocks, const Sink& sink, const StopAt& stopAt = nullptr);
+
+private:
+    Keyring& keyring_;
+    size_t queueSize_;
+};
@@ -1,11 +1,72 @@
 #pragma once
+#include <cstddef>
+#include <memory>
+#include <chrono>
+#include <optional>
+#include <ostream>
+#include <sstream>
 #include <string>
+#include <vector>
+#include "keyring.hpp"
+
+class ChainManifest;
+class Correlator;
+class EventWriter;
+class JsonlSink;
+struct LogRecord;
+class SegmentStore;
 
 class CLI {
 public:
-    void run();
+    static constexpr int kExitOk = 0;
+    static constexpr int kExitFailed = 1;
+    static constexpr int kExitUsage = 2;
+
+    // Text is the interactive shell; Ndjson reads the same commands from
+    // stdin and answers each with JSON events on stdout (see EventWriter)
+    enum class Protocol { Text, Ndjson };
+
+    CLI();
+    ~CLI();
+    void run(Protocol protocol = Protocol::Text);
+    int batch(const std::vector<std::string>& args);
 
 private:
     std::string lastPrevCID;
-    void loadCID(const std::string& cid);
+    Keyring keyring;
+    std::unique_ptr<JsonlSink> sink;
+    std::unique_ptr<SegmentStore> segments;
+    bool storeFailed = false;
+    std::unique_ptr<Correlator> correlator;
+    std::unique_ptr<ChainManifest> knownBlocks;
+    bool manifestFailed = false;
+    bool headless = false;
+    bool failed = false;
+    std::ostream plainStderr;
+    std::unique_ptr<EventWriter> events;
+    std::ostringstream eventNotes, eventWarnings, eventErrors;
+    std::ostream& report();
+    std::ostream& warn();
+    std::ostream& fail();
+    void sendMessages();
+    bool flushEvents();
+    bool endCommand(const std::string& command, const std::string& printed, const std::optional<std::string>& prevCID,
+                    std::chrono::steady_clock::time_point started);
+    JsonlSink& output();
+    SegmentStore* store();
+    ChainManifest* manifest();
+    void correlate(const LogRecord& log);
+    void loadKeys();
+    void loadRules();
+    void loadCID(std::string cid);
+    void walkChain(size_t maxBlocks, bool stopAtKnown = false);
+    void syncChain();
+    void watchChain(const std::string& args);
+    void showGateways();
+    void showWorkers();
+    void storeCommand(const std::string& args);
+    void searchCommand(const std::string& query);
+    void scanCommand(const std::string& args);
+    void showAlerts();
+    int serveDaemon(const std::string& socketPath);
 };
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "log_record.hpp"
+
+// Event counts per key over a sliding time window, in an open-addressing
+// table of fixed-size slots. Each slot keeps kBuckets counters of
+// window / kBuckets seconds in a ring, so an event costs one probe and at
+// most kBuckets counter resets, and events themselves are never stored.
+// A slot whose newest bucket has left the window is free for reuse, and
+// the table is rebuilt from live slots only when it fills up, so memory
+// follows the number of keys active within one window.
+class WindowCounter {
+public:
+    static constexpr int kBuckets = 8;
+
+    WindowCounter(uint32_t windowSeconds, uint32_t threshold);
+
+    // Counts one event for key at time t. Times must not go back by more
+    // than a window; older events are dropped and counted in late(). Returns
+    // the count in the window ending at the key's newest event once it
+    // reaches the threshold, at most once per window for a key, else 0.
+    uint32_t add(uint64_t key, int64_t t);
+
+    // Forgets every key, as if no event had been counted; late() is kept
+    void clear();
+
+    uint32_t window() const { return window_; }
+    size_t keys() const;            // slots still inside the window
+    uint64_t late() const { return late_; }
+    size_t memoryBytes() const { return sizeof(*this) + slots_.capacity() * sizeof(Slot); }
+
+private:
+    struct Slot {
+        uint64_t key;               // 0 = never used
+        int64_t head;               // newest bucket counted
+        int64_t quietUntil;         // first bucket that may fire again
+        uint16_t counts[kBuckets];  // bucket b at b mod kBuckets, saturating
+    };
+
+    // quietUntil never exceeds head + kBuckets, so it expires with the slot
+    bool live(const Slot& slot) const { return slot.head > now_ - kBuckets; }
+    void rebuild();
+
+    uint32_t window_;
+    uint32_t threshold_;
+    int64_t width_;                 // seconds per bucket
+    int64_t now_ = INT64_MIN + kBuckets;   // newest bucket seen
+    std::vector<Slot> slots_;
+    size_t used_ = 0;
+    uint64_t late_ = 0;
+};
+
+// Correlates log records over time, with the limits of SecurityConfig:
+//   - max_failed_attempts records matching the same threat rule from one
+//     source within lockout_duration seconds
+//   - rate_limit_requests records of one type from one source within
+//     rate_limit_window seconds, if enable_rate_limiting is set
+// Records without a timestamp are ignored.
+class Correlator {
+public:
+    struct Options {
+        uint32_t maxAttempts;
+        uint32_t attemptWindow;
+        bool rateLimiting;
+        uint32_t maxRequests;
+        uint32_t requestWindow;
+        bool newestFirst;           // records arrive in descending time, as from a chain walk
+    };
+
+    explicit Correlator(const Options& options);
+    static std::unique_ptr<Correlator> fromConfig();
+
+    struct Alert {
+        enum Kind : uint8_t { Attempts, Rate } kind;
+        uint16_t id;                // Attempts: RuleSet rule id; Rate: log type id
+        std::string_view source;    // view into the record
+        uint32_t count;
+        uint32_t window;            // seconds
+        int64_t timestamp;
+    };
+
+    // Marks the start of a walk. Windows carry over into it only if it
+    // continues where the last one stopped, e.g. further back in a chain;
+    // a walk from a newer head starts with empty windows, as its records
+    // would otherwise all be too far out of order to count.
+    void beginWalk() { walkStarted_ = true; }
+
+    // Alerts fired by record; alerts is cleared first
+    void observe(const LogRecord& record, std::vector<Alert>& alerts);
+
+    struct Stats {
+        uint64_t events;
+        uint64_t late;              // too far out of order to count
+        uint64_t alerts;
+        size_t keys;
+        size_t memoryBytes;
+    };
+    Stats stats() const;
+
+private:
+    Options options_;
+    WindowCounter attempts_;
+    std::optional<WindowCounter> requests_;
+    uint64_t events_ = 0;
+    uint64_t alerts_ = 0;
+    bool walkStarted_ = false;
+    int64_t last_ = INT64_MIN;      // furthest time counted, in counting order
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "chain_manifest.hpp"
+#include "rpc_server.hpp"
+
+class JsonlSink;
+class Keyring;
+class SegmentStore;
+
+// Long-running process that owns the keyring, the output file, the segment
+// store and the chain manifest, and answers any number of clients over an
+// RpcServer socket, so dashboards share one warm process instead of each
+// starting a CLI of its own.
+//
+// Decoded blocks are kept in memory as serialized records, up to
+// cacheBytes, and a block being fetched for one request is waited for by
+// every other request that needs it, so a chain is fetched and decrypted
+// once however many clients read it. Records reach the output file, the
+// store and the manifest when their block is decoded.
+//
+// Methods, with their params, the frames streamed and the "done" fields:
+//   resolve {}                      -> cid
+//   fetch {cid}                     block -> prev_cid
+//   chain {from?, depth?}           block per block, newest first -> blocks, records, prev_cid
+//                                   (from defaults to the IPNS head, depth 0 = to the end)
+//   search {query, limit?}          records -> total
+//   stats {}                        -> cache, server and thread pool counters
+// A block frame carries cid, prev_cid and records, an array of records as
+// written to the JSONL output; a records frame carries records only.
+class Daemon {
+public:
+    struct Options {
+        std::string socketPath;
+        size_t cacheBytes;
+        size_t maxClients;
+        size_t workers;
+    };
+
+    struct Stats {
+        size_t blocks;          // in the cache
+        uint64_t bytes;
+        uint64_t hits;
+        uint64_t shared;        // requests that waited for another's fetch
+        uint64_t decoded;
+    };
+
+    using Resolver = std::function<std::string()>;
+
+    // Throws std::runtime_error if the socket cannot be bound
+    Daemon(Options options, Keyring& keyring, JsonlSink& out, SegmentStore* store, ChainManifest* manifest,
+           Resolver resolveHead);
+
+    // Socket from NetworkConfig::daemon_socket, cache size from
+    // daemon_cache_mb, max_connections clients and thread_pool_size workers
+    static Options optionsFromConfig();
+
+    // Serves until stop()
+    void run();
+
+    // Async-signal-safe
+    void stop();
+
+    Stats stats() const;
+
+private:
+    struct Block {
+        std::string prevCID;
+        std::string records;    // comma-separated JSON objects
+        uint32_t count;
+    };
+    using BlockPtr = std::shared_ptr<const Block>;
+    struct Cached {
+        BlockPtr block;
+        std::list<std::string>::iterator lru;
+    };
+
+    std::string handle(const RpcServer::Request& request, RpcServer::Stream& stream);
+    std::string walk(const std::string& from, size_t depth, RpcServer::Stream& stream);
+    BlockPtr block(const std::string& cid);
+    BlockPtr decode(const std::string& cid);
+    void commit();
+
+    const Options options_;
+    Keyring& keyring_;
+    Resolver resolveHead_;
+
+    std::mutex persistMutex_;   // output, store and manifest
+    JsonlSink& out_;
+    SegmentStore* store_;
+    ChainManifest* manifest_;
+    std::vector<std::pair<std::string, ChainManifest::Entry>> uncommitted_;
+    std::unordered_set<std::string> written_;  // blocks output since start
+
+    mutable std::mutex cacheMutex_;
+    std::list<std::string> lru_;    // front = most recently used
+    std::unordered_map<std::string, Cached> cached_;
+    std::unordered_map<std::string, std::shared_future<BlockPtr>> fetching_;
+    Stats stats_{};
+
+    RpcServer server_;
+};
@@ -1,5 +1,45 @@
 #pragma once
+#include <memory>
 #include <string>
-#include "json.hpp"
+#include <string_view>
+#include <vector>
+#include "log_arena.hpp"
 
-nlohmann::json decryptAndParse(const std::string& jsonData, const std::string& privateKeyPath);
+class Keyring;
+
+// Plaintext of one block: the inner logs, each still a JSON document in
+// text form held in the payload's arena, and the link to the previous block
+struct BlockPayload {
+    std::string prevCID;
+    LogArena arena;
+    std::vector<std::string_view> logs;
+};
+
+// Decrypts an envelope {d, k, n, t[, kid]} while it is still arriving: k is
+// the RSA-wrapped AES key (optionally labelled with the id of the key that
+// wrapped it), d the AES-256-GCM ciphertext, n the nonce and t the tag.
+// Ciphertext is base64-decoded and decrypted chunk by chunk, and the
+// plaintext is split into log lines on the fly, so peak memory is about one
+// copy of the plaintext rather than several of the whole envelope. Only d
+// that arrives before k and n has to be held back until they are known.
+class EnvelopeDecoder {
+public:
+    explicit EnvelopeDecoder(Keyring& keyring);
+    ~EnvelopeDecoder();
+
+    EnvelopeDecoder(const EnvelopeDecoder&) = delete;
+    EnvelopeDecoder& operator=(const EnvelopeDecoder&) = delete;
+
+    void feed(const char* data, size_t len);
+
+    // Verifies the GCM tag and only then releases the payload; nothing fed
+    // so far may be trusted before this returns
+    BlockPayload finish();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// Decrypts a complete envelope, e.g. one mapped from the block cache
+BlockPayload decryptBlock(std::string_view envelope, Keyring& keyring);
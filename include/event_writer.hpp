@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+struct LogRecord;
+
+// Newline-delimited JSON events for programs that drive the CLI over a pipe
+// (`--protocol ndjson`). Every line is one object {"event": "...", ...}.
+// Events are built in one buffer and written out with write(2) in large
+// chunks, at line boundaries once kFlushBytes have piled up and at every
+// flush(). Records are serialized straight into the buffer and grouped into
+// "records" events of up to kBatch records from the same block.
+class EventWriter {
+public:
+    static constexpr size_t kBatch = 500;
+    static constexpr size_t kFlushBytes = 256 << 10;
+
+    struct Stats {
+        uint64_t events;
+        uint64_t records;
+        uint64_t bytes;
+        uint64_t writes;
+    };
+
+    explicit EventWriter(int fd);
+    ~EventWriter();     // flushes what is buffered
+
+    EventWriter(const EventWriter&) = delete;
+    EventWriter& operator=(const EventWriter&) = delete;
+
+    // Adds the record to the open "records" event of cid, starting a new
+    // one if the last event was anything else, another block or full
+    void record(const LogRecord& record, std::string_view cid);
+    // Same for a record already serialized as a JSON object
+    void record(std::string_view json, std::string_view cid);
+
+    // {"event": name<, fields>}; fields are JSON members without the braces
+    void event(std::string_view name, std::string_view fields = {});
+    // {"event": name, "text": text}, with terminal colour codes removed
+    void text(std::string_view name, std::string_view text);
+
+    // Writes everything buffered; throws std::runtime_error if the reader
+    // is gone
+    void flush();
+
+    Stats stats() const { return stats_; }
+
+private:
+    std::string& beginRecord(std::string_view cid);
+    void closeBatch();
+    void endLine();
+
+    const int fd_;
+    std::string buffer_;
+    std::string batchCid_;
+    size_t batchSize_ = 0;      // records in the open event, 0 if none is open
+    Stats stats_{};
+};
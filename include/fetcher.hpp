@@ -1,4 +1,12 @@
 #pragma once
 #include <string>
+#include "decryptor.hpp"
+
+class Keyring;
 
 std::string fetchFromIPFS(const std::string& cid);
+
+// Fetches and decrypts cid, streaming a gateway response straight through
+// the decoder instead of buffering it. The envelope is added to the block
+// cache only once its tag has verified.
+BlockPayload fetchAndDecrypt(const std::string& cid, Keyring& keyring);
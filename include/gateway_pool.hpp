@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Set of IPFS gateways ranked by observed latency and error rate. Fetches
+// go to the best gateway; if it has not answered within its p95 latency a
+// hedged request is sent to the runner-up and whichever answers first wins.
+class GatewayPool {
+public:
+    struct Stats {
+        std::string url;
+        double ewmaMs;
+        double p95Ms;
+        double errorRate;
+        uint64_t requests;
+        uint64_t failures;
+        uint64_t hedgesWon;
+    };
+
+    GatewayPool(std::vector<std::string> baseUrls, bool hedging, int maxAttempts);
+
+    // Local gateway (IPFSConfig::gateway_url) first, then public_gateways
+    static GatewayPool& instance();
+
+    // Receives the body of one attempt as it arrives. Throwing aborts the
+    // whole fetch: the content is addressed by its CID, so every gateway
+    // would serve the same bytes.
+    using Consumer = std::function<void(const char* data, size_t len)>;
+
+    std::string fetch(const std::string& cid);
+
+    // Streaming variant: open(attempt) returns the consumer for each
+    // attempt's body. Consumers run on this thread; the HTTP client thread
+    // only queues the bytes, pausing a transfer while kStreamWindow of its
+    // body is still waiting. Returns the attempt that completed first;
+    // consumers of the others may have seen a partial body and must be
+    // discarded. An exception from a consumer cancels every attempt without
+    // counting against their gateways and is rethrown.
+    size_t fetchStream(const std::string& cid, const std::function<Consumer(size_t attempt)>& open);
+
+    std::vector<Stats> stats() const;
+
+private:
+    static constexpr size_t kWindow = 64;
+    static constexpr size_t kStreamWindow = 1 << 20;   // queued body bytes per attempt
+
+    struct Gateway {
+        std::string url;
+        double ewmaMs = 0;
+        double errorRate = 0;
+        uint64_t requests = 0;
+        uint64_t failures = 0;
+        uint64_t hedgesWon = 0;
+        std::chrono::steady_clock::time_point lastFailure;
+        double recent[kWindow] = {};
+        size_t recentCount = 0;
+    };
+
+    std::vector<size_t> ranking() const;
+    std::chrono::milliseconds hedgeDelay(size_t gateway) const;
+    double p95Locked(const Gateway& g) const;
+    void recordSuccess(size_t gateway, double ms, bool hedge);
+    // error = false records a hedge loser: slow, but not broken
+    void recordFailure(size_t gateway, double ms, bool error);
+
+    const bool hedging_;
+    const int maxAttempts_;
+    mutable std::mutex mutex_;
+    std::vector<Gateway> gateways_;
+};
@@ -0,0 +1,106 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+typedef void CURL;
+typedef void CURLM;
+typedef void CURLSH;
+
+// What a streaming consumer did with one chunk of a response body
+enum class DataAction {
+    Accept,     // consumed
+    Pause,      // not consumed; the transfer stalls until resume() and then
+                // delivers the same chunk again
+    Abort,      // fail the transfer
+};
+
+struct HttpRequest {
+    std::string url;
+    bool post = false;                          // Kubo RPC only accepts POST
+    std::chrono::milliseconds timeout{0};       // whole-request deadline, 0 = client default
+    // Optional streaming consumer, run on the client thread; when set the
+    // body is not buffered. It must not block.
+    std::function<DataAction(const char* data, size_t len)> onData;
+};
+
+struct HttpResponse {
+    bool ok = false;
+    long status = 0;
+    std::string body;
+    std::string error;
+    std::chrono::microseconds elapsed{0};
+};
+
+// Shared HTTP client driving every transfer from one curl multi handle on a
+// background thread. Easy handles are recycled from a pool, DNS results and
+// TLS sessions are kept in a share handle, and concurrent requests to the
+// same host are multiplexed over a single HTTP/2 connection where the
+// server supports it. With pooling disabled every request gets a fresh
+// handle and connection, as before.
+class HttpClient {
+public:
+    using Callback = std::function<void(HttpResponse)>;
+
+    HttpClient(bool pooling, size_t poolSize, std::chrono::milliseconds timeout,
+               std::chrono::milliseconds connectTimeout);
+    ~HttpClient();
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    // Process-wide client configured from Config::performance and Config::ipfs
+    static HttpClient& instance();
+
+    // Queues a request; done runs on the client thread and must not block.
+    // Returns an id that can be passed to cancel().
+    uint64_t submit(HttpRequest request, Callback done);
+
+    // Aborts a queued or running request; its callback reports "cancelled"
+    void cancel(uint64_t id);
+
+    // Continues a transfer whose consumer returned DataAction::Pause
+    void resume(uint64_t id);
+
+    // Blocking convenience wrapper around submit()
+    HttpResponse perform(HttpRequest request);
+
+private:
+    struct Transfer;
+
+    void loop();
+    CURL* acquireHandle();
+    void releaseHandle(CURL* easy);
+    void start(Transfer* transfer);
+    void finish(Transfer* transfer, HttpResponse response);
+
+    static size_t onWrite(char* data, size_t size, size_t nmemb, void* userdata);
+    static void lockShare(CURL*, int data, int access, void* self);
+    static void unlockShare(CURL*, int data, void* self);
+
+    const bool pooling_;
+    const size_t poolSize_;
+    const std::chrono::milliseconds timeout_;
+    const std::chrono::milliseconds connectTimeout_;
+
+    CURLM* multi_ = nullptr;
+    CURLSH* share_ = nullptr;
+    std::mutex shareMutexes_[8];
+    std::vector<CURL*> idle_;
+
+    std::mutex mutex_;
+    std::vector<Transfer*> pending_;
+    std::unordered_set<uint64_t> cancelled_;
+    std::unordered_set<uint64_t> resumed_;
+    std::unordered_map<uint64_t, Transfer*> active_;
+    uint64_t nextId_ = 1;
+    bool stopping_ = false;
+    std::thread thread_;
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Resolves IPNS names to their current CID through the Kubo RPC API
+// (POST <api_url>/api/v0/name/resolve) instead of spawning the ipfs CLI.
+// Answers are cached for a TTL and refreshed in the background while they
+// are being used, so repeated lookups of the head never wait on the DHT.
+class IPNSResolver {
+public:
+    IPNSResolver(std::string apiUrl, std::chrono::seconds ttl);
+    ~IPNSResolver();
+
+    IPNSResolver(const IPNSResolver&) = delete;
+    IPNSResolver& operator=(const IPNSResolver&) = delete;
+
+    // Configured from IPFSConfig::api_url and IPFSConfig::ipns_cache_ttl
+    static IPNSResolver& instance();
+
+    // Cached CID for name; resolves synchronously on a miss or expiry
+    std::string resolve(const std::string& name);
+
+    // Always asks the node, and refreshes the cache with the answer
+    std::string resolveFresh(const std::string& name);
+
+private:
+    struct Entry {
+        std::string cid;
+        std::chrono::steady_clock::time_point resolved;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    std::string query(const std::string& name) const;
+    void store(const std::string& name, const std::string& cid);
+    void refreshLoop();
+
+    const std::string apiUrl_;
+    const std::chrono::seconds ttl_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::unordered_map<std::string, Entry> entries_;
+    bool stopping_ = false;
+    std::thread refresher_;
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Byte scanning for decoding blocks: the end of a plain run in a JSON string
+// and UTF-8 validation, both 16 bytes at a time where SSE2 is available.
+
+inline bool isStringSpecial(unsigned char c) {
+    return c == '"' || c == '\\' || c < 0x20;
+}
+
+// First byte in [p, end) that ends a plain run of a JSON string: '"', '\\'
+// or a control character; end if there is none
+inline const char* findStringSpecial(const char* p, const char* end) {
+#if defined(__SSE2__)
+    // Runs inside escaped JSON are often a few bytes long; look at those
+    // a byte at a time before setting up the vector loop
+    for (const char* head = std::min(p + 8, end); p < head; ++p) {
+        if (isStringSpecial(static_cast<unsigned char>(*p))) return p;
+    }
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash));
+        // Unsigned v <= 0x1F exactly when max(v, 0x1F) == 0x1F
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+        int mask = _mm_movemask_epi8(special);
+        if (mask) return p + __builtin_ctz(static_cast<unsigned>(mask));
+        p += 16;
+    }
+#endif
+    for (; p < end; ++p) {
+        if (isStringSpecial(static_cast<unsigned char>(*p))) return p;
+    }
+    return end;
+}
+
+// Length of the well-formed UTF-8 sequence at p, whose first byte is
+// >= 0x80; 0 if it is truncated, overlong, a surrogate or above U+10FFFF
+size_t utf8SequenceLength(const char* p, const char* end);
+
+bool isValidUtf8(std::string_view text);
+
+// Checks UTF-8 that arrives in pieces split anywhere, such as a plaintext
+// coming out of the cipher
+class Utf8Validator {
+public:
+    // false once an ill-formed sequence has been seen
+    bool feed(const char* data, size_t len);
+    // false also if the input stopped inside a sequence
+    bool finish() const { return ok_ && carried_ == 0; }
+
+private:
+    char carry_[4];         // start of a sequence cut off by the last piece
+    size_t carried_ = 0;
+    bool ok_ = true;
+};
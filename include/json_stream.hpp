@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Writes cp as UTF-8 to out (room for 4 bytes) and returns the length
+size_t encodeUtf8(uint32_t cp, char* out);
+
+// Incremental tokenizer for the flat JSON objects a block is made of: the
+// envelope {"d": "...", "k": "...", ...} and the plaintext
+// {"logs": ["...", ...], "prev_cid": "..."}. Input may be split anywhere.
+// String values, top-level or inside a top-level array, are unescaped and
+// handed to the handler piecewise as they arrive, so no value is ever held
+// whole by the scanner. Other values are skipped.
+class JsonStreamScanner {
+public:
+    class Handler {
+    public:
+        virtual ~Handler() = default;
+        // inArray is set for the elements of an array value
+        virtual void beginString(const std::string& key, bool inArray) = 0;
+        virtual void stringData(const char* data, size_t len) = 0;
+        virtual void endString() = 0;
+    };
+
+    explicit JsonStreamScanner(Handler& handler) : handler_(handler) {}
+
+    void feed(const char* data, size_t len);
+
+    // Throws unless a complete object has been consumed
+    void finish();
+
+private:
+    enum class State { Start, KeyOrEnd, Key, Colon, Value, ElementOrEnd, String, Skip, AfterValue, Done };
+
+    size_t scanString(const char* data, size_t i, size_t len);
+    void scanEscape(char c);
+    void emit(const char* data, size_t len);
+    void endString();
+    [[noreturn]] void fail(const std::string& what, size_t at) const;
+
+    Handler& handler_;
+    State state_ = State::Start;
+    uint64_t consumed_ = 0;     // bytes fed before the current chunk, for error offsets
+
+    std::string key_;
+    bool inKey_ = false;
+    bool inArray_ = false;
+
+    int escape_ = 0;            // 0 = none, 1 = after '\', 2..5 = reading \u digits
+    uint32_t unicode_ = 0;
+    uint32_t highSurrogate_ = 0;
+
+    int skipDepth_ = 0;
+    bool skipInString_ = false;
+    bool skipEscape_ = false;
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "log_record.hpp"
+
+// Appends records to a JSONL file from a dedicated writer thread. Callers
+// serialize into large reusable buffers and hand them over whole; the
+// writer batches whatever is queued into one writev and issues at most one
+// fdatasync per flush interval (group commit). The file is rotated to
+// path.1 .. path.<maxFiles-1> at record boundaries once it would exceed
+// maxFileSize. With ioUring the write and its sync go to the kernel as one
+// linked io_uring submission; if the ring cannot be set up, plain writev
+// and fdatasync are used.
+class JsonlSink {
+public:
+    struct Options {
+        std::string path;
+        uint64_t maxFileSize;
+        int maxFiles;
+        std::chrono::milliseconds flushInterval;
+        bool ioUring;
+    };
+
+    struct Stats {
+        uint64_t records;
+        uint64_t bytes;
+        uint64_t writes;    // writev calls or submissions
+        uint64_t syncs;
+        uint64_t rotations;
+        const char* backend;
+    };
+
+    explicit JsonlSink(Options options);
+    ~JsonlSink();   // writes and syncs everything still queued
+
+    JsonlSink(const JsonlSink&) = delete;
+    JsonlSink& operator=(const JsonlSink&) = delete;
+
+    // Configured from LoggingConfig::output_file and the rotation limits
+    static std::unique_ptr<JsonlSink> fromConfig();
+
+    // Not thread safe: one producer at a time. Throws if the writer thread
+    // has failed since the last call.
+    void write(const LogRecord& record);
+
+    // Hands the partly filled buffer to the writer without waiting
+    void flush();
+
+    // Flushes and waits until everything written so far is on disk
+    void sync();
+
+    // Producer thread only, like write()
+    Stats stats() const;
+
+private:
+    class Backend;
+
+    void handOff();
+    void throwIfFailed();
+    void writerLoop();
+    void writeBatch(std::vector<std::string>& batch, bool syncAfter);
+    void openFile();
+    void rotate();
+
+    const Options options_;
+    std::unique_ptr<Backend> backend_;
+    int fd_ = -1;
+    uint64_t fileSize_ = 0;
+
+    std::string current_;           // producer's buffer
+    uint64_t records_ = 0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;      // writer: work queued or stopping
+    std::condition_variable done_;      // producers: buffers recycled or synced
+    std::deque<std::string> queue_;
+    std::vector<std::string> free_;
+    uint64_t queuedSeq_ = 0;            // buffers handed off
+    uint64_t syncedSeq_ = 0;            // buffers written and synced
+    uint64_t syncWanted_ = 0;
+    bool stopping_ = false;
+    std::string error_;
+    Stats stats_{};
+    std::thread writer_;
+};
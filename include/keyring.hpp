@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+typedef struct evp_pkey_st EVP_PKEY;
+
+// RSA private keys loaded once and shared by every decrypting thread.
+// Each thread gets its own EVP_PKEY_CTX per key, and unwrapped AES session
+// keys are cached by a hash of the wrapped key, so blocks that reuse a
+// session key skip RSA entirely. Keys are added during startup only;
+// unwrap() is safe to call from any number of threads afterwards.
+class Keyring {
+public:
+    explicit Keyring(size_t sessionCacheSize = 1024);
+    ~Keyring();
+
+    Keyring(const Keyring&) = delete;
+    Keyring& operator=(const Keyring&) = delete;
+
+    // Parses a PEM private key and returns its key id
+    std::string addKeyFile(const std::string& pemPath);
+
+    // Loads every existing file of paths; returns how many keys were added
+    size_t loadKeyFiles(const std::vector<std::string>& paths);
+
+    bool empty() const { return keys_.empty(); }
+    size_t keyCount() const { return keys_.size(); }
+
+    // Unwraps an RSA-OAEP wrapped session key. When keyId names a loaded
+    // key only that key is tried, otherwise each key is tried in turn.
+    std::vector<unsigned char> unwrap(const std::vector<unsigned char>& wrapped, std::string_view keyId = {});
+
+    uint64_t sessionCacheHits() const;
+    uint64_t sessionCacheMisses() const;
+
+private:
+    struct Key {
+        uint64_t serial;        // identifies per-thread contexts for this key
+        std::string id;         // hex prefix of SHA-256 over the public key DER
+        EVP_PKEY* pkey;
+    };
+
+    bool tryUnwrap(const Key& key, const std::vector<unsigned char>& wrapped, std::vector<unsigned char>& out) const;
+
+    std::vector<Key> keys_;
+
+    size_t sessionCacheSize_;
+    mutable std::mutex sessionMutex_;
+    std::unordered_map<std::string, std::vector<unsigned char>> sessionKeys_;
+    std::deque<std::string> sessionOrder_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
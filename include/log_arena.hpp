@@ -0,0 +1,103 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// Recycles arena chunks across blocks. A block's arena lives only until its
+// logs are written, and the next block needs about as much again, so its
+// chunks are kept for reuse rather than freed: a block then costs no heap
+// allocations for its log bytes, and no page faults on fresh memory. Up to
+// maxBytes of idle chunks are kept; the rest go back to the heap.
+class ChunkPool {
+public:
+    static constexpr size_t kChunkSize = 64 * 1024;
+
+    // Hands chunks back to their pool, or frees them if they have none
+    struct Release {
+        ChunkPool* pool = nullptr;
+        void operator()(char* chunk) const;
+    };
+    using Chunk = std::unique_ptr<char[], Release>;
+
+    struct Stats {
+        uint64_t taken;         // chunks handed out
+        uint64_t reused;        // of those, how many came from the pool
+        uint64_t dropped;       // returned to a full pool and freed
+        size_t idleBytes;
+    };
+
+    explicit ChunkPool(size_t maxBytes) : maxIdle_(maxBytes / kChunkSize) {}
+    ~ChunkPool();
+
+    ChunkPool(const ChunkPool&) = delete;
+    ChunkPool& operator=(const ChunkPool&) = delete;
+
+    // PerformanceConfig::arena_pool_mb; never destroyed, as arenas held by
+    // static objects may outlive it
+    static ChunkPool& instance();
+
+    // kChunkSize bytes, uninitialized
+    Chunk take();
+
+    Stats stats() const;
+
+private:
+    void give(char* chunk);
+
+    const size_t maxIdle_;
+    mutable std::mutex mutex_;
+    std::vector<char*> idle_;
+    std::atomic<uint64_t> taken_{0};
+    std::atomic<uint64_t> reused_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+// Bump allocator owning the bytes of one block's logs. Everything is freed
+// at once when the arena goes away. Chunks never move, so views handed out
+// stay valid when the arena itself is moved. Chunks of the default size come
+// from ChunkPool::instance() and go back there.
+class LogArena {
+public:
+    explicit LogArena(size_t chunkSize = ChunkPool::kChunkSize) : chunkSize_(chunkSize) {}
+
+    LogArena(LogArena&&) noexcept = default;
+    LogArena& operator=(LogArena&&) noexcept = default;
+    LogArena(const LogArena&) = delete;
+    LogArena& operator=(const LogArena&) = delete;
+
+    void* allocate(size_t size, size_t align);
+
+    template <typename T>
+    T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    std::string_view copy(std::string_view s);
+
+    // Builds a string piecewise; nothing else may be allocated in between
+    void beginString();
+    void appendString(const char* data, size_t len);
+    std::string_view endString();
+
+    // Takes over other's chunks, so that views into them live as long as
+    // this arena; other is left empty
+    void absorb(LogArena&& other);
+
+    size_t bytesUsed() const { return used_; }
+    size_t bytesReserved() const { return reserved_; }
+
+private:
+    char* grow(size_t size, size_t keep);
+
+    size_t chunkSize_;
+    std::vector<ChunkPool::Chunk> chunks_;
+    char* cursor_ = nullptr;
+    char* end_ = nullptr;
+    char* open_ = nullptr;      // start of the string being built
+    size_t used_ = 0;
+    size_t reserved_ = 0;
+};
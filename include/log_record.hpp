@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "log_arena.hpp"
+
+// A field of a log that LogRecord does not model, kept as its JSON text
+struct RawField {
+    std::string_view key;
+    std::string_view json;
+};
+
+// One inner log, parsed once into typed fields. Strings are views into the
+// arena of the block the record came from, so records must not outlive it.
+// Fields that are missing or of an unexpected type are not set in `fields`;
+// the latter, like every unknown key, are kept verbatim in `extras`.
+struct LogRecord {
+    enum Field : uint8_t {
+        EventId = 1 << 0,
+        Type = 1 << 1,
+        Message = 1 << 2,
+        Source = 1 << 3,
+        Timestamp = 1 << 4,         // integer seconds since the epoch
+        TimestampText = 1 << 5,     // ISO 8601 string, parsed into timestamp; text kept in extras
+    };
+
+    int64_t eventId = 0;
+    int64_t timestamp = 0;
+    std::string_view message;
+    std::string_view source;
+    const RawField* extras = nullptr;
+    const uint16_t* patterns = nullptr;     // RuleSet ids, see tagLogPatterns()
+    uint32_t extraCount = 0;
+    uint16_t typeId = 0;            // see logTypeName(); 0 = none
+    uint8_t fields = 0;
+    uint8_t patternCount = 0;
+
+    bool has(Field f) const { return (fields & f) != 0; }
+    std::span<const RawField> extraFields() const { return {extras, extraCount}; }
+    std::span<const uint16_t> patternIds() const { return {patterns, patternCount}; }
+    const RawField* extra(std::string_view key) const;
+};
+
+// Log types are a small closed set in practice, so each distinct string is
+// stored once for the life of the process and records carry its id
+uint16_t internLogType(std::string_view name);
+std::string_view logTypeName(uint16_t id);
+
+// Seconds since the epoch of "YYYY-MM-DDTHH:MM:SS[.fff][Z|+hh:mm|-hh:mm]",
+// no zone meaning UTC; std::nullopt if the text is not in that form
+std::optional<int64_t> parseIsoTimestamp(std::string_view text);
+
+// Parses one log line (a JSON object); strings that need unescaping and all
+// raw fields are copied into arena. Throws std::runtime_error if the line
+// is not a valid JSON object.
+LogRecord parseLogRecord(std::string_view line, LogArena& arena);
+
+// Parses every line and sorts the records newest event first. Blocks of
+// many thousand lines are parsed in slices on ThreadPool::instance().
+std::vector<LogRecord> parseAndSortLogs(const std::vector<std::string_view>& lines, LogArena& arena);
+// Newest event_id first, then newest timestamp; see log_sort.hpp
+void sortLogRecords(std::vector<LogRecord>& records);
+
+// Compact JSON of one field as printed by the CLI, or "null" if absent
+std::string logFieldJson(const LogRecord& record, std::string_view key);
+
+// Appends s as a JSON string literal, escaping quotes, backslashes and
+// control characters
+void appendJsonString(std::string& out, std::string_view s);
+
+// Appends the record as a JSON object with keys in sorted order,
+// byte-for-byte what nlohmann::json::dump(indent) gives; the default -1 is
+// the compact single-line form used for JSONL
+void appendLogRecordJson(std::string& out, const LogRecord& record, int indent = -1);
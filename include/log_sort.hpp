@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "chain_walker.hpp"
+#include "log_record.hpp"
+
+// Integer sort key of a record: ascending key order is output order, newest
+// event first, ties broken by the newer timestamp. Missing values order as
+// the oldest possible.
+struct LogOrderKey {
+    uint64_t primary;       // event_id
+    uint64_t secondary;     // timestamp
+
+    friend bool operator<(const LogOrderKey& a, const LogOrderKey& b) {
+        return a.primary != b.primary ? a.primary < b.primary : a.secondary < b.secondary;
+    }
+};
+
+LogOrderKey logOrderKey(const LogRecord& record);
+
+// Merges the blocks of a chain walk, each sorted by sortLogRecords, into one
+// stream in the same order. Blocks arrive newest first but their event
+// ranges may overlap, so a record is only released once it orders before
+// the newest record of the latest block: anything older may still be
+// matched by a block not yet fetched. At most `window` blocks are held; past
+// that the front of the merge is released regardless, and any record that
+// later turns out to belong before it is counted as late.
+class LogMerger {
+public:
+    using Emit = std::function<void(const LogRecord& record, const ChainBlock& block)>;
+
+    LogMerger(size_t window, Emit emit);
+
+    void push(ChainBlock block);
+
+    // Releases everything still held; call once the walk is over
+    void finish();
+
+    size_t heldBlocks() const { return runs_.size(); }
+    size_t lateRecords() const { return late_; }
+
+private:
+    struct Run {
+        ChainBlock block;
+        size_t next = 0;
+        LogOrderKey key() const { return logOrderKey(block.logs[next]); }
+    };
+
+    static bool later(const std::unique_ptr<Run>& a, const std::unique_ptr<Run>& b);
+    void releaseFront();
+
+    size_t window_;
+    Emit emit_;
+    std::vector<std::unique_ptr<Run>> runs_;    // heap, front = next record to release
+    bool emitted_ = false;
+    LogOrderKey last_{};
+    size_t late_ = 0;
+};
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file. Move-only; unmaps on destruction.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns std::nullopt if the file does not exist; throws on other errors
+    static std::optional<MappedFile> open(const std::string& path);
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return {data_, size_}; }
+
+private:
+    MappedFile(const char* data, size_t size) : data_(data), size_(size) {}
+    void reset();
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Case-insensitive (ASCII) multi-literal matcher: an Aho-Corasick automaton
+// compiled to a DFA over byte classes, fronted by a Teddy-style SIMD
+// prefilter on the first two bytes of every pattern. Stretches of text in
+// which no pattern can start are skipped 32 bytes at a time without
+// touching the DFA.
+class PatternMatcher {
+public:
+    explicit PatternMatcher(const std::vector<std::string>& patterns);
+
+    size_t size() const { return patterns_.size(); }
+    const std::string& pattern(uint16_t id) const { return patterns_[id]; }
+
+    // Ids of the patterns occurring in text, sorted and without duplicates.
+    // ids is cleared first.
+    void match(std::string_view text, std::vector<uint16_t>& ids) const;
+
+    bool matchesAny(std::string_view text) const;
+
+    // Prefilter in use: "avx2", "ssse3" or "scalar"
+    static const char* kernelName();
+
+private:
+    template <typename OnMatch>
+    void run(std::string_view text, OnMatch&& onMatch) const;
+
+    std::vector<std::string> patterns_;
+
+    // DFA: row offsets are premultiplied by stride_; bit 0 of a transition
+    // marks an accepting target state
+    std::array<uint8_t, 256> classes_{};
+    uint32_t stride_ = 0;
+    std::vector<uint32_t> delta_;
+    std::vector<uint32_t> outputBegin_;     // per state, into outputs_
+    std::vector<uint16_t> outputs_;
+
+    // Prefilter: per-bucket low/high nibble masks of the case-folded first
+    // byte, then of the second byte, each repeated in both 128-bit lanes
+    alignas(32) uint8_t masks_[4][32] = {};
+    bool empty_ = true;
+};
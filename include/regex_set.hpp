@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A set of regexes matched together, ASCII case-insensitively and
+// unanchored unless a pattern starts with ^ or ends with $.
+//
+// Supported: literals, ., [...] with ranges and negation, \d \w \s and
+// their negations, escaped metacharacters, (...) and (?:...), |, and the
+// quantifiers * + ? {n} {n,} {n,m} (a trailing ? for laziness is accepted
+// and ignored, as only whether a pattern matches is reported). Anything
+// else throws std::runtime_error.
+//
+// All patterns are compiled into one Thompson NFA that is run as a lazy
+// DFA: a DFA state (a set of NFA states) and its transitions are built the
+// first time the text needs them and cached. The cache holds at most
+// maxStates states; when it is full it is dropped and rebuilt from the
+// current state, so memory stays bounded on adversarial rule sets while
+// ordinary text runs at one table lookup per byte.
+class RegexSet {
+public:
+    RegexSet(const std::vector<std::string>& patterns, size_t maxStates);
+    ~RegexSet();
+
+    // Throws std::runtime_error if pattern is outside the supported syntax
+    static void validate(std::string_view pattern);
+
+    RegexSet(const RegexSet&) = delete;
+    RegexSet& operator=(const RegexSet&) = delete;
+
+    size_t size() const { return required_.size(); }
+
+    // Lowercase literals one of which every match of pattern i contains,
+    // usable as a prefilter; empty if there is no such set worth using
+    const std::vector<std::string>& requiredLiterals(size_t i) const { return required_[i]; }
+
+    // Indices of the patterns matching text, sorted; ids is cleared first.
+    // Thread safe: concurrent callers each take their own DFA cache.
+    void match(std::string_view text, std::vector<uint16_t>& ids) const;
+
+    struct Stats {
+        size_t nfaStates;
+        size_t dfaStates;       // cached, over all idle caches
+        uint64_t cacheResets;
+    };
+    Stats stats() const;
+
+private:
+    struct Cache;
+    struct Node;
+    class Parser;
+    struct NfaState {
+        enum Op : uint8_t { Byte, Split, Match } op;
+        explicit NfaState(Op op) : op(op) {}
+        bool atEnd = false;         // Match: only at the end of the text
+        uint16_t pattern = 0;       // Match
+        uint32_t out = 0, out1 = 0;
+        std::bitset<256> bytes;     // Byte
+    };
+
+    uint32_t compile(const Node& node, uint32_t next);
+    uint32_t addState(NfaState state);
+    void closure(Cache& cache, uint32_t start) const;
+    void clearSeen(Cache& cache) const;
+    static std::string stateKey(std::vector<uint32_t>& set);
+    uint32_t addDfaState(Cache& cache, const std::vector<uint32_t>& set, std::string key) const;
+    uint32_t step(Cache& cache, uint32_t from, unsigned char byte) const;
+    void reset(Cache& cache) const;
+
+    std::unique_ptr<Cache> takeCache() const;
+    void returnCache(std::unique_ptr<Cache> cache) const;
+
+    std::vector<NfaState> nfa_;
+    std::vector<uint32_t> starts_;          // closure at the start of the text
+    std::vector<uint32_t> restarts_;        // unanchored starts, joined at every byte
+    std::vector<std::vector<std::string>> required_;
+    std::array<uint8_t, 256> classes_{};
+    std::vector<unsigned char> representative_;     // one byte per class
+    size_t maxStates_;
+
+    mutable std::mutex cacheMutex_;
+    mutable std::vector<std::unique_ptr<Cache>> idle_;
+    mutable std::atomic<uint64_t> cacheResets_{0};
+};
@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Request/response server on a Unix domain socket. Every message is a
+// frame: a 4-byte big-endian length, then that many bytes of JSON.
+//
+// A request is {"id": <unsigned>, "method": "...", "params": {...}}. A
+// client may have many requests in flight on one connection; each is
+// answered by any number of frames {"id": <id>, "type": "...", ...}
+// streamed as the handler produces them, ending with exactly one frame of
+// type "done" or "error". {"id": <id>, "method": "cancel"} cancels request
+// id, which then ends with an error frame.
+//
+// One thread runs the socket event loop and does all socket I/O; handlers
+// run on a pool of worker threads. A handler whose client reads slowly
+// blocks in send() once the connection has maxPending bytes queued.
+class RpcServer {
+public:
+    struct Options {
+        std::string socketPath;
+        size_t maxClients;
+        size_t workers;
+        size_t maxPending;      // bytes queued per connection
+        size_t maxInFlight;     // requests per connection
+    };
+
+    struct Request {
+        uint64_t id;
+        std::string method;
+        std::string params;     // JSON text, "{}" when absent
+    };
+
+    class Stream {
+    public:
+        uint64_t id() const { return id_; }
+
+        // Queues {"id": <id>, "type": type<, fields>}; fields are JSON
+        // members without the braces. False once the client is gone or
+        // cancelled the request, after which nothing more is sent.
+        bool send(std::string_view type, std::string_view fields);
+
+        bool cancelled() const;
+
+    private:
+        friend class RpcServer;
+        struct Connection;
+        Stream(std::shared_ptr<Connection> connection, uint64_t id,
+               std::shared_ptr<std::atomic<bool>> cancelled, size_t maxPending);
+
+        std::shared_ptr<Connection> connection_;
+        uint64_t id_;
+        std::shared_ptr<std::atomic<bool>> cancelled_;
+        size_t maxPending_;
+    };
+
+    // Returns the fields of the final "done" frame; a thrown exception
+    // becomes an "error" frame with its message
+    using Handler = std::function<std::string(const Request&, Stream&)>;
+
+    struct Stats {
+        size_t clients;
+        uint64_t connections;
+        uint64_t requests;
+        uint64_t errors;
+        uint64_t framesOut;
+        uint64_t bytesOut;
+    };
+
+    // Binds the socket, replacing a stale one; throws std::runtime_error
+    // if it is in use by a running server or cannot be created
+    RpcServer(Options options, Handler handler);
+    ~RpcServer();
+
+    RpcServer(const RpcServer&) = delete;
+    RpcServer& operator=(const RpcServer&) = delete;
+
+    // Serves until stop(), then waits for the running handlers
+    void run();
+
+    // Async-signal-safe
+    void stop();
+
+    Stats stats() const;
+
+private:
+    using Connection = Stream::Connection;
+    struct Job {
+        std::shared_ptr<Connection> connection;
+        Request request;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+
+    void accept();
+    bool readFrom(const std::shared_ptr<Connection>& connection);
+    bool writeTo(Connection& connection);
+    void dispatch(const std::shared_ptr<Connection>& connection, std::string_view frame);
+    void reject(Connection& connection, uint64_t id, const std::string& message);
+    void workerLoop();
+    void finish(const Job& job, bool ok, const std::string& fields);
+
+    const Options options_;
+    Handler handler_;
+    int listenFd_ = -1;
+    int wakeFd_ = -1;
+    std::atomic<bool> stopping_{false};
+    std::vector<std::shared_ptr<Connection>> connections_;
+
+    std::mutex jobsMutex_;
+    std::condition_variable jobsReady_;
+    std::deque<Job> jobs_;
+    bool closing_ = false;
+    std::vector<std::thread> workers_;
+
+    std::atomic<uint64_t> connectionCount_{0}, requests_{0}, errors_{0}, framesOut_{0}, bytesOut_{0};
+    std::atomic<size_t> clients_{0};
+};
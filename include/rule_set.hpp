@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "log_arena.hpp"
+#include "log_record.hpp"
+#include "pattern_matcher.hpp"
+#include "regex_set.hpp"
+
+// The threat rules messages are tagged with: LoggingConfig::default_patterns
+// as literals, followed by the rules file. Matching is case-insensitive.
+//
+// Literals go to a PatternMatcher. Regexes are compiled together into one
+// RegexSet, and the literals every match of a regex must contain are added
+// to the same PatternMatcher. A message enters the regex DFA only if one of
+// those literals occurs in it, or if some regex has no usable literal.
+class RuleSet {
+public:
+    struct Rule {
+        std::string text;
+        bool regex;
+        int line;       // in the rules file; 0 for built-in rules
+    };
+
+    // One rule per line; blank lines and lines starting with # are skipped.
+    // A line is a regex if it contains any of \ ^ $ . | ? * + ( ) [ ] { }
+    static std::vector<Rule> parseRules(std::istream& in);
+
+    // Invalid regexes are left out and described in errors()
+    RuleSet(std::vector<Rule> rules, size_t maxDfaStates);
+
+    // Built on first use from LoggingConfig::default_patterns and
+    // LoggingConfig::patterns_file
+    static const RuleSet& instance();
+
+    size_t size() const { return rules_.size(); }
+    const Rule& rule(uint16_t id) const { return rules_[id]; }
+    const std::vector<std::string>& errors() const { return errors_; }
+
+    // Ids of the rules matching text, sorted; ids is cleared first
+    void match(std::string_view text, std::vector<uint16_t>& ids) const;
+
+    struct Stats {
+        size_t literals;
+        size_t regexes;
+        size_t unfiltered;      // regexes without a required literal
+        uint64_t messages;
+        uint64_t regexRuns;     // messages that entered the DFA
+        RegexSet::Stats dfa;
+    };
+    Stats stats() const;
+
+private:
+    std::vector<Rule> rules_;
+    std::vector<std::string> errors_;
+
+    // Literal rules, then the required literals of the regexes; entry i of
+    // literalRule_ is the rule id of pattern i, or kRegexHint
+    std::unique_ptr<PatternMatcher> literals_;
+    std::vector<uint16_t> literalRule_;
+    static constexpr uint16_t kRegexHint = UINT16_MAX;
+
+    std::unique_ptr<RegexSet> regexes_;
+    std::vector<uint16_t> regexRule_;       // rule id of each regex
+    size_t unfiltered_ = 0;
+
+    mutable std::atomic<uint64_t> messages_{0};
+    mutable std::atomic<uint64_t> regexRuns_{0};
+};
+
+// Tags each record with the rules found in its message; the ids live in
+// arena. Does nothing when SecurityConfig::enable_pattern_matching is off.
+// Large batches are split across ThreadPool::instance().
+void tagLogPatterns(std::vector<LogRecord>& records, LogArena& arena);
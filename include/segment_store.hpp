@@ -0,0 +1,144 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "log_record.hpp"
+#include "mapped_file.hpp"
+#include "text_index.hpp"
+
+// Local, append-only store of decrypted records, so questions about past
+// logs do not mean re-walking IPFS or re-parsing logs_output.jsonl.
+//
+// Records are kept in immutable segment files of up to segmentRecords
+// records. Each segment has fixed-width columns (event_id, timestamp, type,
+// present fields, line offset) and the records themselves as compact JSON,
+// deflated in frames of indexStride records. A sparse index with the
+// event_id and timestamp range of every frame sits next to the columns.
+// Segments are mapped read-only, so a lookup checks the index, scans the
+// columns of matching frames only and inflates just the frames with hits.
+//
+// A segment is written under a temp name and renamed into place, and never
+// changes after that: every flush seals what is pending as a new segment.
+// Short segments left by frequent flushes are merged by a compaction step
+// into a new segment named after the range of sequence numbers it
+// replaces; once it is in place the inputs are removed, and a segment
+// whose range another one covers is dropped on load, so a crash in between
+// leaves no duplicates. The blocks file lists every stored block with the
+// segments holding its records, so a block that lost a damaged segment is
+// stored again.
+//
+// With Options::index, records are also added to a TextIndex as they are
+// appended, keyed by their position in the store, and the index is saved
+// in the same directory on every flush. An index that is behind the
+// segments (or ahead of them, after a damaged segment was dropped) is
+// brought up to date from the segments on load.
+class SegmentStore {
+public:
+    struct Options {
+        std::string dir;
+        size_t segmentRecords;
+        size_t indexStride;
+        bool compress;
+        bool index;
+    };
+
+    struct Stats {
+        size_t segments;
+        uint64_t records;
+        uint64_t diskBytes;
+        uint64_t rawBytes;      // JSON text before compression
+        size_t blocks;
+        TextIndex::Stats index;     // zero without an index
+    };
+
+    explicit SegmentStore(Options options);
+    ~SegmentStore();
+
+    SegmentStore(const SegmentStore&) = delete;
+    SegmentStore& operator=(const SegmentStore&) = delete;
+
+    // Configured from StoreConfig; the directory is created if needed
+    static std::unique_ptr<SegmentStore> fromConfig();
+
+    // Buffers a record of block cid; a segment is sealed each time
+    // segmentRecords records are pending
+    void append(const LogRecord& record, const std::string& cid);
+
+    // True once a block's records were sealed by flush()
+    bool hasBlock(const std::string& cid) const;
+
+    // Seals everything pending, records the blocks it came from and
+    // compacts short segments
+    void flush();
+
+    // Compact JSON of the matching sealed records, oldest segment first
+    std::vector<std::string> findEventId(int64_t eventId) const;
+    std::vector<std::string> findTimeRange(int64_t from, int64_t to, size_t limit) const;
+
+    // Calls visit with the compact JSON of every sealed record, oldest
+    // segment first, inflating one frame at a time
+    void forEach(const std::function<void(std::string_view)>& visit) const;
+
+    struct SearchResult {
+        std::vector<std::string> records;   // compact JSON, at most limit
+        size_t total;
+    };
+
+    // Sealed records matching a TextIndex query, oldest first. Throws
+    // std::runtime_error if the store has no index or the query is invalid.
+    SearchResult search(std::string_view query, size_t limit) const;
+
+    Stats stats() const;
+
+private:
+    struct Row {
+        int64_t eventId;
+        int64_t timestamp;
+        std::string type;
+        uint8_t fields;
+        size_t offset;      // into Pending::text
+        size_t length;
+        uint32_t block;     // into pendingBlocks_, kNoBlock once sealed
+    };
+
+    struct Pending {
+        std::vector<Row> rows;
+        std::string text;
+    };
+
+    // A block appended since the last flush, with the segments its records
+    // were sealed into so far
+    struct PendingBlock {
+        std::string cid;
+        std::vector<uint32_t> segments;
+    };
+
+    struct Segment;
+
+    void load();
+    void loadIndex();
+    void seal();
+    void compact();
+    void readRows(const Segment& segment, Pending& out) const;
+    void writeSegment(const std::string& path, const Pending& pending, size_t first, size_t count);
+    std::string segmentPath(uint32_t first, uint32_t last) const;
+
+    template <typename Match>
+    std::vector<std::string> scan(Match&& match, size_t limit) const;
+
+    const Options options_;
+    std::vector<std::unique_ptr<Segment>> segments_;
+    uint32_t nextSeq_ = 0;
+    Pending pending_;
+    std::vector<PendingBlock> pendingBlocks_;
+    std::unordered_map<std::string, uint32_t> pendingBlockIds_;   // cid -> index into pendingBlocks_
+    std::unordered_set<std::string> blocks_;
+    uint64_t sealedRecords_ = 0;
+    std::unique_ptr<TextIndex> index_;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "log_record.hpp"
+
+// Inverted index from the tokens of a record's message, source and type to
+// the ids of the records containing them. Ids are assigned by the caller
+// and must increase.
+//
+// A posting list is a chain of varint deltas, cut into blocks of kBlock
+// postings with a skip entry (the id before the block and its byte offset)
+// at the start of each, so AND queries decode the shortest list and jump
+// through the others block by block.
+//
+// Postings are persisted as delta files in dir: save() writes only what was
+// added since the previous save, and folds all files into one once there
+// are more than kMaxFiles. The constructor loads them back.
+class TextIndex {
+public:
+    static constexpr uint32_t kBlock = 128;
+    static constexpr size_t kMaxFiles = 8;
+    static constexpr size_t kMaxToken = 64;
+
+    explicit TextIndex(std::string dir);
+
+    // Lowercased runs of letters, digits, non-ASCII bytes and . _ - @,
+    // trimmed of . and -; tokens longer than kMaxToken are dropped. Tokens
+    // are views into lowered.
+    static void tokenize(std::string_view text, std::string& lowered, std::vector<std::string_view>& tokens);
+
+    // Records indexed so far: every id added is below it
+    uint32_t size() const { return end_; }
+
+    void add(uint32_t id, const LogRecord& record);
+
+    // Forgets everything, in memory and on disk
+    void clear();
+
+    // Writes what was added since the last save
+    void save();
+
+    // Ids of the records matching query, ascending. Terms are ANDed when
+    // adjacent or joined by AND, and AND binds tighter than OR:
+    //   "alice host0 OR root" = (alice AND host0) OR root
+    // A term that tokenizes into several tokens needs all of them. Throws
+    // std::runtime_error on an empty query or a dangling operator.
+    std::vector<uint32_t> search(std::string_view query) const;
+
+    struct Stats {
+        size_t terms;
+        uint64_t postings;
+        uint64_t bytes;         // encoded postings and skips
+        size_t files;
+    };
+    Stats stats() const;
+
+private:
+    struct Skip {
+        uint32_t base;          // id before the block, 0 for the first
+        uint32_t offset;
+    };
+    struct Postings {
+        std::string bytes;
+        std::vector<Skip> skips;    // blocks after the first
+        uint32_t count = 0;
+        uint32_t last = 0;
+        uint32_t saved = 0;         // postings already in a file
+    };
+    class Cursor;
+    struct TermHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+
+    void append(Postings& postings, uint32_t id);
+    void load();
+    void writeFile(bool full);
+    std::vector<uint32_t> intersect(const std::vector<std::string>& tokens) const;
+
+    std::string dir_;
+    std::unordered_map<std::string, Postings, TermHash, std::equal_to<>> terms_;
+    uint32_t end_ = 0;
+    uint32_t savedEnd_ = 0;
+    uint32_t nextSeq_ = 0;
+    std::vector<std::string> files_;
+
+    // Scratch for add()
+    std::string text_;
+    std::string lowered_;
+    std::vector<std::string_view> tokens_;
+};
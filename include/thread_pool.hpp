@@ -0,0 +1,124 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Work-stealing executor for the CPU-bound parts of fetching: decrypting
+// blocks, parsing their logs and scanning them for patterns. Every worker
+// has a deque per priority. A worker takes its own newest task first and
+// steals the oldest task of another worker when it runs dry; higher
+// priorities are looked for everywhere before lower ones. Tasks submitted
+// from a worker go to its own deque, others are dealt out round robin.
+//
+// A thread waiting for tasks it submitted runs queued tasks meanwhile
+// (Group::wait, runOne), so waiting on the pool from one of its own workers
+// cannot starve it. Waiting on a future from submit() does not help.
+class ThreadPool {
+public:
+    enum class Priority { High, Normal, Low };
+
+    struct WorkerStats {
+        uint64_t tasks;
+        uint64_t steals;        // tasks taken from another worker's deque
+        double utilization;     // share of the time since start spent running tasks
+    };
+
+    struct Stats {
+        std::vector<WorkerStats> workers;
+        uint64_t submitted;
+        uint64_t helped;        // tasks run by threads waiting on the pool
+    };
+
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(size_t workers);
+    ~ThreadPool();  // runs everything still queued, then joins the workers
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // PerformanceConfig::thread_pool_size workers
+    static ThreadPool& instance();
+
+    // Queues task; it must not throw
+    void post(Task task, Priority priority = Priority::Normal);
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& f, Priority priority = Priority::Normal) {
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(f));
+        auto result = task->get_future();
+        post([task] { (*task)(); }, priority);
+        return result;
+    }
+
+    // Runs one queued task of the given priority on the calling thread;
+    // false if there was none
+    bool runOne(Priority priority = Priority::Normal);
+
+    size_t size() const { return workers_.size(); }
+
+    Stats stats() const;
+
+    // Tasks that are waited for together. wait() runs queued tasks of the
+    // group's priority until the group's are done, then rethrows the first
+    // exception one of them threw.
+    class Group {
+    public:
+        explicit Group(ThreadPool& pool, Priority priority = Priority::Normal)
+            : pool_(pool), priority_(priority) {}
+        ~Group();   // waits, dropping any exception
+
+        Group(const Group&) = delete;
+        Group& operator=(const Group&) = delete;
+
+        void run(Task task);
+        void wait();
+
+    private:
+        ThreadPool& pool_;
+        const Priority priority_;
+        std::mutex mutex_;
+        std::condition_variable done_;
+        size_t pending_ = 0;
+        std::exception_ptr error_;
+    };
+
+private:
+    static constexpr size_t kPriorities = 3;
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> queues[kPriorities];
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> busyNs{0};
+        std::thread thread;
+    };
+
+    // Looks for a task of priority first..last, own deque first; self is
+    // the caller's worker index, or size() for other threads
+    bool take(size_t self, size_t first, size_t last, Task& task);
+    void workerLoop(size_t self);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    const std::chrono::steady_clock::time_point started_;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> nextWorker_{0};
+    std::atomic<uint64_t> submitted_{0};
+    std::atomic<uint64_t> helped_{0};
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+};
@@ -1,7 +1,27 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <string>
-#include "json.hpp"
 
 std::vector<unsigned char> base64Decode(const std::string& input);
-std::vector<nlohmann::json> parseAndSortLogs(const nlohmann::json& logsArray);
+
+// File built under a temporary name next to path and moved into place by
+// commit(). Dropping it uncommitted removes the temporary.
+class AtomicFile {
+public:
+    explicit AtomicFile(std::string path);
+    ~AtomicFile();
+
+    AtomicFile(const AtomicFile&) = delete;
+    AtomicFile& operator=(const AtomicFile&) = delete;
+
+    void write(const char* data, size_t len);
+    void commit();
+    uint64_t size() const { return size_; }
+
+private:
+    std::string path_;
+    std::string tmp_;
+    int fd_ = -1;
+    uint64_t size_ = 0;
+};
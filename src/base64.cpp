@@ -0,0 +1,227 @@
+#include "base64.hpp"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BASE64_X86 1
+#endif
+
+namespace {
+
+struct DecodeTable {
+    signed char value[256];
+
+    constexpr DecodeTable() : value() {
+        for (int i = 0; i < 256; ++i) value[i] = -1;
+        const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; ++i) value[static_cast<unsigned char>(alphabet[i])] = static_cast<signed char>(i);
+    }
+};
+
+constexpr DecodeTable kTable;
+
+uint32_t sextet(const char* g, size_t i, size_t pos) {
+    int v = kTable.value[static_cast<unsigned char>(g[i])];
+    if (v < 0) throw Base64Error("Invalid base64 character", pos + i);
+    return static_cast<uint32_t>(v);
+}
+
+// Decodes the group of four characters at g, found at stream offset pos.
+// A padded group must be the last one; padded tracks that across calls.
+size_t decodeGroup(const char* g, unsigned char* out, size_t pos, bool& padded) {
+    if (padded) throw Base64Error("Base64 data after padding", pos);
+    uint32_t bits = (sextet(g, 0, pos) << 18) | (sextet(g, 1, pos) << 12);
+    if (g[2] == '=') {
+        if (g[3] != '=') throw Base64Error("Invalid base64 padding", pos + 3);
+        out[0] = static_cast<unsigned char>(bits >> 16);
+        padded = true;
+        return 1;
+    }
+    bits |= sextet(g, 2, pos) << 6;
+    if (g[3] == '=') {
+        out[0] = static_cast<unsigned char>(bits >> 16);
+        out[1] = static_cast<unsigned char>(bits >> 8);
+        padded = true;
+        return 2;
+    }
+    bits |= sextet(g, 3, pos);
+    out[0] = static_cast<unsigned char>(bits >> 16);
+    out[1] = static_cast<unsigned char>(bits >> 8);
+    out[2] = static_cast<unsigned char>(bits);
+    return 3;
+}
+
+// A kernel decodes a prefix of in (a multiple of 4 characters, padding
+// excluded) and returns its length. It stops early at a block containing
+// anything outside the alphabet and leaves that to the scalar path, which
+// reports the exact offset.
+using Kernel = size_t (*)(const char* in, size_t len, unsigned char* out);
+
+size_t scalarKernel(const char*, size_t, unsigned char*) {
+    return 0;
+}
+
+#ifdef BASE64_X86
+
+// Vector lookups after W. Muła and D. Lemire, "Faster Base64 Encoding and
+// Decoding using AVX2 Instructions": nibble tables classify every byte,
+// a third table maps it to its 6-bit value, and two multiply-adds pack the
+// sextets into bytes.
+
+__attribute__((target("sse4.1")))
+size_t sse41Kernel(const char* in, size_t len, unsigned char* out) {
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2F = _mm_set1_epi8(0x2F);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    size_t i = 0;
+    // Each step stores 16 bytes of which 12 are decoded; keeping 8
+    // characters in reserve guarantees the overshoot stays inside out
+    while (len - i >= 24) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask2F);
+        __m128i loNibbles = _mm_and_si128(v, mask2F);
+        __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+        __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        if (!_mm_testz_si128(lo, hi)) break;
+
+        __m128i eq2F = _mm_cmpeq_epi8(v, mask2F);
+        __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+        v = _mm_add_epi8(v, roll);
+        v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+        v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+        v = _mm_shuffle_epi8(v, pack);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i / 4 * 3), v);
+        i += 16;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t avx2Kernel(const char* in, size_t len, unsigned char* out) {
+    const __m256i lutLo = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A));
+    const __m256i lutHi = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10));
+    const __m256i lutRoll = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0));
+    const __m256i mask2F = _mm256_set1_epi8(0x2F);
+    const __m256i pack = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+    size_t i = 0;
+    // 32 bytes stored, 24 decoded: 16 characters in reserve cover the rest
+    while (len - i >= 48) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask2F);
+        __m256i loNibbles = _mm256_and_si256(v, mask2F);
+        __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+        __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+        if (!_mm256_testz_si256(lo, hi)) break;
+
+        __m256i eq2F = _mm256_cmpeq_epi8(v, mask2F);
+        __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles));
+        v = _mm256_add_epi8(v, roll);
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, pack);
+        v = _mm256_permutevar8x32_epi32(v, lanes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i / 4 * 3), v);
+        i += 32;
+    }
+    // Finish what is left, or the block that stopped us, 16 at a time
+    return i + sse41Kernel(in + i, len - i, out + i / 4 * 3);
+}
+
+#endif
+
+struct Dispatch {
+    Kernel kernel = scalarKernel;
+    const char* name = "scalar";
+
+    Dispatch() {
+#ifdef BASE64_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            kernel = avx2Kernel;
+            name = "avx2";
+        } else if (__builtin_cpu_supports("sse4.1")) {
+            kernel = sse41Kernel;
+            name = "sse4.1";
+        }
+#endif
+    }
+};
+
+const Dispatch& dispatch() {
+    static const Dispatch d;
+    return d;
+}
+
+// Decodes whole groups; len must be a multiple of 4 and pos is the stream
+// offset of in
+size_t decodeGroups(const char* in, size_t len, unsigned char* out, size_t pos, bool& padded) {
+    size_t i = padded ? 0 : dispatch().kernel(in, len, out);
+    size_t written = i / 4 * 3;
+    for (; i < len; i += 4) written += decodeGroup(in + i, out + written, pos + i, padded);
+    return written;
+}
+
+// Final group of 2 or 3 characters without its padding
+size_t decodeTail(const char* in, size_t len, unsigned char* out, size_t pos, bool& padded) {
+    if (len == 0) return 0;
+    if (len == 1) throw Base64Error("Truncated base64 data", pos);
+    char group[4] = {'=', '=', '=', '='};
+    for (size_t i = 0; i < len; ++i) group[i] = in[i];
+    return decodeGroup(group, out, pos, padded);
+}
+
+} // namespace
+
+size_t base64Decode(const char* in, size_t len, unsigned char* out) {
+    bool padded = false;
+    size_t whole = len / 4 * 4;
+    size_t written = decodeGroups(in, whole, out, 0, padded);
+    return written + decodeTail(in + whole, len - whole, out + written, whole, padded);
+}
+
+const char* base64KernelName() {
+    return dispatch().name;
+}
+
+void Base64Decoder::feed(const char* data, size_t len, std::vector<unsigned char>& out) {
+    size_t base = out.size();
+    out.resize(base + base64MaxDecodedSize(carryLen_ + len));
+    unsigned char* dst = out.data() + base;
+
+    while (carryLen_ > 0 && len > 0) {
+        carry_[carryLen_++] = *data++;
+        --len;
+        if (carryLen_ == 4) {
+            dst += decodeGroup(carry_, dst, consumed_, padded_);
+            consumed_ += 4;
+            carryLen_ = 0;
+        }
+    }
+
+    size_t whole = len / 4 * 4;
+    dst += decodeGroups(data, whole, dst, consumed_, padded_);
+    consumed_ += whole;
+
+    for (size_t i = whole; i < len; ++i) carry_[carryLen_++] = data[i];
+    out.resize(dst - out.data());
+}
+
+void Base64Decoder::finish(std::vector<unsigned char>& out) {
+    size_t base = out.size();
+    out.resize(base + 3);
+    size_t n = decodeTail(carry_, carryLen_, out.data() + base, consumed_, padded_);
+    out.resize(base + n);
+    consumed_ += carryLen_;
+    carryLen_ = 0;
+}
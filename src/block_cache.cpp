@@ -0,0 +1,153 @@
+#include "block_cache.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// CIDs are base32/base58 strings; anything else never touches the filesystem
+static bool isCacheableCID(const std::string& cid) {
+    if (cid.empty() || cid.size() > 128) return false;
+    return std::all_of(cid.begin(), cid.end(), [](unsigned char c) { return std::isalnum(c); });
+}
+
+BlockCache::BlockCache(std::string dir, uint64_t maxBytes)
+    : dir_(std::move(dir)), maxBytes_(maxBytes) {
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    load();
+}
+
+std::string BlockCache::pathFor(const std::string& cid) const {
+    return dir_ + "/" + cid;
+}
+
+void BlockCache::load() {
+    struct Found {
+        fs::file_time_type mtime;
+        std::string cid;
+        uint64_t size;
+    };
+    std::vector<Found> found;
+
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir_, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        std::string name = entry.path().filename().string();
+        if (name.find(".tmp.") != std::string::npos) {
+            // Leftover from a write interrupted by a crash
+            fs::remove(entry.path(), ec);
+            continue;
+        }
+        if (!isCacheableCID(name)) continue;
+        found.push_back({entry.last_write_time(ec), name, entry.file_size(ec)});
+    }
+
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) {
+        return a.mtime > b.mtime;
+    });
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& f : found) {
+        lru_.push_back(f.cid);
+        entries_[f.cid] = {f.size, std::prev(lru_.end())};
+        totalBytes_ += f.size;
+    }
+    evictLocked(0);
+}
+
+std::optional<MappedFile> BlockCache::get(const std::string& cid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(cid);
+    if (it == entries_.end()) return std::nullopt;
+
+    std::string path = pathFor(cid);
+    std::optional<MappedFile> mapped;
+    try {
+        mapped = MappedFile::open(path);
+    } catch (const std::exception&) {
+        mapped.reset();
+    }
+    if (!mapped) {
+        // Removed behind our back; forget it
+        totalBytes_ -= it->second.size;
+        lru_.erase(it->second.lru);
+        entries_.erase(it);
+        return std::nullopt;
+    }
+
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    return mapped;
+}
+
+void BlockCache::admit(const std::string& cid, uint64_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.count(cid)) return;
+    evictLocked(size);
+    lru_.push_front(cid);
+    entries_[cid] = {size, lru_.begin()};
+    totalBytes_ += size;
+}
+
+std::unique_ptr<BlockCache::Writer> BlockCache::writer(const std::string& cid) {
+    if (!isCacheableCID(cid)) return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (entries_.count(cid)) return nullptr;
+    }
+    try {
+        return std::unique_ptr<Writer>(new Writer(*this, cid));
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+BlockCache::Writer::Writer(BlockCache& cache, std::string cid)
+    : cache_(cache), cid_(std::move(cid)), file_(cache.pathFor(cid_)) {}
+
+void BlockCache::Writer::write(const char* data, size_t len) {
+    if (failed_) return;
+    try {
+        if (file_.size() + len > cache_.maxBytes_) {
+            failed_ = true;
+            return;
+        }
+        file_.write(data, len);
+    } catch (const std::exception&) {
+        // A full disk costs us the cache entry, not the fetch
+        failed_ = true;
+    }
+}
+
+void BlockCache::Writer::commit() {
+    if (failed_) return;
+    file_.commit();
+    cache_.admit(cid_, file_.size());
+}
+
+void BlockCache::evictLocked(uint64_t incoming) {
+    while (!lru_.empty() && totalBytes_ + incoming > maxBytes_) {
+        const std::string& victim = lru_.back();
+        auto it = entries_.find(victim);
+        std::error_code ec;
+        fs::remove(pathFor(victim), ec);
+        totalBytes_ -= it->second.size;
+        entries_.erase(it);
+        lru_.pop_back();
+    }
+}
+
+uint64_t BlockCache::sizeBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return totalBytes_;
+}
+
+size_t BlockCache::entryCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
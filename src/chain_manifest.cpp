@@ -0,0 +1,134 @@
+#include "chain_manifest.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+// One line per block:
+//   <cid> <prev_cid or -> <min event_id> <max event_id> <min timestamp> <max timestamp> <records>
+
+ChainManifest::ChainManifest(std::string path) : path_(std::move(path)) {
+    std::error_code ec;
+    auto dir = std::filesystem::path(path_).parent_path();
+    if (!dir.empty()) std::filesystem::create_directories(dir, ec);
+    load();
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) throw std::runtime_error("Cannot open " + path_ + ": " + std::strerror(errno));
+}
+
+ChainManifest::~ChainManifest() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+std::unique_ptr<ChainManifest> ChainManifest::fromConfig() {
+    return std::make_unique<ChainManifest>(Config::ipfs.chain_manifest);
+}
+
+void ChainManifest::load() {
+    std::ifstream in(path_);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    size_t complete = text.rfind('\n');
+    if (complete == std::string::npos) return;
+
+    std::istringstream lines(text.substr(0, complete + 1));
+    for (std::string line; std::getline(lines, line);) {
+        std::istringstream fields(line);
+        std::string cid;
+        Entry entry;
+        if (!(fields >> cid >> entry.prevCID >> entry.minEventId >> entry.maxEventId >> entry.minTimestamp >>
+              entry.maxTimestamp >> entry.records) ||
+            !(fields >> std::ws).eof()) {
+            continue;
+        }
+        if (entry.prevCID == "-") entry.prevCID.clear();
+        entries_.emplace(std::move(cid), std::move(entry));
+    }
+
+    // Drop a torn last line, so the next append starts on a line of its own
+    if (complete + 1 != text.size()) std::filesystem::resize_file(path_, complete + 1);
+}
+
+ChainManifest::Entry ChainManifest::describe(const std::string& prevCID, const std::vector<LogRecord>& logs) {
+    Entry entry{prevCID,
+                std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min(),
+                std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min(),
+                static_cast<uint32_t>(logs.size())};
+    for (const auto& log : logs) {
+        if (log.has(LogRecord::EventId)) {
+            entry.minEventId = std::min(entry.minEventId, log.eventId);
+            entry.maxEventId = std::max(entry.maxEventId, log.eventId);
+        }
+        if (log.has(LogRecord::Timestamp) || log.has(LogRecord::TimestampText)) {
+            entry.minTimestamp = std::min(entry.minTimestamp, log.timestamp);
+            entry.maxTimestamp = std::max(entry.maxTimestamp, log.timestamp);
+        }
+    }
+    return entry;
+}
+
+bool ChainManifest::contains(const std::string& cid) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.count(cid) != 0;
+}
+
+std::optional<ChainManifest::Entry> ChainManifest::find(const std::string& cid) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(cid);
+    if (it == entries_.end()) return std::nullopt;
+    return it->second;
+}
+
+void ChainManifest::add(const std::vector<std::pair<std::string, Entry>>& blocks) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string lines;
+    std::vector<const std::pair<std::string, Entry>*> added;
+    for (const auto& block : blocks) {
+        const auto& [cid, e] = block;
+        // CIDs never contain whitespace; anything else could not be read back
+        if (cid.empty() || cid.find_first_of(" \t\n") != std::string::npos || entries_.count(cid)) continue;
+        if (std::find_if(added.begin(), added.end(), [&](auto* a) { return a->first == cid; }) != added.end()) continue;
+        lines += cid + " " + (e.prevCID.empty() ? "-" : e.prevCID) + " " + std::to_string(e.minEventId) + " " +
+                 std::to_string(e.maxEventId) + " " + std::to_string(e.minTimestamp) + " " +
+                 std::to_string(e.maxTimestamp) + " " + std::to_string(e.records) + "\n";
+        added.push_back(&block);
+    }
+    if (lines.empty()) return;
+
+    const char* data = lines.data();
+    size_t left = lines.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd_, data, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Cannot write " + path_ + ": " + std::strerror(errno));
+        data += n;
+        left -= n;
+    }
+    if (::fdatasync(fd_) != 0) throw std::runtime_error("Cannot sync " + path_ + ": " + std::strerror(errno));
+    for (const auto* block : added) entries_.emplace(block->first, block->second);
+}
+
+ChainManifest::Tail ChainManifest::follow(const std::string& cid) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Tail tail{cid, 0, 0};
+    // Bounded by the number of entries, in case a corrupt manifest links a cycle
+    while (!tail.missing.empty() && tail.blocks <= entries_.size()) {
+        auto it = entries_.find(tail.missing);
+        if (it == entries_.end()) break;
+        ++tail.blocks;
+        tail.records += it->second.records;
+        tail.missing = it->second.prevCID;
+    }
+    return tail;
+}
+
+size_t ChainManifest::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
@@ -0,0 +1,161 @@
+#include "chain_walker.hpp"
+#include "decryptor.hpp"
+#include "fetcher.hpp"
+#include "rule_set.hpp"
+#include "thread_pool.hpp"
+#include "utils.hpp"
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+constexpr size_t kNone = std::numeric_limits<size_t>::max();
+
+// Shared by the walk's tasks and the thread delivering its blocks
+struct WalkState {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::map<size_t, ChainBlock> ready;     // parsed, waiting for their turn
+    size_t inFlight = 0;                    // fetched and not delivered yet
+    size_t running = 0;                     // tasks queued or running
+    size_t end = kNone;                     // index of the first block not fetched
+    size_t errorAt = kNone;                 // first block that failed
+    std::exception_ptr error;
+    bool stop = false;
+    // The next fetch, held back while queueSize blocks are in flight
+    bool paused = false;
+    size_t pausedIndex = 0;
+    std::string pausedCID;
+
+    void fail(size_t index, std::exception_ptr e) {
+        if (index < errorAt) {
+            errorAt = index;
+            error = e;
+        }
+    }
+};
+
+} // namespace
+
+ChainWalker::ChainWalker(Keyring& keyring, size_t queueSize)
+    : keyring_(keyring), queueSize_(queueSize ? queueSize : 1) {}
+
+size_t ChainWalker::walk(const std::string& startCID, size_t maxBlocks, const Sink& sink, const StopAt& stopAt) {
+    ThreadPool& pool = ThreadPool::instance();
+    WalkState st;
+    std::function<void(size_t, std::string)> fetch;
+
+    // Called with st.mutex held
+    auto scheduleFetch = [&](size_t index, std::string cid) {
+        ++st.running;
+        pool.post([&fetch, index, cid = std::move(cid)] { fetch(index, cid); }, ThreadPool::Priority::High);
+    };
+
+    // Inner-log parsing, sorting and pattern tagging of block N runs while
+    // block N+1 is being fetched, and alongside that of other blocks
+    auto scheduleParse = [&](size_t index, std::string cid, std::shared_ptr<BlockPayload> payload) {
+        ++st.running;
+        pool.post([&st, index, cid = std::move(cid), payload] {
+            ChainBlock out;
+            out.index = index;
+            out.cid = cid;
+            out.prevCID = std::move(payload->prevCID);
+            std::exception_ptr error;
+            try {
+                out.logs = parseAndSortLogs(payload->logs, out.arena);
+                tagLogPatterns(out.logs, out.arena);
+            } catch (const std::exception& e) {
+                error = std::make_exception_ptr(ChainWalkError(out.cid, "Block " + out.cid + ": " + e.what()));
+            }
+            std::lock_guard<std::mutex> lock(st.mutex);
+            if (error) {
+                st.fail(index, error);
+                st.stop = true;
+            } else {
+                st.ready.emplace(index, std::move(out));
+            }
+            --st.running;
+            st.changed.notify_all();
+        });
+    };
+
+    // The chain dependency keeps fetch and decrypt serial: each block's
+    // task schedules the next one once the block's prev_cid is known
+    fetch = [&](size_t index, const std::string& cid) {
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(st.mutex);
+            last = st.stop || cid.empty() || (maxBlocks && index == maxBlocks);
+        }
+        if (!last && stopAt && stopAt(cid)) last = true;
+
+        std::shared_ptr<BlockPayload> payload;
+        std::exception_ptr error;
+        if (!last) {
+            try {
+                payload = std::make_shared<BlockPayload>(fetchAndDecrypt(cid, keyring_));
+            } catch (const std::exception& e) {
+                error = std::make_exception_ptr(ChainWalkError(cid, "Block " + cid + ": " + e.what()));
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(st.mutex);
+        if (last || error) {
+            st.end = index;
+            if (error) st.fail(index, error);
+        } else {
+            std::string prev = payload->prevCID;
+            ++st.inFlight;
+            scheduleParse(index, cid, std::move(payload));
+            if (st.inFlight >= queueSize_) {
+                st.paused = true;
+                st.pausedIndex = index + 1;
+                st.pausedCID = std::move(prev);
+            } else {
+                scheduleFetch(index + 1, std::move(prev));
+            }
+        }
+        --st.running;
+        st.changed.notify_all();
+    };
+
+    // Output in chain order on the caller's thread
+    size_t delivered = 0;
+    std::exception_ptr sinkError;
+    std::unique_lock<std::mutex> lock(st.mutex);
+    scheduleFetch(0, startCID);
+    while (true) {
+        st.changed.wait(lock, [&] {
+            return st.ready.count(delivered) || delivered >= st.end || delivered >= st.errorAt;
+        });
+        auto next = st.ready.find(delivered);
+        if (next == st.ready.end()) break;
+        ChainBlock block = std::move(next->second);
+        st.ready.erase(next);
+        --st.inFlight;
+        if (st.paused) {
+            st.paused = false;
+            scheduleFetch(st.pausedIndex, std::move(st.pausedCID));
+        }
+        lock.unlock();
+        try {
+            sink(block);
+        } catch (...) {
+            sinkError = std::current_exception();
+        }
+        lock.lock();
+        if (sinkError) break;
+        ++delivered;
+    }
+
+    // Tasks still queued or running refer to this frame
+    st.stop = true;
+    st.changed.wait(lock, [&] { return st.running == 0; });
+    if (sinkError) std::rethrow_exception(sinkError);
+    if (st.error && st.errorAt == delivered) std::rethrow_exception(st.error);
+    return delivered;
+}
@@ -1,21 +1,44 @@
 #include "cli.hpp"
+#include "chain_manifest.hpp"
+#include "chain_walker.hpp"
+#include "correlator.hpp"
+#include "daemon.hpp"
 #include "fetcher.hpp"
+#include "gateway_pool.hpp"
+#include "ipns_resolver.hpp"
+#include "jsonl_sink.hpp"
+#include "log_record.hpp"
+#include "log_sort.hpp"
+#include "rule_set.hpp"
+#include "segment_store.hpp"
+#include "thread_pool.hpp"
 #include "decryptor.hpp"
+#include "event_writer.hpp"
 #include "utils.hpp"
+#include "config.hpp"
+#include <algorithm>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <filesystem>
 #include <cstdlib>
 #include <thread>
 #include <chrono>
+#include <charconv>
+#include <optional>
+#include <csignal>
+#include <poll.h>
+#include <unistd.h>
 #include "termcolor/termcolor.hpp"
 #include "json.hpp"
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 
-// Resolves IPNS peer name read from keys/ipns_key.txt to a CID
-std::string resolveIPNSKey() {
+// Resolves IPNS peer name read from keys/ipns_key.txt to a CID; fresh skips
+// the resolver's cache
+std::string resolveIPNSKey(bool fresh = false) {
     const std::string keyFilePath = "./keys/ipns_key.txt";
 
     std::ifstream keyFile(keyFilePath);
@@ -31,29 +54,31 @@ std::string resolveIPNSKey() {
         throw std::runtime_error("IPNS key file is empty");
     }
 
-    std::string command = "ipfs name resolve --nocache /ipns/" + peerName + " --timeout=5s";
-    std::string cid;
-    FILE *pipe = popen(command.c_str(), "r");
-    if (!pipe) {
-        throw std::runtime_error("Failed to run IPNS resolve command");
-    }
+    return fresh ? IPNSResolver::instance().resolveFresh(peerName) : IPNSResolver::instance().resolve(peerName);
+}
 
-    char buffer[256];
-    while (fgets(buffer, sizeof(buffer), pipe)) {
-        cid += buffer;
+// Prints one decrypted log entry as a framed box
+static void printLog(const LogRecord& log)
+{
+    std::cout << termcolor::yellow << "┌─────────────────────────────────────\n";
+    std::cout << "│ Event ID : " << logFieldJson(log, "event_id") << "\n"
+              << "│ Type     : " << logFieldJson(log, "type") << "\n"
+              << "│ Message  : " << logFieldJson(log, "message") << "\n";
+    if (log.has(LogRecord::Timestamp) || log.extra("timestamp"))
+    {
+        std::cout << "│ Time     : " << logFieldJson(log, "timestamp") << "\n";
     }
-    pclose(pipe);
-
-    const std::string prefix = "/ipfs/";
-    auto pos = cid.find(prefix);
-    if (pos != std::string::npos) {
-        cid = cid.substr(pos + prefix.size());
-        cid.erase(cid.find_last_not_of(" \n\r\t") + 1);
-    } else {
-        throw std::runtime_error("Could not parse IPNS resolve output");
+    if (log.patternCount)
+    {
+        const RuleSet &rules = RuleSet::instance();
+        std::cout << termcolor::red << "│ Threats  : ";
+        for (uint16_t id : log.patternIds())
+        {
+            std::cout << (id == log.patterns[0] ? "" : ", ") << rules.rule(id).text;
+        }
+        std::cout << termcolor::yellow << "\n";
     }
-
-    return cid;
+    std::cout << "└─────────────────────────────────────" << termcolor::reset << "\n";
 }
 
 // Экранирование пробелов в пути
@@ -69,8 +94,30 @@ std::string escapePath(const std::string& path) {
     return escaped;
 }
 
+static void printBanner()
+{
+    std::cout << termcolor::bold << termcolor::cyan;
+    std::cout << "\n";
+    std::cout << "               ███╗   ██╗███████╗██╗  ██╗██╗   ██╗███████╗\n";
+    std::cout << "               ████╗  ██║██╔════╝╚██╗██╔╝██║   ██║██╔════╝\n";
+    std::cout << "               ██╔██╗ ██║█████╗   ╚███╔╝ ██║   ██║███████╗\n";
+    std::cout << "               ██║╚██╗██║██╔══╝   ██╔██╗ ██║   ██║╚════██║\n";
+    std::cout << "               ██║ ╚████║███████╗██╔╝ ██╗╚██████╔╝███████║\n";
+    std::cout << "               ╚═╝  ╚═══╝╚══════╝╚═╝  ╚═╝ ╚═════╝ ╚══════╝\n";
+    std::cout << "\n";
+    std::cout << termcolor::reset;
+    std::cout << termcolor::yellow << "═════════════════════════════════════════════════════════════════════════\n";
+    std::cout << "         🚀 Secure Log Management System | IPFS-Powered Analytics\n";
+    std::cout << "═════════════════════════════════════════════════════════════════════════\n" << termcolor::reset;
+    std::cout << termcolor::green << "\nWelcome to Nexus CLI - Type 'help' for available commands\n" << termcolor::reset;
+    std::cout << "\n";
+}
+
+static bool webServerStarted = false;
+
 // Запуск веб-сервера
 void startWebServer() {
+    webServerStarted = true;
     fs::path currentPath = fs::current_path();
     fs::path webDir = currentPath / "web";
     fs::path backendDir = webDir / "backend";
@@ -97,56 +144,270 @@ void stopWebServer() {
     system("pkill -f 'vite.*preview'");
 }
 
-void CLI::run()
+CLI::CLI() : keyring(Config::encryption.session_key_cache_size), plainStderr(std::cerr.rdbuf()) {}
+
+CLI::~CLI() = default;
+
+// Headless runs keep stdout for results and write everything else to
+// stderr through a stream of their own, which termcolor leaves uncoloured
+// even on a terminal. With the ndjson protocol messages are collected and
+// sent as info, warning and error events.
+std::ostream &CLI::report()
 {
-    std::cout << termcolor::bold << termcolor::cyan;
-    std::cout << "\n";
-    std::cout << "               ███╗   ██╗███████╗██╗  ██╗██╗   ██╗███████╗\n";
-    std::cout << "               ████╗  ██║██╔════╝╚██╗██╔╝██║   ██║██╔════╝\n";
-    std::cout << "               ██╔██╗ ██║█████╗   ╚███╔╝ ██║   ██║███████╗\n";
-    std::cout << "               ██║╚██╗██║██╔══╝   ██╔██╗ ██║   ██║╚════██║\n";
-    std::cout << "               ██║ ╚████║███████╗██╔╝ ██╗╚██████╔╝███████║\n";
-    std::cout << "               ╚═╝  ╚═══╝╚══════╝╚═╝  ╚═╝ ╚═════╝ ╚══════╝\n";
-    std::cout << "\n";
-    std::cout << termcolor::reset;
-    std::cout << termcolor::yellow << "═════════════════════════════════════════════════════════════════════════\n";
-    std::cout << "         🚀 Secure Log Management System | IPFS-Powered Analytics\n";
-    std::cout << "═════════════════════════════════════════════════════════════════════════\n" << termcolor::reset;
-    std::cout << termcolor::green << "\nWelcome to Nexus CLI - Type 'help' for available commands\n" << termcolor::reset;
-    std::cout << "\n";
+    return events ? eventNotes : headless ? plainStderr : std::cout;
+}
+
+std::ostream &CLI::warn()
+{
+    return events ? eventWarnings : headless ? plainStderr : std::cerr;
+}
+
+// Like warn(), and makes batch() exit with kExitFailed
+std::ostream &CLI::fail()
+{
+    failed = true;
+    return events ? eventErrors : warn();
+}
+
+// Queues the messages collected so far, one event per line
+void CLI::sendMessages()
+{
+    std::pair<std::ostringstream *, const char *> kinds[] = {
+        {&eventNotes, "info"}, {&eventWarnings, "warning"}, {&eventErrors, "error"}};
+    for (auto [messages, name] : kinds)
+    {
+        std::string text = messages->str();
+        for (size_t start = 0, end; start < text.size(); start = end + 1)
+        {
+            end = std::min(text.find('\n', start), text.size());
+            if (end > start)
+            {
+                events->text(name, std::string_view(text).substr(start, end - start));
+            }
+        }
+        messages->str("");
+    }
+}
+
+// Sends the messages and everything buffered in the event writer; false
+// once nobody reads the events
+bool CLI::flushEvents()
+{
+    sendMessages();
+    try
+    {
+        events->flush();
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    return true;
+}
+
+// Ends a command's events: what it printed, its messages, prev_cid unless
+// it is still prevCID, then "done" with whether the command failed
+bool CLI::endCommand(const std::string &command, const std::string &printed, const std::optional<std::string> &prevCID,
+                     std::chrono::steady_clock::time_point started)
+{
+    if (!printed.empty())
+    {
+        events->text("text", printed);
+    }
+    sendMessages();
+    if (lastPrevCID != prevCID)
+    {
+        std::string fields = "\"cid\":";
+        appendJsonString(fields, lastPrevCID);
+        events->event("prev_cid", fields);
+    }
+    std::string fields = "\"command\":";
+    appendJsonString(fields, command);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    fields += ",\"ok\":" + std::string(failed ? "false" : "true") + ",\"ms\":" + std::to_string(elapsed.count());
+    events->event("done", fields);
+    return flushEvents();
+}
+
+// The output file and its writer thread are only set up on first use
+JsonlSink &CLI::output()
+{
+    if (!sink)
+    {
+        sink = JsonlSink::fromConfig();
+    }
+    return *sink;
+}
+
+// Null when the store is disabled or its directory cannot be used; the
+// reason is reported once and fetches carry on without it
+SegmentStore *CLI::store()
+{
+    if (!segments && !storeFailed && Config::store.enabled)
+    {
+        try
+        {
+            segments = SegmentStore::fromConfig();
+        }
+        catch (const std::exception &e)
+        {
+            storeFailed = true;
+            warn() << termcolor::yellow << "[!] Segment store unavailable: " << e.what() << "\n" << termcolor::reset;
+        }
+    }
+    return segments.get();
+}
+
+// Null if the manifest file cannot be opened; the failure is reported once
+ChainManifest *CLI::manifest()
+{
+    if (!knownBlocks && !manifestFailed)
+    {
+        try
+        {
+            knownBlocks = ChainManifest::fromConfig();
+        }
+        catch (const std::exception &e)
+        {
+            manifestFailed = true;
+            warn() << termcolor::yellow << "[!] Chain manifest unavailable: " << e.what() << "\n" << termcolor::reset;
+        }
+    }
+    return knownBlocks.get();
+}
 
-    // Автоматически запускаем веб-интерфейс при старте
-    startWebServer();
+// Feeds one record, in output order, to the correlator and prints the
+// alerts it fires; the windows carry over from one fetch to the next when
+// it continues further back (see Correlator::beginWalk)
+void CLI::correlate(const LogRecord &log)
+{
+    if (!Config::security.enable_threat_detection)
+    {
+        return;
+    }
+    if (!correlator)
+    {
+        correlator = Correlator::fromConfig();
+    }
+    std::vector<Correlator::Alert> alerts;
+    correlator->observe(log, alerts);
+    for (const auto &alert : alerts)
+    {
+        std::string what = alert.kind == Correlator::Alert::Attempts ? RuleSet::instance().rule(alert.id).text
+                                                                     : std::string(logTypeName(alert.id));
+        if (events)
+        {
+            std::string fields = alert.kind == Correlator::Alert::Attempts ? "\"kind\":\"attempts\",\"what\":"
+                                                                            : "\"kind\":\"rate\",\"what\":";
+            appendJsonString(fields, what);
+            fields += ",\"source\":";
+            appendJsonString(fields, alert.source);
+            fields += ",\"count\":" + std::to_string(alert.count) + ",\"window\":" + std::to_string(alert.window) +
+                      ",\"timestamp\":" + std::to_string(alert.timestamp);
+            events->event("alert", fields);
+            continue;
+        }
+        report() << termcolor::bold << termcolor::red << "[ALERT] " << alert.count << " '" << what << "' events from "
+                  << (alert.source.empty() ? "an unknown source" : std::string(alert.source)) << " within "
+                  << alert.window << " s" << (alert.kind == Correlator::Alert::Rate ? ", over the rate limit" : "")
+                  << termcolor::reset << "\n";
+    }
+}
 
+// With Protocol::Ndjson there is no banner or prompt. Each command line is
+// answered by its events, closed by a "done" event; whatever a command
+// prints is sent as one "text" event. End of input is the same as exit.
+void CLI::run(Protocol protocol)
+{
+    if (protocol == Protocol::Ndjson)
+    {
+        headless = true;
+        events = std::make_unique<EventWriter>(STDOUT_FILENO);
+        std::signal(SIGPIPE, SIG_IGN);
+        loadKeys();
+        loadRules();
+        events->event("ready");
+        flushEvents();
+    }
+    else
+    {
+        printBanner();
+        loadKeys();
+        loadRules();
+    }
 
     std::string command;
+    bool quit = false;
 
-    while (true)
+    while (!quit)
     {
-        std::cout << termcolor::green << "logcli> " << termcolor::reset;
-        std::getline(std::cin, command);
+        if (!events)
+        {
+            std::cout << termcolor::green << "logcli> " << termcolor::reset;
+        }
+        if (!std::getline(std::cin, command))
+        {
+            command = "exit";
+        }
+
+        std::ostringstream printed;
+        std::streambuf *stdoutBuffer = events ? std::cout.rdbuf(printed.rdbuf()) : nullptr;
+        std::string prevCID = lastPrevCID;
+        auto started = std::chrono::steady_clock::now();
+        failed = false;
 
         if (command == "fetch --resolve")
         {
             try {
                 std::string resolvedCID = resolveIPNSKey();
-                std::cout << termcolor::green << "[✓] Resolved CID: " << resolvedCID << "\n" << termcolor::reset;
+                report() << termcolor::green << "[✓] Resolved CID: " << resolvedCID << "\n" << termcolor::reset;
                 lastPrevCID = resolvedCID;  // update lastPrevCID but do NOT fetch logs
             } catch (const std::exception& e) {
-                std::cerr << termcolor::red << "Resolve error: " << e.what() << "\n" << termcolor::reset;
+                fail() << termcolor::red << "Resolve error: " << e.what() << "\n" << termcolor::reset;
             }
         }
         else if (command == "fetch --chain")
         {
             if (lastPrevCID.empty())
             {
-                std::cout << termcolor::red << "No previous logs.\n" << termcolor::reset;
+                fail() << termcolor::red << "No previous logs.\n" << termcolor::reset;
             }
             else
             {
                 loadCID(lastPrevCID);
             }
         }
+        else if (command.rfind("fetch --chain ", 0) == 0)
+        {
+            std::istringstream args(command.substr(14));
+            std::string flag;
+            size_t depth = 0;
+            args >> flag;
+            if (lastPrevCID.empty())
+            {
+                fail() << termcolor::red << "No previous logs.\n" << termcolor::reset;
+            }
+            else if (flag == "--all")
+            {
+                walkChain(0);
+            }
+            else if (flag == "--depth" && (args >> depth) && depth > 0)
+            {
+                walkChain(depth);
+            }
+            else
+            {
+                std::cout << termcolor::yellow << "Usage: fetch --chain [--all | --depth N]\n" << termcolor::reset;
+            }
+        }
+        else if (command == "sync")
+        {
+            syncChain();
+        }
+        else if (command == "watch" || command.rfind("watch ", 0) == 0)
+        {
+            watchChain(command.size() > 6 ? command.substr(6) : "");
+        }
         else if (command.size() >= 6 && command.substr(0,6) == "fetch ")
         {
             std::string cid = command.substr(6);
@@ -156,6 +417,30 @@ void CLI::run()
                 loadCID(cid);
             }
         }
+        else if (command == "gateways")
+        {
+            showGateways();
+        }
+        else if (command == "workers")
+        {
+            showWorkers();
+        }
+        else if (command == "store" || command.rfind("store ", 0) == 0)
+        {
+            storeCommand(command.size() > 6 ? command.substr(6) : "");
+        }
+        else if (command == "scan" || command.rfind("scan ", 0) == 0)
+        {
+            scanCommand(command.size() > 5 ? command.substr(5) : "");
+        }
+        else if (command == "search" || command.rfind("search ", 0) == 0)
+        {
+            searchCommand(command.size() > 7 ? command.substr(7) : "");
+        }
+        else if (command == "alerts")
+        {
+            showAlerts();
+        }
         else if (command == "web start" || command == "web")
         {
             startWebServer();
@@ -167,8 +452,11 @@ void CLI::run()
         }
         else if (command == "exit")
         {
-            stopWebServer();
-            break;
+            if (webServerStarted)
+            {
+                stopWebServer();
+            }
+            quit = true;
         }
         else
         {
@@ -178,84 +466,972 @@ void CLI::run()
             std::cout << "║  fetch --resolve       Resolve IPNS and show latest CID         ║\n";
             std::cout << "║  fetch <CID>           Fetch and decrypt a specific CID         ║\n";
             std::cout << "║  fetch --chain         Fetch previous logs from last prev_cid   ║\n";
+            std::cout << "║  fetch --chain --all   Walk the whole chain from last prev_cid  ║\n";
+            std::cout << "║  fetch --chain --depth N  Walk N blocks from last prev_cid      ║\n";
+            std::cout << "║  sync                  Fetch blocks newer than the last sync    ║\n";
+            std::cout << "║  watch [seconds]       Follow the head until Enter or Ctrl-C    ║\n";
+            std::cout << "║  gateways              Show gateway latency and error scores    ║\n";
+            std::cout << "║  workers               Show thread pool and arena pool counters ║\n";
+            std::cout << "║  store                 Show segment store size                  ║\n";
+            std::cout << "║  store id <event_id>   Look up stored logs by event_id          ║\n";
+            std::cout << "║  store range <from> <to> [N]  Stored logs in a time range       ║\n";
+            std::cout << "║  search <term> [AND|OR <term> ...]  Full-text search the store  ║\n";
+            std::cout << "║  scan [N]              Top N threat pattern hits in the store   ║\n";
+            std::cout << "║  alerts                Event correlation counters and memory    ║\n";
             std::cout << "║  web                   Start web interface                      ║\n";
             std::cout << "║  web stop              Stop web interface                       ║\n";
             std::cout << "║  help / ?              Show this help message                   ║\n";
             std::cout << "║  exit / quit           Exit the application                     ║\n";
             std::cout << "╚═════════════════════════════════════════════════════════════════╝\n" << termcolor::reset;
         }
+
+        if (events)
+        {
+            std::cout.rdbuf(stdoutBuffer);
+            quit |= !endCommand(command, printed.str(), prevCID, started);
+        }
     }
 }
 
-void CLI::loadCID(const std::string &cid)
+static const char *kBatchUsage =
+    "Usage: cli-netsectool <command> [--out FILE] [--format jsonl] [--protocol ndjson]\n"
+    "       cli-netsectool --protocol ndjson [--out FILE]\n"
+    "  fetch --resolve                      Print the CID the IPNS key points to\n"
+    "  fetch <CID>                          Fetch one block\n"
+    "  fetch --chain [--depth N | --all] [--from CID]\n"
+    "                                       Walk the chain from CID or the current head\n"
+    "  sync                                 Fetch blocks newer than the last sync\n"
+    "  daemon [--socket PATH]               Serve clients on a Unix socket until stopped\n"
+    "Logs are appended to FILE, logging.output_file by default. Exit status is\n"
+    "0 on success, 1 if anything failed and 2 on a usage error.\n"
+    "With --protocol ndjson the command's records and messages are written to\n"
+    "stdout as JSON events, one per line; without a command, commands of the\n"
+    "interactive shell are read from stdin and answered the same way.\n";
+
+// Runs one command given on the command line, without the banner, the web
+// interface or colours, for cron jobs and pipelines. Progress goes to
+// stderr; stdout only carries what the command prints as its result.
+int CLI::batch(const std::vector<std::string> &args)
 {
-    try
+    headless = true;
+    std::vector<std::string> words;
+    std::string out, format = "jsonl", from, socket, protocol = "text";
+    size_t depth = 1;
+    bool chain = false, resolve = false, all = false;
+    for (size_t i = 0; i < args.size(); ++i)
     {
-        std::string raw = fetchFromIPFS(cid);
-
-        json j;
-        try
+        const std::string &arg = args[i];
+        bool hasValue = i + 1 < args.size();
+        if (arg == "--help" || arg == "-h" || arg == "help")
         {
-            j = decryptAndParse(raw, "./keys/private_key.pem");
+            std::cout << kBatchUsage;
+            return kExitOk;
         }
-        catch (const json::parse_error &e)
+        else if (arg == "--out" && hasValue)
         {
-            std::cerr << termcolor::red
-                      << "[✘] Error: Response was not valid JSON — possibly invalid CID or IPFS error.\n"
-                      << "[Raw Response]\n" << raw << "\n"
-                      << termcolor::reset;
-            return;
+            out = args[++i];
         }
-        catch (const std::exception &e)
+        else if (arg == "--format" && hasValue)
         {
-            std::cerr << termcolor::red
-                      << "[✘] Error during decryption: " << e.what() << "\n"
-                      << termcolor::reset;
-            return;
+            format = args[++i];
         }
-
-        std::vector<json> logs = parseAndSortLogs(j["logs"]);
-        lastPrevCID = j.value("prev_cid", "");
-
-        std::ofstream fout("./logs_output.jsonl", std::ios::app);
-        if (!fout.is_open())
+        else if (arg == "--from" && hasValue)
         {
-            throw std::runtime_error("Cannot open output file");
+            from = args[++i];
         }
-
-        std::cout << termcolor::green << "=== Decrypted Logs ===\n" << termcolor::reset;
-
-        for (const auto &log : logs)
+        else if (arg == "--protocol" && hasValue)
+        {
+            protocol = args[++i];
+        }
+        else if (arg == "--socket" && hasValue)
+        {
+            socket = args[++i];
+        }
+        else if (arg == "--depth" && hasValue)
         {
-            std::cout << termcolor::yellow << "┌─────────────────────────────────────\n";
-            std::cout << "│ Event ID : " << log["event_id"] << "\n"
-                      << "│ Type     : " << log["type"] << "\n"
-                      << "│ Message  : " << log["message"] << "\n";
-            if (log.contains("timestamp"))
+            const std::string &n = args[++i];
+            auto [end, ec] = std::from_chars(n.data(), n.data() + n.size(), depth);
+            if (ec != std::errc() || end != n.data() + n.size() || depth == 0)
             {
-                std::cout << "│ Time     : " << log["timestamp"] << "\n";
+                std::cerr << "Invalid --depth: " << n << "\n";
+                return kExitUsage;
             }
-            std::cout << "└─────────────────────────────────────" << termcolor::reset << "\n";
-
-            fout << log.dump(4) << "\n\n";
+            chain = true;
+        }
+        else if (arg == "--chain" || arg == "--resolve" || arg == "--all")
+        {
+            chain |= arg != "--resolve";
+            resolve |= arg == "--resolve";
+            all |= arg == "--all";
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            std::cerr << "Unknown option " << arg << "\n" << kBatchUsage;
+            return kExitUsage;
+        }
+        else
+        {
+            words.push_back(arg);
         }
+    }
+
+    if (protocol != "text" && protocol != "ndjson")
+    {
+        std::cerr << "Unknown --protocol " << protocol << "; use text or ndjson\n";
+        return kExitUsage;
+    }
+    if (!out.empty())
+    {
+        Config::logging.output_file = out;
+    }
+    if (protocol == "ndjson" && words.empty() && !chain && !resolve && from.empty() && socket.empty())
+    {
+        run(Protocol::Ndjson);
+        return kExitOk;
+    }
 
-        fout.close();
+    bool fetch = !words.empty() && words[0] == "fetch";
+    bool sync = words.size() == 1 && words[0] == "sync";
+    bool daemon = words.size() == 1 && words[0] == "daemon";
+    bool valid = sync || daemon || (fetch && (resolve ? !chain && words.size() == 1
+                                            : chain ? words.size() == 1 : words.size() == 2 && from.empty()));
+    if (!valid || (daemon && protocol == "ndjson"))
+    {
+        std::cerr << kBatchUsage;
+        return kExitUsage;
+    }
+    if (format != "jsonl")
+    {
+        std::cerr << "Unsupported --format " << format << "; only jsonl is written\n";
+        return kExitUsage;
+    }
 
-        std::cout << termcolor::cyan << "⬅️  prev_cid: " << lastPrevCID << "\n" << termcolor::reset;
+    auto started = std::chrono::steady_clock::now();
+    std::string command;
+    for (const auto &arg : args)
+    {
+        command += (command.empty() ? "" : " ") + arg;
+    }
+    if (protocol == "ndjson")
+    {
+        events = std::make_unique<EventWriter>(STDOUT_FILENO);
+        std::signal(SIGPIPE, SIG_IGN);
+    }
 
-        if (lastPrevCID.empty())
+    if (resolve && !events)
+    {
+        try
         {
-            std::cout << termcolor::cyan << "✔️  No more logs.\n" << termcolor::reset;
+            std::cout << resolveIPNSKey(true) << "\n";
+            return kExitOk;
         }
-        else
+        catch (const std::exception &e)
+        {
+            std::cerr << "Resolve error: " << e.what() << "\n";
+            return kExitFailed;
+        }
+    }
+    if (resolve)
+    {
+        try
+        {
+            lastPrevCID = resolveIPNSKey(true);
+        }
+        catch (const std::exception &e)
+        {
+            fail() << "Resolve error: " << e.what() << "\n";
+        }
+        endCommand(command, "", std::nullopt, started);
+        return failed ? kExitFailed : kExitOk;
+    }
+
+    loadKeys();
+    loadRules();
+    if (daemon)
+    {
+        return serveDaemon(socket);
+    }
+    if (sync)
+    {
+        syncChain();
+    }
+    else if (!chain)
+    {
+        loadCID(words[1]);
+    }
+    else
+    {
+        try
+        {
+            lastPrevCID = from.empty() ? resolveIPNSKey(true) : from;
+        }
+        catch (const std::exception &e)
+        {
+            fail() << "Resolve error: " << e.what() << "\n";
+        }
+        if (!failed)
+        {
+            walkChain(all ? 0 : depth);
+        }
+    }
+    // Waits for the output file to be on disk, so a zero exit status means
+    // the logs are there
+    try
+    {
+        if (sink)
         {
-            std::cout << termcolor::cyan << "➡️  Type 'fetch --chain' to load more logs...\n" << termcolor::reset;
+            sink->sync();
         }
     }
     catch (const std::exception &e)
     {
-        std::cerr << termcolor::red << "[✘] Error: " << e.what() << termcolor::reset << "\n";
+        fail() << "[✘] Error: " << e.what() << "\n";
     }
+    if (events && !endCommand(command, "", std::nullopt, started))
+    {
+        return kExitFailed;
+    }
+    return failed ? kExitFailed : kExitOk;
 }
 
+static Daemon *runningDaemon = nullptr;
+
+// Serves until SIGINT or SIGTERM, sharing this process's keyring, output,
+// store and manifest with every client
+int CLI::serveDaemon(const std::string &socketPath)
+{
+    Daemon::Options options = Daemon::optionsFromConfig();
+    if (!socketPath.empty())
+    {
+        options.socketPath = socketPath;
+    }
+    std::unique_ptr<Daemon> daemon;
+    try
+    {
+        daemon = std::make_unique<Daemon>(options, keyring, output(), store(), manifest(),
+                                          [] { return resolveIPNSKey(); });
+    }
+    catch (const std::exception &e)
+    {
+        fail() << "[✘] Error: " << e.what() << "\n";
+        return kExitFailed;
+    }
+
+    runningDaemon = daemon.get();
+    auto stopDaemon = [](int) { runningDaemon->stop(); };
+    auto previousInt = std::signal(SIGINT, stopDaemon);
+    auto previousTerm = std::signal(SIGTERM, stopDaemon);
+    report() << "Serving on " << options.socketPath << "\n";
+    try
+    {
+        daemon->run();
+    }
+    catch (const std::exception &e)
+    {
+        fail() << "[✘] Error: " << e.what() << "\n";
+    }
+    std::signal(SIGINT, previousInt);
+    std::signal(SIGTERM, previousTerm);
+    runningDaemon = nullptr;
+
+    auto st = daemon->stats();
+    report() << "Stopped; " << st.decoded << " blocks decoded, " << st.hits << " served from memory, " << st.shared
+             << " shared with a request already fetching them\n";
+    return failed ? kExitFailed : kExitOk;
+}
+
+void CLI::showGateways()
+{
+    std::cout << termcolor::cyan;
+    for (const auto &g : GatewayPool::instance().stats())
+    {
+        std::cout << std::left << std::setw(32) << g.url << std::right << std::fixed << std::setprecision(1)
+                  << "  ewma " << std::setw(8) << g.ewmaMs << " ms"
+                  << "  p95 " << std::setw(8) << g.p95Ms << " ms"
+                  << "  errors " << std::setw(5) << g.errorRate * 100 << "%"
+                  << "  requests " << g.requests << " (failed " << g.failures << ", hedges won " << g.hedgesWon << ")\n";
+    }
+    std::cout << termcolor::reset;
+}
+
+void CLI::showWorkers()
+{
+    ThreadPool::Stats st = ThreadPool::instance().stats();
+    std::cout << termcolor::cyan;
+    for (size_t i = 0; i < st.workers.size(); ++i)
+    {
+        const auto &w = st.workers[i];
+        std::cout << "worker " << std::setw(2) << i << std::fixed << std::setprecision(1) << "  busy " << std::setw(5)
+                  << w.utilization * 100 << "%  tasks " << std::setw(8) << w.tasks << "  stolen " << w.steals << "\n";
+    }
+    std::cout << st.submitted << " tasks submitted, " << st.helped << " run by threads waiting on the pool\n";
+    ChunkPool::Stats arena = ChunkPool::instance().stats();
+    std::cout << "arena chunks: " << arena.taken << " taken, " << arena.reused << " reused, " << arena.dropped
+              << " freed when the pool was full, " << arena.idleBytes / 1048576.0 << " MB idle\n"
+              << termcolor::reset;
+}
+
+// Time bound for 'store range': seconds since the epoch or ISO 8601
+static std::optional<int64_t> parseTimeArg(const std::string &arg)
+{
+    int64_t value;
+    auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+    if (ec == std::errc() && end == arg.data() + arg.size())
+    {
+        return value;
+    }
+    return parseIsoTimestamp(arg);
+}
+
+void CLI::storeCommand(const std::string &command)
+{
+    SegmentStore *stored = store();
+    if (!stored)
+    {
+        fail() << termcolor::yellow << "Segment store is disabled.\n" << termcolor::reset;
+        return;
+    }
+
+    std::istringstream args(command);
+    std::string verb;
+    args >> verb;
+    std::vector<std::string> found;
+    auto started = std::chrono::steady_clock::now();
+
+    try
+    {
+        if (verb.empty())
+        {
+            auto st = stored->stats();
+            std::cout << termcolor::cyan << st.records << " logs from " << st.blocks << " blocks in " << st.segments
+                      << " segments, " << st.diskBytes / 1024 << " KiB on disk (" << st.rawBytes / 1024
+                      << " KiB as JSON)\n";
+            if (st.index.files > 0)
+            {
+                std::cout << "Full-text index: " << st.index.terms << " terms, " << st.index.postings << " postings in "
+                          << st.index.bytes / 1024 << " KiB, " << st.index.files << " files\n";
+            }
+            std::cout << termcolor::reset;
+            return;
+        }
+
+        int64_t id;
+        std::string from, to;
+        size_t limit = 100;
+        if (verb == "id" && (args >> id))
+        {
+            found = stored->findEventId(id);
+        }
+        else if (verb == "range" && (args >> from >> to))
+        {
+            args >> limit;
+            auto lo = parseTimeArg(from), hi = parseTimeArg(to);
+            if (!lo || !hi)
+            {
+                std::cout << termcolor::yellow << "Times are seconds since the epoch or YYYY-MM-DDTHH:MM:SS\n"
+                          << termcolor::reset;
+                return;
+            }
+            found = stored->findTimeRange(*lo, *hi, limit);
+        }
+        else
+        {
+            std::cout << termcolor::yellow << "Usage: store | store id <event_id> | store range <from> <to> [limit]\n"
+                      << termcolor::reset;
+            return;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        fail() << termcolor::red << "[✘] Error: " << e.what() << "\n" << termcolor::reset;
+        return;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+    LogArena arena;
+    for (const auto &line : found)
+    {
+        if (events)
+        {
+            events->record(line, "");
+            continue;
+        }
+        printLog(parseLogRecord(line, arena));
+    }
+    std::cout << termcolor::cyan << "✔️  " << found.size() << " logs in " << elapsed.count() / 1000.0 << " ms\n"
+              << termcolor::reset;
+}
+
+// Looks terms up in the store's full-text index; at most 20 logs are shown
+void CLI::searchCommand(const std::string &query)
+{
+    SegmentStore *stored = store();
+    if (!stored)
+    {
+        fail() << termcolor::yellow << "Segment store is disabled.\n" << termcolor::reset;
+        return;
+    }
+    if (query.find_first_not_of(' ') == std::string::npos)
+    {
+        std::cout << termcolor::yellow << "Usage: search <term> [AND|OR <term> ...]\n" << termcolor::reset;
+        return;
+    }
+
+    SegmentStore::SearchResult found;
+    auto started = std::chrono::steady_clock::now();
+    try
+    {
+        found = stored->search(query, 20);
+    }
+    catch (const std::exception &e)
+    {
+        fail() << termcolor::red << "[✘] Error: " << e.what() << "\n" << termcolor::reset;
+        return;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+
+    LogArena arena;
+    for (const auto &line : found.records)
+    {
+        if (events)
+        {
+            events->record(line, "");
+            continue;
+        }
+        printLog(parseLogRecord(line, arena));
+    }
+    std::cout << termcolor::cyan << "✔️  " << found.total << " logs match";
+    if (found.total > found.records.size())
+    {
+        std::cout << ", showing the oldest " << found.records.size();
+    }
+    std::cout << "; " << elapsed.count() / 1000.0 << " ms\n" << termcolor::reset;
+}
+
+// Rescans every stored message for the configured threat patterns
+void CLI::scanCommand(const std::string &args)
+{
+    SegmentStore *stored = store();
+    if (!stored)
+    {
+        fail() << termcolor::yellow << "Segment store is disabled.\n" << termcolor::reset;
+        return;
+    }
+    size_t top = 20;
+    std::istringstream(args) >> top;
+
+    // Messages are matched in batches of about 4 MiB, so memory stays
+    // bounded on a large store while the timing covers matching alone
+    const size_t batchBytes = 4 << 20;
+    const RuleSet &rules = RuleSet::instance();
+    auto before = rules.stats();
+    std::vector<uint64_t> hits(rules.size());
+    std::vector<uint16_t> ids;
+    uint64_t records = 0, matched = 0, bytes = 0;
+    std::chrono::steady_clock::duration matching{};
+    LogArena arena;
+    std::vector<std::string_view> messages;
+    auto matchBatch = [&]
+    {
+        auto started = std::chrono::steady_clock::now();
+        for (std::string_view message : messages)
+        {
+            rules.match(message, ids);
+            bytes += message.size();
+            matched += !ids.empty();
+            for (uint16_t id : ids)
+            {
+                ++hits[id];
+            }
+        }
+        matching += std::chrono::steady_clock::now() - started;
+        messages.clear();
+        arena = LogArena();
+    };
+    try
+    {
+        stored->forEach([&](std::string_view line)
+        {
+            LogRecord record = parseLogRecord(line, arena);
+            ++records;
+            if (record.has(LogRecord::Message))
+            {
+                messages.push_back(record.message);
+            }
+            if (arena.bytesUsed() >= batchBytes)
+            {
+                matchBatch();
+            }
+        });
+    }
+    catch (const std::exception &e)
+    {
+        fail() << termcolor::red << "[✘] Error: " << e.what() << "\n" << termcolor::reset;
+        return;
+    }
+    matchBatch();
+    double seconds = std::chrono::duration<double>(matching).count();
+
+    std::vector<uint16_t> ranked;
+    for (size_t id = 0; id < hits.size(); ++id)
+    {
+        if (hits[id])
+        {
+            ranked.push_back(static_cast<uint16_t>(id));
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(), [&](uint16_t a, uint16_t b) { return hits[a] != hits[b] ? hits[a] > hits[b] : a < b; });
+    if (ranked.size() > top)
+    {
+        ranked.resize(top);
+    }
+
+    std::cout << termcolor::cyan;
+    for (uint16_t id : ranked)
+    {
+        std::cout << std::setw(10) << hits[id] << "  " << rules.rule(id).text << (rules.rule(id).regex ? "  (regex)" : "")
+                  << "\n";
+    }
+    auto after = rules.stats();
+    std::cout << "✔️  " << matched << " of " << records << " logs match; " << bytes / 1024 << " KiB of messages in "
+              << std::fixed << std::setprecision(2) << seconds * 1000 << " ms, "
+              << (seconds > 0 ? bytes / seconds / 1e9 : 0.0) << " GB/s (" << PatternMatcher::kernelName() << ")\n"
+              << "   " << after.literals << " literals, " << after.regexes << " regexes (" << after.unfiltered
+              << " without a literal prefilter); " << after.regexRuns - before.regexRuns
+              << " messages entered the regex DFA, " << after.dfa.dfaStates << " DFA states cached\n"
+              << termcolor::reset;
+}
+
+void CLI::showAlerts()
+{
+    if (!correlator)
+    {
+        std::cout << termcolor::yellow
+                  << (Config::security.enable_threat_detection ? "No logs correlated yet.\n"
+                                                               : "Threat detection is disabled.\n")
+                  << termcolor::reset;
+        return;
+    }
+    auto st = correlator->stats();
+    std::cout << termcolor::cyan << "✔️  " << st.events << " logs correlated, " << st.alerts << " alerts fired, "
+              << st.late << " too far out of order\n"
+              << "   " << st.keys << " (rule or type, source) keys in their windows, " << std::fixed
+              << std::setprecision(1) << st.memoryBytes / 1024.0 << " KiB\n"
+              << "   " << Config::security.max_failed_attempts << " threat events in " << Config::security.lockout_duration
+              << " s";
+    if (Config::security.enable_rate_limiting)
+    {
+        std::cout << ", " << Config::security.rate_limit_requests << " events of a type in "
+                  << Config::security.rate_limit_window << " s";
+    }
+    std::cout << " from one source raise an alert\n" << termcolor::reset;
+}
+
+// Compiles the threat rules up front, so the first fetch does not pay for
+// it, and reports rules that could not be compiled
+void CLI::loadRules()
+{
+    if (!Config::security.enable_pattern_matching)
+    {
+        return;
+    }
+    for (const auto &error : RuleSet::instance().errors())
+    {
+        warn() << termcolor::yellow << "[!] Skipping rule in " << Config::logging.patterns_file << ", " << error
+                  << "\n" << termcolor::reset;
+    }
+}
+
+// Parses the private keys once; every fetch afterwards reuses them
+void CLI::loadKeys()
+{
+    try
+    {
+        if (keyring.loadKeyFiles(Config::encryption.private_key_pems) == 0)
+        {
+            warn() << termcolor::yellow << "[!] No private key found in keys/ - decryption is unavailable\n"
+                      << termcolor::reset;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        fail() << termcolor::red << "[✘] Error loading keys: " << e.what() << "\n" << termcolor::reset;
+    }
+}
+
+// Takes cid by value, as callers pass lastPrevCID, which this replaces
+void CLI::loadCID(std::string cid)
+{
+    try
+    {
+        BlockPayload payload = fetchAndDecrypt(cid, keyring);
+
+        LogArena arena;
+        std::vector<LogRecord> logs = parseAndSortLogs(payload.logs, arena);
+        tagLogPatterns(logs, arena);
+        lastPrevCID = payload.prevCID;
+        if (correlator)
+        {
+            correlator->beginWalk();
+        }
+
+        JsonlSink &out = output();
+        SegmentStore *stored = store();
+        if (stored && stored->hasBlock(cid))
+        {
+            stored = nullptr;
+        }
+
+        if (!headless)
+        {
+            report() << termcolor::green << "=== Decrypted Logs ===\n" << termcolor::reset;
+        }
+
+        for (const auto &log : logs)
+        {
+            if (!headless)
+            {
+                printLog(log);
+            }
+            correlate(log);
+            out.write(log);
+            if (events)
+            {
+                events->record(log, cid);
+            }
+            if (stored)
+            {
+                stored->append(log, cid);
+            }
+        }
+        out.flush();
+        if (stored)
+        {
+            stored->flush();
+        }
+        if (ChainManifest *known = manifest())
+        {
+            known->add({{cid, ChainManifest::describe(lastPrevCID, logs)}});
+        }
+
+        report() << termcolor::cyan << "⬅️  prev_cid: " << lastPrevCID << "\n" << termcolor::reset;
+
+        if (lastPrevCID.empty())
+        {
+            report() << termcolor::cyan << "✔️  No more logs.\n" << termcolor::reset;
+        }
+        else if (!headless)
+        {
+            report() << termcolor::cyan << "➡️  Type 'fetch --chain' to load more logs...\n" << termcolor::reset;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        fail() << termcolor::red << "[✘] Error: " << e.what() << termcolor::reset << "\n";
+    }
+}
+
+
+// Walks back from lastPrevCID; with stopAtKnown, only until a block already
+// in the manifest. Blocks are added to the manifest once their records are
+// flushed, so an interrupted walk costs a refetch, never a gap.
+void CLI::walkChain(size_t maxBlocks, bool stopAtKnown)
+{
+    JsonlSink *out;
+    try
+    {
+        out = &output();
+    }
+    catch (const std::exception &e)
+    {
+        fail() << termcolor::red << "[✘] Error: " << e.what() << "\n" << termcolor::reset;
+        return;
+    }
+
+    if (correlator)
+    {
+        correlator->beginWalk();
+    }
+
+    ChainWalker walker(keyring, Config::performance.queue_size);
+    ChainManifest *known = manifest();
+    std::vector<std::pair<std::string, ChainManifest::Entry>> walked;
+    size_t records = 0;
+    auto started = std::chrono::steady_clock::now();
+
+    // Blocks may overlap in event_id, so records go through a bounded merge
+    // and come out in one newest-first order across the whole walk
+    SegmentStore *stored = store();
+    LogMerger merger(Config::performance.merge_window, [&](const LogRecord &log, const ChainBlock &block) {
+        if (!headless)
+        {
+            printLog(log);
+        }
+        correlate(log);
+        out->write(log);
+        if (events)
+        {
+            events->record(log, block.cid);
+        }
+        if (stored && !stored->hasBlock(block.cid))
+        {
+            stored->append(log, block.cid);
+        }
+        ++records;
+    });
+
+    try
+    {
+        walker.walk(lastPrevCID, maxBlocks, [&](ChainBlock &block) {
+            if (!headless)
+            {
+                report() << termcolor::green << "=== Block " << block.index + 1 << ": " << block.cid << " ===\n"
+                         << termcolor::reset;
+            }
+            if (events)
+            {
+                std::string fields = "\"block\":" + std::to_string(block.index + 1) + ",\"cid\":";
+                appendJsonString(fields, block.cid);
+                fields += ",\"records\":" + std::to_string(block.logs.size());
+                events->event("progress", fields);
+            }
+            lastPrevCID = block.prevCID;
+            if (known)
+            {
+                walked.emplace_back(block.cid, ChainManifest::describe(block.prevCID, block.logs));
+            }
+            merger.push(std::move(block));
+        }, stopAtKnown && known ? ChainWalker::StopAt([&](const std::string &cid) { return known->contains(cid); })
+                                : ChainWalker::StopAt());
+    }
+    catch (const ChainWalkError &e)
+    {
+        lastPrevCID = e.cid;
+        fail() << termcolor::red << "[✘] Error: " << e.what() << "\n" << termcolor::reset;
+    }
+    catch (const std::exception &e)
+    {
+        fail() << termcolor::red << "[✘] Error: " << e.what() << "\n" << termcolor::reset;
+    }
+    try
+    {
+        merger.finish();
+        out->flush();
+        if (stored)
+        {
+            stored->flush();
+        }
+        if (known)
+        {
+            known->add(walked);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        fail() << termcolor::red << "[✘] Error: " << e.what() << "\n" << termcolor::reset;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    report() << termcolor::cyan << "✔️  " << records << " logs in " << elapsed.count() << " ms\n";
+    if (merger.lateRecords() > 0)
+    {
+        report() << termcolor::yellow << "[!] " << merger.lateRecords()
+                  << " logs arrived after newer ones were written; raise performance.merge_window to order them\n"
+                  << termcolor::cyan;
+    }
+    if (lastPrevCID.empty())
+    {
+        report() << "✔️  No more logs.\n" << termcolor::reset;
+    }
+    else
+    {
+        report() << "⬅️  prev_cid: " << lastPrevCID << "\n" << termcolor::reset;
+    }
+}
+
+// Resolves the head and walks back only to the newest block already
+// processed, then follows the manifest to where history is still missing
+void CLI::syncChain()
+{
+    ChainManifest *known = manifest();
+    if (!known)
+    {
+        return;
+    }
+    std::string head;
+    try
+    {
+        head = resolveIPNSKey(true);
+    }
+    catch (const std::exception &e)
+    {
+        fail() << termcolor::red << "Resolve error: " << e.what() << "\n" << termcolor::reset;
+        return;
+    }
+
+    if (known->contains(head))
+    {
+        report() << termcolor::cyan << "✔️  Head " << head << " is already synced\n" << termcolor::reset;
+        lastPrevCID = head;
+    }
+    else
+    {
+        report() << termcolor::green << "[✓] Resolved CID: " << head << "\n" << termcolor::reset;
+        lastPrevCID = head;
+        walkChain(0, true);
+    }
+
+    ChainManifest::Tail tail = known->follow(lastPrevCID);
+    lastPrevCID = tail.missing;
+    report() << termcolor::cyan;
+    if (tail.blocks > 0)
+    {
+        report() << "✔️  " << tail.blocks << " blocks with " << tail.records << " logs from there on were already synced\n";
+    }
+    if (lastPrevCID.empty())
+    {
+        report() << "✔️  The chain is synced back to its first block.\n";
+    }
+    else
+    {
+        report() << "⬅️  Not synced yet from " << lastPrevCID << "; 'fetch --chain --all' continues there\n";
+    }
+    report() << termcolor::reset;
+}
+
+static volatile std::sig_atomic_t watchInterrupted = 0;
+
+// Waits up to timeout for a line on stdin, which is consumed unless keep
+// is set; false on timeout or Ctrl-C
+static bool waitForEnter(std::chrono::milliseconds timeout, bool keep)
+{
+    // A line may already sit in std::cin's buffer, where poll cannot see it
+    pollfd in{STDIN_FILENO, POLLIN, 0};
+    if (std::cin.rdbuf()->in_avail() <= 0 &&
+        (::poll(&in, 1, static_cast<int>(timeout.count())) <= 0 || watchInterrupted))
+    {
+        return false;
+    }
+    if (!keep)
+    {
+        std::string line;
+        std::getline(std::cin, line);
+    }
+    return true;
+}
+
+// "<median> ms, max <max> ms" of ranges given by their lower and upper bounds
+static std::string latencySummary(std::vector<double> lower, std::vector<double> upper)
+{
+    std::sort(lower.begin(), lower.end());
+    std::sort(upper.begin(), upper.end());
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1) << lower[lower.size() / 2] << "-" << upper[upper.size() / 2]
+        << " ms median, " << lower.back() << "-" << upper.back() << " ms max";
+    return out.str();
+}
+
+// Polls the IPNS head, every watch_min_interval_ms after a change and
+// backing off to watch_max_interval_ms while it stays put, and syncs the
+// new blocks whenever it moves. The publish time of a head is not known,
+// only that it falls between the previous poll and the one that saw it, so
+// publish-to-visible latency is reported as that range.
+void CLI::watchChain(const std::string &args)
+{
+    ChainManifest *known = manifest();
+    if (!known)
+    {
+        return;
+    }
+    using Clock = std::chrono::steady_clock;
+    using Millis = std::chrono::duration<double, std::milli>;
+    double seconds = 0;
+    std::istringstream(args) >> seconds;
+    auto deadline = seconds > 0 ? Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds))
+                                : Clock::time_point::max();
+    const std::chrono::milliseconds minInterval(Config::ipfs.watch_min_interval_ms);
+    const std::chrono::milliseconds maxInterval(Config::ipfs.watch_max_interval_ms);
+
+    // On the ndjson protocol stdin carries commands: the next one ends the
+    // watch and is left for run() to answer
+    report() << termcolor::cyan << "Watching the IPNS head; "
+             << (events ? "the next command stops it\n" : "press Enter or Ctrl-C to stop\n") << termcolor::reset;
+    if (events)
+    {
+        flushEvents();
+    }
+    watchInterrupted = 0;
+    auto previousHandler = std::signal(SIGINT, [](int) { watchInterrupted = 1; });
+
+    std::string head;
+    std::string lastError;
+    auto interval = minInterval;
+    Clock::time_point previousPoll{};
+    std::vector<double> earliest, latest;
+    size_t polls = 0, changes = 0;
+    while (!watchInterrupted && Clock::now() < deadline)
+    {
+        auto polled = Clock::now();
+        ++polls;
+        std::string current;
+        try
+        {
+            current = resolveIPNSKey(true);
+            lastError.clear();
+        }
+        catch (const std::exception &e)
+        {
+            if (lastError != e.what())
+            {
+                lastError = e.what();
+                warn() << termcolor::red << "Resolve error: " << lastError << "\n" << termcolor::reset;
+            }
+        }
+
+        if (!current.empty() && current != head)
+        {
+            bool first = head.empty();
+            head = current;
+            interval = minInterval;
+            if (!known->contains(head))
+            {
+                lastPrevCID = head;
+                walkChain(0, true);
+                lastPrevCID = known->follow(lastPrevCID).missing;
+                auto visible = Clock::now();
+                if (!first)
+                {
+                    ++changes;
+                    earliest.push_back(Millis(visible - polled).count());
+                    latest.push_back(Millis(visible - previousPoll).count());
+                    report() << termcolor::cyan << std::fixed << std::setprecision(1) << "[watch] New head visible "
+                             << earliest.back() << " to " << latest.back() << " ms after it was published\n"
+                             << termcolor::reset;
+                }
+                if (events && !flushEvents())
+                {
+                    break;
+                }
+            }
+        }
+        else
+        {
+            interval = std::min(interval * 2, maxInterval);
+        }
+        previousPoll = polled;
+
+        auto wait = std::min<Clock::duration>(interval, deadline - Clock::now());
+        if (wait.count() > 0 && waitForEnter(std::chrono::duration_cast<std::chrono::milliseconds>(wait), events != nullptr))
+        {
+            break;
+        }
+    }
+
+    std::signal(SIGINT, previousHandler);
+    report() << termcolor::cyan << "✔️  Watched " << polls << " polls, " << changes << " head changes";
+    if (!earliest.empty())
+    {
+        report() << "; publish to visible in " << latencySummary(earliest, latest);
+    }
+    report() << "\n" << termcolor::reset;
+}
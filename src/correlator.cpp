@@ -0,0 +1,167 @@
+#include "correlator.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <bit>
+
+static_assert(std::has_single_bit(static_cast<unsigned>(WindowCounter::kBuckets)));
+
+static constexpr size_t kMinSlots = 64;
+
+static int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return q - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+static size_t ring(int64_t bucket) {
+    return static_cast<uint64_t>(bucket) & (WindowCounter::kBuckets - 1);
+}
+
+WindowCounter::WindowCounter(uint32_t windowSeconds, uint32_t threshold)
+    : window_(std::max<uint32_t>(windowSeconds, 1)),
+      threshold_(std::max<uint32_t>(threshold, 1)),
+      width_((window_ + kBuckets - 1) / kBuckets),
+      slots_(kMinSlots, Slot{}) {}
+
+uint32_t WindowCounter::add(uint64_t key, int64_t t) {
+    int64_t bucket = floorDiv(t, width_);
+    now_ = std::max(now_, bucket);
+    if (bucket <= now_ - kBuckets) {
+        ++late_;
+        return 0;
+    }
+    key += key == 0;
+    if ((used_ + 1) * 4 > slots_.size() * 3) rebuild();
+
+    // Expired slots are passed over like tombstones, so a key further along
+    // the probe sequence is still found, and the first one is reused
+    size_t mask = slots_.size() - 1;
+    Slot* slot = nullptr;
+    Slot* expired = nullptr;
+    for (size_t i = key & mask;; i = (i + 1) & mask) {
+        Slot& s = slots_[i];
+        if (s.key == key) {
+            slot = &s;
+            if (!live(s)) *slot = Slot{key, bucket, INT64_MIN, {}};
+            break;
+        }
+        if (s.key == 0) {
+            slot = expired ? expired : &s;
+            used_ += !expired;
+            *slot = Slot{key, bucket, INT64_MIN, {}};
+            break;
+        }
+        if (!expired && !live(s)) expired = &s;
+    }
+
+    if (bucket > slot->head) {
+        int64_t stale = std::min<int64_t>(bucket - slot->head, kBuckets);
+        for (int64_t b = bucket - stale + 1; b <= bucket; ++b) slot->counts[ring(b)] = 0;
+        slot->head = bucket;
+    }
+    uint16_t& count = slot->counts[ring(bucket)];
+    count += count != UINT16_MAX;
+
+    uint32_t total = 0;
+    for (uint16_t c : slot->counts) total += c;
+    if (total < threshold_ || slot->head < slot->quietUntil) return 0;
+    slot->quietUntil = slot->head + kBuckets;
+    return total;
+}
+
+void WindowCounter::clear() {
+    slots_.assign(kMinSlots, Slot{});
+    used_ = 0;
+    now_ = INT64_MIN + kBuckets;
+}
+
+size_t WindowCounter::keys() const {
+    return std::count_if(slots_.begin(), slots_.end(), [&](const Slot& s) { return s.key != 0 && live(s); });
+}
+
+// Rehashes the live slots into a table twice their number, which also
+// shrinks it once a burst of keys has expired
+void WindowCounter::rebuild() {
+    std::vector<Slot> old(std::bit_ceil(std::max(kMinSlots, (keys() + 1) * 2)), Slot{});
+    old.swap(slots_);
+    used_ = 0;
+    size_t mask = slots_.size() - 1;
+    for (const Slot& s : old) {
+        if (s.key == 0 || !live(s)) continue;
+        size_t i = s.key & mask;
+        while (slots_[i].key != 0) i = (i + 1) & mask;
+        slots_[i] = s;
+        ++used_;
+    }
+}
+
+// FNV-1a over the source, finished with the splitmix64 mixer so the low
+// bits used for probing depend on every byte
+static uint64_t correlationKey(uint16_t kind, std::string_view source) {
+    uint64_t h = 14695981039346656037ull ^ kind;
+    for (unsigned char c : source) h = (h ^ c) * 1099511628211ull;
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+Correlator::Correlator(const Options& options)
+    : options_(options), attempts_(options.attemptWindow, options.maxAttempts) {
+    if (options.rateLimiting) requests_.emplace(options.requestWindow, options.maxRequests);
+}
+
+std::unique_ptr<Correlator> Correlator::fromConfig() {
+    const auto& sec = Config::security;
+    return std::make_unique<Correlator>(Options{static_cast<uint32_t>(sec.max_failed_attempts),
+                                                static_cast<uint32_t>(sec.lockout_duration),
+                                                sec.enable_rate_limiting,
+                                                static_cast<uint32_t>(sec.rate_limit_requests),
+                                                static_cast<uint32_t>(sec.rate_limit_window),
+                                                true});
+}
+
+void Correlator::observe(const LogRecord& record, std::vector<Alert>& alerts) {
+    alerts.clear();
+    if (!record.has(LogRecord::Timestamp) && !record.has(LogRecord::TimestampText)) return;
+    ++events_;
+    // Counting on negated time turns a newest-first stream into an ascending one
+    int64_t t = options_.newestFirst ? -record.timestamp : record.timestamp;
+    // A walk that goes back over time already counted, such as a sync from
+    // a newer head, starts afresh
+    if (walkStarted_) {
+        walkStarted_ = false;
+        if (t < last_) {
+            attempts_.clear();
+            if (requests_) requests_->clear();
+            last_ = t;
+        }
+    }
+    last_ = std::max(last_, t);
+    for (uint16_t id : record.patternIds()) {
+        if (uint32_t count = attempts_.add(correlationKey(id, record.source), t)) {
+            alerts.push_back({Alert::Attempts, id, record.source, count, attempts_.window(), record.timestamp});
+        }
+    }
+    if (requests_ && record.has(LogRecord::Type)) {
+        if (uint32_t count = requests_->add(correlationKey(record.typeId, record.source), t)) {
+            alerts.push_back({Alert::Rate, record.typeId, record.source, count, requests_->window(), record.timestamp});
+        }
+    }
+    alerts_ += alerts.size();
+}
+
+Correlator::Stats Correlator::stats() const {
+    Stats stats{};
+    stats.events = events_;
+    stats.late = attempts_.late();
+    stats.alerts = alerts_;
+    stats.keys = attempts_.keys();
+    stats.memoryBytes = sizeof(*this) + attempts_.memoryBytes() - sizeof(attempts_);
+    if (requests_) {
+        stats.late += requests_->late();
+        stats.keys += requests_->keys();
+        stats.memoryBytes += requests_->memoryBytes() - sizeof(*requests_);
+    }
+    return stats;
+}
@@ -0,0 +1,262 @@
+#include "daemon.hpp"
+#include "config.hpp"
+#include "decryptor.hpp"
+#include "fetcher.hpp"
+#include "json.hpp"
+#include "jsonl_sink.hpp"
+#include "log_record.hpp"
+#include "rule_set.hpp"
+#include "segment_store.hpp"
+#include "thread_pool.hpp"
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Replies queued for one client before its handlers wait for it to read
+constexpr size_t kMaxPending = 8 << 20;
+constexpr size_t kMaxInFlight = 64;
+
+std::string quote(const std::string& text) {
+    return json(text).dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+std::string poolStats() {
+    ThreadPool::Stats pool = ThreadPool::instance().stats();
+    std::string out = "{\"workers\":[";
+    for (size_t i = 0; i < pool.workers.size(); ++i) {
+        const auto& worker = pool.workers[i];
+        out += (i ? ",{\"tasks\":" : "{\"tasks\":") + std::to_string(worker.tasks) +
+               ",\"steals\":" + std::to_string(worker.steals) + ",\"utilization\":" + json(worker.utilization).dump() + "}";
+    }
+    return out + "],\"submitted\":" + std::to_string(pool.submitted) + ",\"helped\":" + std::to_string(pool.helped) + "}";
+}
+
+std::string arenaStats() {
+    ChunkPool::Stats arena = ChunkPool::instance().stats();
+    return "{\"taken\":" + std::to_string(arena.taken) + ",\"reused\":" + std::to_string(arena.reused) +
+           ",\"dropped\":" + std::to_string(arena.dropped) + ",\"idle_bytes\":" + std::to_string(arena.idleBytes) + "}";
+}
+
+} // namespace
+
+Daemon::Daemon(Options options, Keyring& keyring, JsonlSink& out, SegmentStore* store, ChainManifest* manifest,
+               Resolver resolveHead)
+    : options_(std::move(options)),
+      keyring_(keyring),
+      resolveHead_(std::move(resolveHead)),
+      out_(out),
+      store_(store),
+      manifest_(manifest),
+      server_({options_.socketPath, options_.maxClients, options_.workers, kMaxPending, kMaxInFlight},
+              [this](const RpcServer::Request& request, RpcServer::Stream& stream) { return handle(request, stream); }) {}
+
+Daemon::Options Daemon::optionsFromConfig() {
+    return {Config::network.daemon_socket,
+            static_cast<size_t>(Config::network.daemon_cache_mb) << 20,
+            static_cast<size_t>(Config::network.max_connections),
+            static_cast<size_t>(Config::network.thread_pool_size)};
+}
+
+void Daemon::run() {
+    server_.run();
+}
+
+void Daemon::stop() {
+    server_.stop();
+}
+
+Daemon::Stats Daemon::stats() const {
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    return stats_;
+}
+
+std::string Daemon::handle(const RpcServer::Request& request, RpcServer::Stream& stream) {
+    json params = json::parse(request.params, nullptr, false);
+    if (!params.is_object()) throw std::runtime_error("params must be an object");
+    auto text = [&](const char* key) {
+        return params.contains(key) && params[key].is_string() ? params[key].get<std::string>() : std::string();
+    };
+    auto number = [&](const char* key, size_t fallback) {
+        return params.contains(key) && params[key].is_number_unsigned() ? params[key].get<size_t>() : fallback;
+    };
+
+    if (request.method == "resolve") {
+        return "\"cid\":" + quote(resolveHead_());
+    }
+    if (request.method == "fetch") {
+        std::string cid = text("cid");
+        if (cid.empty()) throw std::runtime_error("fetch needs a cid");
+        return walk(cid, 1, stream);
+    }
+    if (request.method == "chain") {
+        return walk(text("from"), number("depth", 0), stream);
+    }
+    if (request.method == "search") {
+        if (!store_) throw std::runtime_error("The segment store is disabled");
+        SegmentStore::SearchResult found;
+        {
+            std::lock_guard<std::mutex> lock(persistMutex_);
+            found = store_->search(text("query"), number("limit", 100));
+        }
+        std::string records = "\"records\":[";
+        for (size_t i = 0; i < found.records.size(); ++i) {
+            if (i) records += ',';
+            records += found.records[i];
+        }
+        stream.send("records", records + "]");
+        return "\"total\":" + std::to_string(found.total);
+    }
+    if (request.method == "stats") {
+        Stats cache = stats();
+        RpcServer::Stats server = server_.stats();
+        return "\"cache\":{\"blocks\":" + std::to_string(cache.blocks) + ",\"bytes\":" + std::to_string(cache.bytes) +
+               ",\"hits\":" + std::to_string(cache.hits) + ",\"shared\":" + std::to_string(cache.shared) +
+               ",\"decoded\":" + std::to_string(cache.decoded) + "},\"server\":{\"clients\":" +
+               std::to_string(server.clients) + ",\"connections\":" + std::to_string(server.connections) +
+               ",\"requests\":" + std::to_string(server.requests) + ",\"errors\":" + std::to_string(server.errors) +
+               ",\"frames\":" + std::to_string(server.framesOut) + ",\"bytes\":" + std::to_string(server.bytesOut) +
+               "},\"pool\":" + poolStats() + ",\"arena\":" + arenaStats();
+    }
+    throw std::runtime_error("Unknown method " + request.method);
+}
+
+// Streams blocks from `from` (the head if empty). The next block is fetched
+// while the current one goes out to the client.
+std::string Daemon::walk(const std::string& from, size_t depth, RpcServer::Stream& stream) {
+    std::string cid = from.empty() ? resolveHead_() : from;
+    size_t blocks = 0;
+    uint64_t records = 0;
+    auto fetch = [this](std::string cid) {
+        return ThreadPool::instance().submit([this, cid] {
+            try {
+                return block(cid);
+            } catch (const std::exception& e) {
+                throw std::runtime_error("Block " + cid + ": " + e.what());
+            }
+        }, ThreadPool::Priority::High);
+    };
+
+    // However the walk ends, a prefetch still in flight uses this daemon and
+    // may already have written its block's records, so it is waited for
+    // before they are committed
+    std::future<BlockPtr> next;
+    auto settle = [&] {
+        if (next.valid()) next.wait();
+        commit();
+    };
+
+    try {
+        if (!cid.empty()) next = fetch(cid);
+        while (next.valid()) {
+            BlockPtr current = next.get();
+            std::string at = std::move(cid);
+            cid = current->prevCID;
+            ++blocks;
+            records += current->count;
+            if (!cid.empty() && (depth == 0 || blocks < depth) && !stream.cancelled()) next = fetch(cid);
+            if (!stream.send("block", "\"cid\":" + quote(at) + ",\"prev_cid\":" + quote(cid) + ",\"records\":[" +
+                                          current->records + "]")) {
+                break;
+            }
+        }
+    } catch (...) {
+        settle();
+        throw;
+    }
+    settle();
+    return "\"blocks\":" + std::to_string(blocks) + ",\"records\":" + std::to_string(records) +
+           ",\"prev_cid\":" + quote(cid);
+}
+
+Daemon::BlockPtr Daemon::block(const std::string& cid) {
+    std::promise<BlockPtr> promise;
+    std::shared_future<BlockPtr> pending;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        if (auto it = cached_.find(cid); it != cached_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            ++stats_.hits;
+            return it->second.block;
+        }
+        if (auto it = fetching_.find(cid); it != fetching_.end()) {
+            pending = it->second;
+            ++stats_.shared;
+        } else {
+            fetching_.emplace(cid, promise.get_future().share());
+        }
+    }
+    if (pending.valid()) return pending.get();
+
+    BlockPtr decoded;
+    try {
+        decoded = decode(cid);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        fetching_.erase(cid);
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    fetching_.erase(cid);
+    promise.set_value(decoded);
+    ++stats_.decoded;
+    size_t size = decoded->records.size() + decoded->prevCID.size() + cid.size();
+    if (size <= options_.cacheBytes) {
+        while (stats_.bytes + size > options_.cacheBytes) {
+            auto victim = cached_.find(lru_.back());
+            stats_.bytes -= victim->second.block->records.size() + victim->second.block->prevCID.size() +
+                            victim->first.size();
+            cached_.erase(victim);
+            lru_.pop_back();
+        }
+        lru_.push_front(cid);
+        cached_.emplace(cid, Cached{decoded, lru_.begin()});
+        stats_.bytes += size;
+        stats_.blocks = cached_.size();
+    }
+    return decoded;
+}
+
+Daemon::BlockPtr Daemon::decode(const std::string& cid) {
+    BlockPayload payload = fetchAndDecrypt(cid, keyring_);
+    LogArena arena;
+    std::vector<LogRecord> logs = parseAndSortLogs(payload.logs, arena);
+    tagLogPatterns(logs, arena);
+
+    auto decoded = std::make_shared<Block>();
+    decoded->prevCID = payload.prevCID;
+    decoded->count = static_cast<uint32_t>(logs.size());
+    for (size_t i = 0; i < logs.size(); ++i) {
+        if (i) decoded->records += ',';
+        appendLogRecordJson(decoded->records, logs[i]);
+    }
+
+    // A block decoded again after leaving the cache, or one an earlier
+    // walk already processed, is not written out a second time
+    std::lock_guard<std::mutex> lock(persistMutex_);
+    if (!written_.insert(cid).second || (manifest_ && manifest_->contains(cid)) ||
+        (store_ && store_->hasBlock(cid))) {
+        return decoded;
+    }
+    for (const auto& log : logs) {
+        out_.write(log);
+        if (store_) store_->append(log, cid);
+    }
+    if (manifest_) uncommitted_.emplace_back(cid, ChainManifest::describe(payload.prevCID, logs));
+    return decoded;
+}
+
+// Blocks go into the manifest only once their records are flushed, as in
+// the CLI's walks
+void Daemon::commit() {
+    std::lock_guard<std::mutex> lock(persistMutex_);
+    out_.flush();
+    if (store_) store_->flush();
+    if (manifest_ && !uncommitted_.empty()) {
+        manifest_->add(uncommitted_);
+        uncommitted_.clear();
+    }
+}
@@ -1,66 +1,242 @@
 #include "decryptor.hpp"
+#include "base64.hpp"
+#include "json_scan.hpp"
+#include "json_stream.hpp"
+#include "keyring.hpp"
 #include "utils.hpp"
-#include <openssl/pem.h>
 #include <openssl/evp.h>
-#include <openssl/rsa.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
-using json = nlohmann::json;
+namespace {
 
-std::vector<unsigned char> rsaDecrypt(const std::vector<unsigned char>& encrypted, const std::string& privateKeyPath) {
-    FILE* fp = fopen(privateKeyPath.c_str(), "r");
-    if (!fp) throw std::runtime_error("Cannot open private key file");
+// Upper bound for the short envelope fields, so garbage input cannot grow them
+constexpr size_t kMaxSmallField = 16 * 1024;
+constexpr size_t kFeedChunk = 64 * 1024;
+static_assert(kFeedChunk <= ChunkPool::kChunkSize, "a pool chunk holds the plaintext of one feed");
 
-    RSA* rsa = PEM_read_RSAPrivateKey(fp, nullptr, nullptr, nullptr);
-    fclose(fp);
-    if (!rsa) throw std::runtime_error("Failed to read RSA key");
+// Collects log lines and prev_cid from the decrypted plaintext
+class PayloadHandler : public JsonStreamScanner::Handler {
+public:
+    void beginString(const std::string& key, bool inArray) override {
+        target_ = Target::None;
+        if (key == "logs" && inArray) {
+            payload.arena.beginString();
+            target_ = Target::Log;
+        } else if (key == "prev_cid" && !inArray) {
+            payload.prevCID.clear();
+            target_ = Target::PrevCID;
+        }
+    }
+    void stringData(const char* data, size_t len) override {
+        if (target_ == Target::Log) {
+            payload.arena.appendString(data, len);
+        } else if (target_ == Target::PrevCID) {
+            payload.prevCID.append(data, len);
+        }
+    }
+    void endString() override {
+        if (target_ == Target::Log) payload.logs.push_back(payload.arena.endString());
+        target_ = Target::None;
+    }
 
-    std::vector<unsigned char> decrypted(RSA_size(rsa));
-    int len = RSA_private_decrypt(encrypted.size(), encrypted.data(), decrypted.data(), rsa, RSA_PKCS1_OAEP_PADDING);
-    RSA_free(rsa);
+    BlockPayload payload;
 
-    if (len == -1) throw std::runtime_error("RSA decryption failed");
-    decrypted.resize(len);
-    return decrypted;
-}
+private:
+    enum class Target { None, Log, PrevCID };
+    Target target_ = Target::None;
+};
 
-std::vector<unsigned char> aesGcmDecrypt(
-    const std::vector<unsigned char>& ciphertext,
-    const std::vector<unsigned char>& key,
-    const std::vector<unsigned char>& iv,
-    const std::vector<unsigned char>& tag
-) {
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    std::vector<unsigned char> plaintext(ciphertext.size());
-    int len = 0, out_len = 0;
-
-    if (!EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr))
-        throw std::runtime_error("AES init failed");
-
-    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv.size(), nullptr);
-    EVP_DecryptInit_ex(ctx, nullptr, nullptr, key.data(), iv.data());
-    EVP_DecryptUpdate(ctx, plaintext.data(), &len, ciphertext.data(), ciphertext.size());
-    out_len = len;
-    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, tag.size(), (void*)tag.data());
-
-    if (EVP_DecryptFinal_ex(ctx, plaintext.data() + len, &len) <= 0)
-        throw std::runtime_error("GCM decryption failed (bad tag?)");
-
-    out_len += len;
-    plaintext.resize(out_len);
-    EVP_CIPHER_CTX_free(ctx);
-    return plaintext;
-}
+} // namespace
+
+struct EnvelopeDecoder::Impl : JsonStreamScanner::Handler {
+    enum class Field { None, D, K, N, T, Kid };
+
+    explicit Impl(Keyring& keyring) : keyring(keyring) {}
+    ~Impl() override {
+        if (ctx) EVP_CIPHER_CTX_free(ctx);
+    }
+
+    void beginString(const std::string& key, bool inArray) override {
+        field = Field::None;
+        if (inArray) return;
+        std::string* text = nullptr;
+        if (key == "d") {
+            if (seenD) throw std::runtime_error("Duplicate field 'd' in envelope");
+            seenD = true;
+            field = Field::D;
+            return;
+        }
+        if (key == "k") { field = Field::K; text = &k; }
+        else if (key == "n") { field = Field::N; text = &n; }
+        else if (key == "t") { field = Field::T; text = &t; }
+        else if (key == "kid") { field = Field::Kid; text = &kid; }
+        if (text) text->clear();
+    }
+
+    void stringData(const char* data, size_t len) override {
+        std::string* text = nullptr;
+        switch (field) {
+        case Field::D:
+            cipherBuf.clear();
+            dDecoder.feed(data, len, cipherBuf);
+            consumeCipher();
+            return;
+        case Field::K: text = &k; break;
+        case Field::N: text = &n; break;
+        case Field::T: text = &t; break;
+        case Field::Kid: text = &kid; break;
+        case Field::None: return;
+        }
+        if (text->size() + len > kMaxSmallField) throw std::runtime_error("Envelope field too large");
+        text->append(data, len);
+    }
+
+    void endString() override {
+        switch (field) {
+        case Field::D:
+            cipherBuf.clear();
+            dDecoder.finish(cipherBuf);
+            consumeCipher();
+            break;
+        case Field::K: seenK = true; break;
+        case Field::N: seenN = true; break;
+        case Field::T: seenT = true; break;
+        default: break;
+        }
+        field = Field::None;
+    }
+
+    void initCipher() {
+        auto aesKey = keyring.unwrap(base64Decode(k), kid);
+        auto iv = base64Decode(n);
+
+        ctx = EVP_CIPHER_CTX_new();
+        if (!ctx || !EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr))
+            throw std::runtime_error("AES init failed");
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, static_cast<int>(iv.size()), nullptr);
+        if (!EVP_DecryptInit_ex(ctx, nullptr, nullptr, aesKey.data(), iv.data()))
+            throw std::runtime_error("AES init failed");
+
+        for (size_t i = 0; i < pending.size(); ++i) {
+            size_t len = i + 1 == pending.size() ? pendingTail : ChunkPool::kChunkSize;
+            decrypt(reinterpret_cast<const unsigned char*>(pending[i].get()), len);
+            // Back to the pool, so the arena can take it for the plaintext
+            pending[i].reset();
+        }
+        pending.clear();
+    }
+
+    void consumeCipher() {
+        if (cipherBuf.empty()) return;
+        // The key is unwrapped lazily so that a kid sent before d is honoured
+        if (!ctx && seenK && seenN) initCipher();
+        if (ctx) {
+            decrypt(cipherBuf.data(), cipherBuf.size());
+        } else {
+            holdBack(cipherBuf.data(), cipherBuf.size());
+        }
+    }
 
-json decryptAndParse(const std::string& jsonData, const std::string& privateKeyPath) {
-    json j = json::parse(jsonData);
+    void holdBack(const unsigned char* data, size_t len) {
+        while (len > 0) {
+            if (pending.empty() || pendingTail == ChunkPool::kChunkSize) {
+                pending.push_back(ChunkPool::instance().take());
+                pendingTail = 0;
+            }
+            size_t n = std::min(len, ChunkPool::kChunkSize - pendingTail);
+            std::memcpy(pending.back().get() + pendingTail, data, n);
+            pendingTail += n;
+            data += n;
+            len -= n;
+        }
+    }
 
-    auto d = base64Decode(j["d"]);
-    auto k = base64Decode(j["k"]);
-    auto n = base64Decode(j["n"]);
-    auto t = base64Decode(j["t"]);
+    void decrypt(const unsigned char* data, size_t len) {
+        if (!plainBuf) plainBuf = ChunkPool::instance().take();
+        auto* plain = reinterpret_cast<unsigned char*>(plainBuf.get());
+        while (len > 0) {
+            int n = static_cast<int>(std::min(len, kFeedChunk));
+            int out = 0;
+            // GCM is a stream mode: n bytes in, n bytes out
+            if (!EVP_DecryptUpdate(ctx, plain, &out, data, n))
+                throw std::runtime_error("AES decryption failed");
+            data += n;
+            len -= n;
+            if (!plainError.empty()) continue;
+            if (!plainUtf8.feed(reinterpret_cast<const char*>(plain), out)) {
+                plainError = "invalid UTF-8";
+                continue;
+            }
+            try {
+                plainScanner.feed(reinterpret_cast<const char*>(plain), out);
+            } catch (const std::exception& e) {
+                // Unauthenticated until the tag checks out; report it then
+                plainError = e.what();
+            }
+        }
+    }
 
-    auto aesKey = rsaDecrypt(k, privateKeyPath);
-    auto decrypted = aesGcmDecrypt(d, aesKey, n, t);
+    BlockPayload finish() {
+        envelope.finish();
+        if (!seenD || !seenK || !seenN || !seenT) throw std::runtime_error("Envelope is missing d, k, n or t");
+        if (!ctx) initCipher();
+
+        auto tag = base64Decode(t);
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, static_cast<int>(tag.size()), tag.data());
+        unsigned char tail[16];
+        int len = 0;
+        if (EVP_DecryptFinal_ex(ctx, tail, &len) <= 0)
+            throw std::runtime_error("GCM decryption failed (bad tag?)");
+
+        if (plainError.empty() && !plainUtf8.finish()) plainError = "invalid UTF-8";
+        if (!plainError.empty()) throw std::runtime_error("Invalid block payload: " + plainError);
+        try {
+            plainScanner.finish();
+        } catch (const std::exception& e) {
+            throw std::runtime_error(std::string("Invalid block payload: ") + e.what());
+        }
+        return std::move(payload.payload);
+    }
+
+    Keyring& keyring;
+    JsonStreamScanner envelope{*this};
+    PayloadHandler payload;
+    JsonStreamScanner plainScanner{payload};
+    // Checked over the whole plaintext, so that log lines and prev_cid are
+    // known to be UTF-8 before anything parses them
+    Utf8Validator plainUtf8;
+    std::string plainError;
+
+    Field field = Field::None;
+    bool seenD = false, seenK = false, seenN = false, seenT = false;
+    std::string k, n, t, kid;
+
+    Base64Decoder dDecoder;
+    EVP_CIPHER_CTX* ctx = nullptr;
+    std::vector<unsigned char> cipherBuf;
+    ChunkPool::Chunk plainBuf;
+    std::vector<ChunkPool::Chunk> pending;  // ciphertext received before k and n
+    size_t pendingTail = 0;                 // bytes used in the last of them
+};
+
+EnvelopeDecoder::EnvelopeDecoder(Keyring& keyring) : impl_(std::make_unique<Impl>(keyring)) {}
+
+EnvelopeDecoder::~EnvelopeDecoder() = default;
+
+void EnvelopeDecoder::feed(const char* data, size_t len) {
+    impl_->envelope.feed(data, len);
+}
+
+BlockPayload EnvelopeDecoder::finish() {
+    return impl_->finish();
+}
 
-    return json::parse(std::string(decrypted.begin(), decrypted.end()));
+BlockPayload decryptBlock(std::string_view envelope, Keyring& keyring) {
+    EnvelopeDecoder decoder(keyring);
+    for (size_t off = 0; off < envelope.size(); off += kFeedChunk) {
+        decoder.feed(envelope.data() + off, std::min(kFeedChunk, envelope.size() - off));
+    }
+    return decoder.finish();
 }
@@ -0,0 +1,98 @@
+#include "event_writer.hpp"
+#include "log_record.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+
+EventWriter::EventWriter(int fd) : fd_(fd) {
+    buffer_.reserve(kFlushBytes + (kFlushBytes >> 2));
+}
+
+EventWriter::~EventWriter() {
+    try {
+        flush();
+    } catch (const std::exception&) {
+    }
+}
+
+std::string& EventWriter::beginRecord(std::string_view cid) {
+    if (batchSize_ == kBatch || (batchSize_ && cid != batchCid_)) closeBatch();
+    if (batchSize_++ == 0) {
+        batchCid_.assign(cid);
+        buffer_ += "{\"event\":\"records\",\"cid\":";
+        appendJsonString(buffer_, cid);
+        buffer_ += ",\"records\":[";
+    } else {
+        buffer_ += ',';
+    }
+    ++stats_.records;
+    return buffer_;
+}
+
+void EventWriter::record(const LogRecord& record, std::string_view cid) {
+    appendLogRecordJson(beginRecord(cid), record);
+}
+
+void EventWriter::record(std::string_view json, std::string_view cid) {
+    beginRecord(cid) += json;
+}
+
+void EventWriter::closeBatch() {
+    if (batchSize_ == 0) return;
+    batchSize_ = 0;
+    buffer_ += "]}";
+    endLine();
+}
+
+void EventWriter::event(std::string_view name, std::string_view fields) {
+    closeBatch();
+    buffer_ += "{\"event\":";
+    appendJsonString(buffer_, name);
+    if (!fields.empty()) {
+        buffer_ += ',';
+        buffer_ += fields;
+    }
+    buffer_ += '}';
+    endLine();
+}
+
+// Drops CSI sequences such as the colours termcolor writes to a terminal
+void EventWriter::text(std::string_view name, std::string_view text) {
+    std::string plain;
+    plain.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\x1b' && i + 1 < text.size() && text[i + 1] == '[') {
+            i += 2;
+            while (i < text.size() && !(text[i] >= '@' && text[i] <= '~')) ++i;
+            continue;
+        }
+        plain += text[i];
+    }
+    std::string fields = "\"text\":";
+    appendJsonString(fields, plain);
+    event(name, fields);
+}
+
+void EventWriter::endLine() {
+    buffer_ += '\n';
+    ++stats_.events;
+    if (buffer_.size() >= kFlushBytes) flush();
+}
+
+void EventWriter::flush() {
+    closeBatch();
+    size_t done = 0;
+    while (done < buffer_.size()) {
+        ssize_t n = ::write(fd_, buffer_.data() + done, buffer_.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            buffer_.clear();
+            throw std::runtime_error(std::string("write: ") + std::strerror(errno));
+        }
+        done += static_cast<size_t>(n);
+        ++stats_.writes;
+    }
+    stats_.bytes += done;
+    buffer_.clear();
+}
@@ -1,32 +1,53 @@
 #include "fetcher.hpp"
-#include <curl/curl.h>
-#include <stdexcept>
+#include "block_cache.hpp"
+#include "config.hpp"
+#include "gateway_pool.hpp"
+#include <memory>
+#include <vector>
 
+std::string fetchFromIPFS(const std::string& cid) {
+    return GatewayPool::instance().fetch(cid);
+}
 
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
-    size_t total = size * nmemb;
-    output->append((char*)contents, total);
-    return total;
+static BlockCache& blockCache() {
+    static BlockCache cache(Config::cache.cache_dir + "/blocks", static_cast<uint64_t>(Config::cache.max_size));
+    return cache;
 }
 
-std::string fetchFromIPFS(const std::string& cid) {
-    CURL* curl = curl_easy_init();
-    std::string response;
-    std::string url = "https://ipfs.io/ipfs/" + cid;
+BlockPayload fetchAndDecrypt(const std::string& cid, Keyring& keyring) {
+    if (auto mapped = blockCache().get(cid)) {
+        return decryptBlock(mapped->view(), keyring);
+    }
 
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        CURLcode res = curl_easy_perform(curl);
-        if (res != CURLE_OK) {
-            curl_easy_cleanup(curl);
-            throw std::runtime_error("Failed to fetch from IPFS");
+    // One decoder per gateway attempt, all fed on this thread. A decoder
+    // error propagates out of fetchStream as is: every gateway serves the
+    // same bytes for a CID, so there is nothing to retry.
+    struct Attempt {
+        explicit Attempt(Keyring& keyring) : decoder(keyring) {}
+        EnvelopeDecoder decoder;
+        std::unique_ptr<BlockCache::Writer> cache;
+    };
+    std::vector<std::unique_ptr<Attempt>> attempts;
+
+    size_t winner = GatewayPool::instance().fetchStream(cid, [&](size_t) {
+        auto attempt = std::make_unique<Attempt>(keyring);
+        attempt->cache = blockCache().writer(cid);
+        Attempt* feeding = attempt.get();
+        attempts.push_back(std::move(attempt));
+        return [feeding](const char* data, size_t len) {
+            feeding->decoder.feed(data, len);
+            if (feeding->cache) feeding->cache->write(data, len);
+        };
+    });
+
+    Attempt& won = *attempts[winner];
+    BlockPayload payload = won.decoder.finish();
+    if (won.cache) {
+        try {
+            won.cache->commit();
+        } catch (const std::exception&) {
+            // A full or read-only cache directory must not fail the fetch
         }
-        curl_easy_cleanup(curl);
-    } else {
-        throw std::runtime_error("CURL init failed");
     }
-
-    return response;
+    return payload;
 }
@@ -0,0 +1,276 @@
+#include "gateway_pool.hpp"
+#include "config.hpp"
+#include "http_client.hpp"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+constexpr double kLatencyAlpha = 0.2;
+constexpr double kErrorAlpha = 0.2;
+constexpr double kErrorPenaltyMs = 5000.0;      // cost of a 100% error rate in the ranking
+constexpr double kErrorHalfLifeSec = 60.0;      // lets a failed gateway back into rotation
+constexpr std::chrono::milliseconds kDefaultHedgeDelay{500};
+constexpr std::chrono::milliseconds kMinHedgeDelay{10};
+constexpr size_t kMinSamplesForP95 = 8;
+
+std::string trimSlash(std::string url) {
+    while (!url.empty() && url.back() == '/') url.pop_back();
+    return url;
+}
+
+} // namespace
+
+GatewayPool::GatewayPool(std::vector<std::string> baseUrls, bool hedging, int maxAttempts)
+    : hedging_(hedging), maxAttempts_(std::max(1, maxAttempts)) {
+    for (auto& url : baseUrls) {
+        if (url.empty()) continue;
+        Gateway g;
+        g.url = trimSlash(std::move(url));
+        gateways_.push_back(std::move(g));
+    }
+    if (gateways_.empty()) throw std::runtime_error("No IPFS gateways configured");
+}
+
+GatewayPool& GatewayPool::instance() {
+    static GatewayPool pool([] {
+        std::vector<std::string> urls{Config::ipfs.gateway_url};
+        for (const auto& url : Config::ipfs.public_gateways) {
+            if (url != Config::ipfs.gateway_url) urls.push_back(url);
+        }
+        return urls;
+    }(), Config::ipfs.enable_hedged_requests, Config::ipfs.max_retries + 1);
+    return pool;
+}
+
+double GatewayPool::p95Locked(const Gateway& g) const {
+    size_t n = std::min(g.recentCount, kWindow);
+    if (n == 0) return 0;
+    std::vector<double> samples(g.recent, g.recent + n);
+    size_t k = std::min(n - 1, static_cast<size_t>(std::ceil(0.95 * n)) - 1);
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+std::vector<size_t> GatewayPool::ranking() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<size_t> order(gateways_.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    // Untried gateways score 0 and keep their configured order, so the
+    // local node is tried first until it proves slow or unreliable
+    auto now = std::chrono::steady_clock::now();
+    std::vector<double> score(gateways_.size());
+    for (size_t i = 0; i < gateways_.size(); ++i) {
+        const Gateway& g = gateways_[i];
+        double idle = std::chrono::duration<double>(now - g.lastFailure).count();
+        double errorRate = g.errorRate * std::exp2(-idle / kErrorHalfLifeSec);
+        score[i] = g.ewmaMs + errorRate * kErrorPenaltyMs;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return score[a] < score[b]; });
+    return order;
+}
+
+std::chrono::milliseconds GatewayPool::hedgeDelay(size_t gateway) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Gateway& g = gateways_[gateway];
+    if (g.recentCount < kMinSamplesForP95) return kDefaultHedgeDelay;
+    auto p95 = std::chrono::milliseconds(static_cast<long>(p95Locked(g)));
+    return std::max(p95, kMinHedgeDelay);
+}
+
+void GatewayPool::recordSuccess(size_t gateway, double ms, bool hedge) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Gateway& g = gateways_[gateway];
+    g.ewmaMs = g.requests == 0 ? ms : g.ewmaMs + kLatencyAlpha * (ms - g.ewmaMs);
+    g.errorRate *= 1.0 - kErrorAlpha;
+    g.recent[g.recentCount++ % kWindow] = ms;
+    ++g.requests;
+    if (hedge) ++g.hedgesWon;
+}
+
+void GatewayPool::recordFailure(size_t gateway, double ms, bool error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Gateway& g = gateways_[gateway];
+    // A request cut off at ms took at least that long
+    if (ms > g.ewmaMs) g.ewmaMs += kLatencyAlpha * (ms - g.ewmaMs);
+    ++g.requests;
+    if (error) {
+        g.errorRate += kErrorAlpha * (1.0 - g.errorRate);
+        g.lastFailure = std::chrono::steady_clock::now();
+        ++g.failures;
+    }
+}
+
+std::string GatewayPool::fetch(const std::string& cid) {
+    std::vector<std::string> bodies;
+    size_t winner = fetchStream(cid, [&](size_t slot) {
+        bodies.emplace_back();
+        return [&bodies, slot](const char* data, size_t len) { bodies[slot].append(data, len); };
+    });
+    return std::move(bodies[winner]);
+}
+
+size_t GatewayPool::fetchStream(const std::string& cid, const std::function<Consumer(size_t attempt)>& open) {
+    // Body chunks and completions arrive on the HTTP client thread, possibly
+    // after this call has returned, so the shared state is reference counted.
+    // One queue keeps them in arrival order, so an attempt's body has been
+    // consumed by the time its completion is seen.
+    struct Event {
+        size_t slot;
+        bool finished;
+        std::string data;
+        HttpResponse response;
+    };
+    struct Window {
+        size_t queued = 0;
+        bool paused = false;
+    };
+    struct Race {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<Event> events;
+        std::vector<Window> windows;
+    };
+    struct Attempt {
+        size_t gateway;
+        uint64_t id;
+        std::chrono::steady_clock::time_point started;
+        bool hedge;
+        bool finished;
+        Consumer consume;
+    };
+
+    auto race = std::make_shared<Race>();
+    std::vector<size_t> order = ranking();
+    size_t allowed = std::min(order.size(), static_cast<size_t>(maxAttempts_));
+    std::vector<Attempt> attempts;
+    size_t next = 0;
+    size_t inFlight = 0;
+    std::chrono::steady_clock::time_point hedgeAt;
+    std::string lastError;
+
+    auto launch = [&](bool hedge) {
+        size_t gateway = order[next++];
+        size_t slot = attempts.size();
+        HttpRequest request;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            request.url = gateways_[gateway].url + "/ipfs/" + cid;
+        }
+        {
+            std::lock_guard<std::mutex> lock(race->mutex);
+            race->windows.emplace_back();
+        }
+        request.onData = [race, slot](const char* data, size_t len) {
+            std::lock_guard<std::mutex> lock(race->mutex);
+            Window& window = race->windows[slot];
+            if (window.queued > 0 && window.queued + len > kStreamWindow) {
+                window.paused = true;
+                return DataAction::Pause;
+            }
+            window.queued += len;
+            race->events.push_back({slot, false, std::string(data, len), {}});
+            race->cv.notify_all();
+            return DataAction::Accept;
+        };
+        attempts.push_back({gateway, 0, std::chrono::steady_clock::now(), hedge, false, open(slot)});
+        attempts[slot].id = HttpClient::instance().submit(std::move(request), [race, slot](HttpResponse response) {
+            std::lock_guard<std::mutex> lock(race->mutex);
+            race->events.push_back({slot, true, {}, std::move(response)});
+            race->cv.notify_all();
+        });
+        ++inFlight;
+        hedgeAt = std::chrono::steady_clock::now() + hedgeDelay(gateway);
+    };
+
+    auto cancelRest = [&] {
+        for (auto& other : attempts) {
+            if (!other.finished) HttpClient::instance().cancel(other.id);
+        }
+    };
+
+    launch(false);
+    while (true) {
+        std::unique_lock<std::mutex> lock(race->mutex);
+        bool canHedge = hedging_ && inFlight == 1 && next < allowed;
+        auto ready = [&] { return !race->events.empty(); };
+        if (canHedge) {
+            race->cv.wait_until(lock, hedgeAt, ready);
+        } else {
+            race->cv.wait(lock, ready);
+        }
+        if (race->events.empty()) {
+            // Primary is past its p95: race it against the next best gateway
+            lock.unlock();
+            launch(true);
+            continue;
+        }
+        Event event = std::move(race->events.front());
+        race->events.pop_front();
+        lock.unlock();
+
+        size_t slot = event.slot;
+        Attempt& attempt = attempts[slot];
+
+        if (!event.finished) {
+            try {
+                attempt.consume(event.data.data(), event.data.size());
+            } catch (...) {
+                cancelRest();
+                throw;
+            }
+            bool resume;
+            {
+                std::lock_guard<std::mutex> guard(race->mutex);
+                Window& window = race->windows[slot];
+                window.queued -= event.data.size();
+                resume = window.paused && window.queued <= kStreamWindow / 2;
+                if (resume) window.paused = false;
+            }
+            if (resume) HttpClient::instance().resume(attempt.id);
+            continue;
+        }
+
+        HttpResponse& response = event.response;
+        attempt.finished = true;
+        --inFlight;
+        double ms = response.elapsed.count() / 1000.0;
+
+        if (response.ok) {
+            recordSuccess(attempt.gateway, ms, attempt.hedge);
+            auto now = std::chrono::steady_clock::now();
+            for (auto& other : attempts) {
+                if (other.finished) continue;
+                HttpClient::instance().cancel(other.id);
+                recordFailure(other.gateway,
+                              std::chrono::duration<double, std::milli>(now - other.started).count(), false);
+            }
+            return slot;
+        }
+
+        recordFailure(attempt.gateway, ms, true);
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            lastError = gateways_[attempt.gateway].url + ": " + response.error;
+        }
+        if (inFlight == 0) {
+            if (next >= allowed) {
+                throw std::runtime_error("Failed to fetch " + cid + " from IPFS (" + lastError + ")");
+            }
+            launch(false);
+        }
+    }
+}
+
+std::vector<GatewayPool::Stats> GatewayPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Stats> out;
+    for (const auto& g : gateways_) {
+        out.push_back({g.url, g.ewmaMs, p95Locked(g), g.errorRate, g.requests, g.failures, g.hedgesWon});
+    }
+    return out;
+}
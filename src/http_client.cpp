@@ -0,0 +1,277 @@
+#include "http_client.hpp"
+#include "config.hpp"
+#include <curl/curl.h>
+#include <future>
+#include <stdexcept>
+
+struct HttpClient::Transfer {
+    Transfer(HttpRequest request, Callback done) : request(std::move(request)), done(std::move(done)) {}
+
+    uint64_t id = 0;
+    HttpRequest request;
+    Callback done;
+    CURL* easy = nullptr;
+    HttpResponse response;
+    std::chrono::steady_clock::time_point started;
+};
+
+HttpClient::HttpClient(bool pooling, size_t poolSize, std::chrono::milliseconds timeout,
+                       std::chrono::milliseconds connectTimeout)
+    : pooling_(pooling), poolSize_(poolSize ? poolSize : 1), timeout_(timeout), connectTimeout_(connectTimeout) {
+    static std::once_flag curlInit;
+    std::call_once(curlInit, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+    multi_ = curl_multi_init();
+    if (!multi_) throw std::runtime_error("CURL multi init failed");
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(poolSize_));
+    curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, static_cast<long>(pooling_ ? poolSize_ : 0));
+
+    if (pooling_) {
+        share_ = curl_share_init();
+        curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &HttpClient::lockShare);
+        curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &HttpClient::unlockShare);
+        curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+
+    thread_ = std::thread(&HttpClient::loop, this);
+}
+
+HttpClient::~HttpClient() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    curl_multi_wakeup(multi_);
+    thread_.join();
+
+    for (CURL* easy : idle_) curl_easy_cleanup(easy);
+    curl_multi_cleanup(multi_);
+    if (share_) curl_share_cleanup(share_);
+}
+
+HttpClient& HttpClient::instance() {
+    static HttpClient client(Config::performance.enable_connection_pooling,
+                             static_cast<size_t>(Config::performance.pool_size),
+                             std::chrono::seconds(Config::ipfs.timeout),
+                             std::chrono::seconds(Config::network.connection_timeout));
+    return client;
+}
+
+void HttpClient::lockShare(CURL*, int data, int, void* self) {
+    static_cast<HttpClient*>(self)->shareMutexes_[data % 8].lock();
+}
+
+void HttpClient::unlockShare(CURL*, int data, void* self) {
+    static_cast<HttpClient*>(self)->shareMutexes_[data % 8].unlock();
+}
+
+size_t HttpClient::onWrite(char* data, size_t size, size_t nmemb, void* userdata) {
+    auto* transfer = static_cast<Transfer*>(userdata);
+    size_t total = size * nmemb;
+    if (transfer->request.onData) {
+        switch (transfer->request.onData(data, total)) {
+        case DataAction::Accept: return total;
+        case DataAction::Pause: return CURL_WRITEFUNC_PAUSE;
+        case DataAction::Abort: return 0;
+        }
+        return 0;
+    }
+    transfer->response.body.append(data, total);
+    return total;
+}
+
+uint64_t HttpClient::submit(HttpRequest request, Callback done) {
+    auto* transfer = new Transfer(std::move(request), std::move(done));
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            delete transfer;
+            throw std::runtime_error("HTTP client is shutting down");
+        }
+        id = transfer->id = nextId_++;
+        pending_.push_back(transfer);
+    }
+    // The transfer may already be finished and freed by the loop thread
+    curl_multi_wakeup(multi_);
+    return id;
+}
+
+void HttpClient::cancel(uint64_t id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_.insert(id);
+    }
+    curl_multi_wakeup(multi_);
+}
+
+void HttpClient::resume(uint64_t id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        resumed_.insert(id);
+    }
+    curl_multi_wakeup(multi_);
+}
+
+HttpResponse HttpClient::perform(HttpRequest request) {
+    std::promise<HttpResponse> promise;
+    auto result = promise.get_future();
+    submit(std::move(request), [&promise](HttpResponse response) { promise.set_value(std::move(response)); });
+    return result.get();
+}
+
+CURL* HttpClient::acquireHandle() {
+    if (pooling_ && !idle_.empty()) {
+        CURL* easy = idle_.back();
+        idle_.pop_back();
+        // Options are cleared but live connections, DNS and TLS state stay
+        curl_easy_reset(easy);
+        return easy;
+    }
+    CURL* easy = curl_easy_init();
+    if (!easy) throw std::runtime_error("CURL init failed");
+    return easy;
+}
+
+void HttpClient::releaseHandle(CURL* easy) {
+    if (pooling_ && idle_.size() < poolSize_) {
+        idle_.push_back(easy);
+    } else {
+        curl_easy_cleanup(easy);
+    }
+}
+
+void HttpClient::start(Transfer* transfer) {
+    CURL* easy;
+    try {
+        easy = acquireHandle();
+    } catch (const std::exception& e) {
+        HttpResponse response;
+        response.error = e.what();
+        finish(transfer, std::move(response));
+        return;
+    }
+    transfer->easy = easy;
+    transfer->started = std::chrono::steady_clock::now();
+
+    auto timeout = transfer->request.timeout.count() > 0 ? transfer->request.timeout : timeout_;
+
+    curl_easy_setopt(easy, CURLOPT_URL, transfer->request.url.c_str());
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &HttpClient::onWrite);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, transfer);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer);
+    // Error pages must never be mistaken for (and cached as) a block
+    curl_easy_setopt(easy, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, static_cast<long>(timeout.count()));
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(connectTimeout_.count()));
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    if (transfer->request.post) {
+        curl_easy_setopt(easy, CURLOPT_POST, 1L);
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, 0L);
+    }
+    if (pooling_) {
+        curl_easy_setopt(easy, CURLOPT_SHARE, share_);
+        // Over TLS, prefer waiting for a multiplexable HTTP/2 connection to
+        // opening another. Plain http stays HTTP/1.1, where waiting only
+        // serialises requests.
+        if (transfer->request.url.rfind("https://", 0) == 0) {
+            curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+        }
+    } else {
+        curl_easy_setopt(easy, CURLOPT_FRESH_CONNECT, 1L);
+        curl_easy_setopt(easy, CURLOPT_FORBID_REUSE, 1L);
+    }
+
+    active_[transfer->id] = transfer;
+    curl_multi_add_handle(multi_, easy);
+}
+
+void HttpClient::finish(Transfer* transfer, HttpResponse response) {
+    if (transfer->easy) {
+        curl_multi_remove_handle(multi_, transfer->easy);
+        releaseHandle(transfer->easy);
+        active_.erase(transfer->id);
+        response.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - transfer->started);
+    }
+    if (!transfer->request.onData) {
+        response.body = std::move(transfer->response.body);
+    }
+    Callback done = std::move(transfer->done);
+    delete transfer;
+    if (done) done(std::move(response));
+}
+
+void HttpClient::loop() {
+    while (true) {
+        std::vector<Transfer*> starting;
+        std::unordered_set<uint64_t> cancelling;
+        std::unordered_set<uint64_t> resuming;
+        bool stopping;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            starting.swap(pending_);
+            cancelling.swap(cancelled_);
+            resuming.swap(resumed_);
+            stopping = stopping_;
+        }
+
+        for (Transfer* transfer : starting) {
+            if (stopping || cancelling.count(transfer->id)) {
+                HttpResponse response;
+                response.error = "cancelled";
+                finish(transfer, std::move(response));
+            } else {
+                start(transfer);
+            }
+        }
+        for (uint64_t id : cancelling) {
+            auto it = active_.find(id);
+            if (it == active_.end()) continue;
+            HttpResponse response;
+            response.error = "cancelled";
+            finish(it->second, std::move(response));
+        }
+        for (uint64_t id : resuming) {
+            // Finished and cancelled transfers are gone from active_ by now
+            auto it = active_.find(id);
+            if (it == active_.end()) continue;
+            curl_easy_pause(it->second->easy, CURLPAUSE_CONT);
+        }
+        if (stopping) {
+            while (!active_.empty()) {
+                HttpResponse response;
+                response.error = "cancelled";
+                finish(active_.begin()->second, std::move(response));
+            }
+            return;
+        }
+
+        int running = 0;
+        curl_multi_perform(multi_, &running);
+
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi_, &queued)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            Transfer* transfer = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&transfer));
+
+            HttpResponse response;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &response.status);
+            response.ok = msg->data.result == CURLE_OK;
+            if (!response.ok) {
+                response.error = curl_easy_strerror(msg->data.result);
+                if (response.status) response.error += " (HTTP " + std::to_string(response.status) + ")";
+            }
+            finish(transfer, std::move(response));
+        }
+
+        curl_multi_poll(multi_, nullptr, 0, 1000, nullptr);
+    }
+}
@@ -0,0 +1,157 @@
+#include "ipns_resolver.hpp"
+#include "config.hpp"
+#include "http_client.hpp"
+#include "json.hpp"
+#include <cctype>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Entries are refreshed once this fraction of the TTL has passed, so a
+// reader normally never sees an expired one
+constexpr double kRefreshAt = 0.8;
+// Names nobody asked for in this many TTLs stop being refreshed
+constexpr int kIdleTTLs = 4;
+
+std::string trimSlash(std::string url) {
+    while (!url.empty() && url.back() == '/') url.pop_back();
+    return url;
+}
+
+std::string urlEncode(const std::string& value) {
+    static const char digits[] = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : value) {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~' || c == '/') {
+            out += static_cast<char>(c);
+        } else {
+            out += '%';
+            out += digits[c >> 4];
+            out += digits[c & 0x0f];
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+IPNSResolver::IPNSResolver(std::string apiUrl, std::chrono::seconds ttl)
+    : apiUrl_(trimSlash(std::move(apiUrl))), ttl_(ttl) {
+    // Construct the shared client first so it outlives the refresher thread
+    HttpClient::instance();
+    refresher_ = std::thread(&IPNSResolver::refreshLoop, this);
+}
+
+IPNSResolver::~IPNSResolver() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    refresher_.join();
+}
+
+IPNSResolver& IPNSResolver::instance() {
+    static IPNSResolver resolver(Config::ipfs.api_url, std::chrono::seconds(Config::ipfs.ipns_cache_ttl));
+    return resolver;
+}
+
+std::string IPNSResolver::query(const std::string& name) const {
+    HttpRequest request;
+    request.url = apiUrl_ + "/api/v0/name/resolve?arg=" + urlEncode("/ipns/" + name) + "&nocache=true";
+    request.post = true;
+
+    HttpResponse response = HttpClient::instance().perform(std::move(request));
+    if (!response.ok) {
+        throw std::runtime_error("IPNS resolve failed: " + response.error);
+    }
+
+    auto j = nlohmann::json::parse(response.body, nullptr, false);
+    if (j.is_discarded() || !j.contains("Path") || !j["Path"].is_string()) {
+        throw std::runtime_error("Could not parse IPNS resolve output");
+    }
+    std::string path = j["Path"];
+    const std::string prefix = "/ipfs/";
+    if (path.rfind(prefix, 0) != 0 || path.size() == prefix.size()) {
+        throw std::runtime_error("Could not parse IPNS resolve output");
+    }
+    return path.substr(prefix.size());
+}
+
+void IPNSResolver::store(const std::string& name, const std::string& cid) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[name];
+    bool fresh = entry.cid.empty();
+    entry.cid = cid;
+    entry.resolved = now;
+    entry.lastUsed = now;
+    if (fresh) wake_.notify_all();
+}
+
+std::string IPNSResolver::resolve(const std::string& name) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(name);
+        if (it != entries_.end()) {
+            auto now = std::chrono::steady_clock::now();
+            it->second.lastUsed = now;
+            if (now - it->second.resolved < ttl_) return it->second.cid;
+        }
+    }
+    return resolveFresh(name);
+}
+
+std::string IPNSResolver::resolveFresh(const std::string& name) {
+    std::string cid = query(name);
+    store(name, cid);
+    return cid;
+}
+
+void IPNSResolver::refreshLoop() {
+    auto refreshAfter = std::chrono::duration_cast<std::chrono::steady_clock::duration>(ttl_ * kRefreshAt);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        auto now = std::chrono::steady_clock::now();
+        auto nextWake = now + ttl_;
+        std::vector<std::string> due;
+
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (now - it->second.lastUsed > ttl_ * kIdleTTLs) {
+                it = entries_.erase(it);
+                continue;
+            }
+            auto dueAt = it->second.resolved + refreshAfter;
+            if (dueAt <= now) {
+                due.push_back(it->first);
+            } else if (dueAt < nextWake) {
+                nextWake = dueAt;
+            }
+            ++it;
+        }
+
+        if (!due.empty()) {
+            lock.unlock();
+            for (const auto& name : due) {
+                try {
+                    std::string cid = query(name);
+                    std::lock_guard<std::mutex> guard(mutex_);
+                    auto it = entries_.find(name);
+                    if (it != entries_.end()) {
+                        it->second.cid = cid;
+                        it->second.resolved = std::chrono::steady_clock::now();
+                    }
+                } catch (const std::exception&) {
+                    // Keep serving the old answer until it expires; readers
+                    // then retry synchronously and surface the error
+                }
+            }
+            lock.lock();
+            // Failed refreshes are retried after a short pause, not in a spin
+            nextWake = std::min(nextWake, std::chrono::steady_clock::now() + std::chrono::seconds(1));
+        }
+
+        wake_.wait_until(lock, nextWake);
+    }
+}
@@ -0,0 +1,86 @@
+#include "json_scan.hpp"
+#include <cstring>
+
+namespace {
+
+// Length of the sequence a lead byte announces; 1 for ASCII and for bytes
+// that cannot start one, which the full check rejects anyway
+size_t announcedLength(unsigned char lead) {
+    return lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+}
+
+} // namespace
+
+size_t utf8SequenceLength(const char* p, const char* end) {
+    auto byte = [&](size_t i) { return static_cast<unsigned char>(p[i]); };
+    unsigned char c = byte(0);
+    size_t length;
+    unsigned char low = 0x80, high = 0xBF;     // allowed range of the second byte
+    if (c < 0xC2) {
+        return 0;                               // continuation byte or overlong
+    } else if (c < 0xE0) {
+        length = 2;
+    } else if (c < 0xF0) {
+        length = 3;
+        if (c == 0xE0) low = 0xA0;              // overlong
+        if (c == 0xED) high = 0x9F;             // surrogates
+    } else if (c < 0xF5) {
+        length = 4;
+        if (c == 0xF0) low = 0x90;              // overlong
+        if (c == 0xF4) high = 0x8F;             // above U+10FFFF
+    } else {
+        return 0;
+    }
+    if (static_cast<size_t>(end - p) < length) return 0;
+    if (byte(1) < low || byte(1) > high) return 0;
+    for (size_t i = 2; i < length; ++i) {
+        if ((byte(i) & 0xC0) != 0x80) return 0;
+    }
+    return length;
+}
+
+bool isValidUtf8(std::string_view text) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+#if defined(__SSE2__)
+        while (end - p >= 16 && !_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))) p += 16;
+        if (p == end) break;
+#endif
+        if (static_cast<unsigned char>(*p) < 0x80) {
+            ++p;
+            continue;
+        }
+        size_t length = utf8SequenceLength(p, end);
+        if (!length) return false;
+        p += length;
+    }
+    return true;
+}
+
+bool Utf8Validator::feed(const char* data, size_t len) {
+    if (!ok_) return false;
+    const char* end = data + len;
+    if (carried_) {
+        size_t need = announcedLength(static_cast<unsigned char>(carry_[0]));
+        while (carried_ < need && data < end) carry_[carried_++] = *data++;
+        if (carried_ < need) return true;
+        carried_ = 0;
+        if (!isValidUtf8({carry_, need})) return ok_ = false;
+    }
+
+    // Hold back a sequence that runs past the end of this piece
+    const char* cut = end;
+    for (const char* p = end; p > data && end - p < 3;) {
+        unsigned char c = static_cast<unsigned char>(*--p);
+        if (c < 0x80) break;
+        if (c >= 0xC0) {
+            if (static_cast<size_t>(end - p) < announcedLength(c)) cut = p;
+            break;
+        }
+    }
+    if (!isValidUtf8({data, static_cast<size_t>(cut - data)})) return ok_ = false;
+    carried_ = static_cast<size_t>(end - cut);
+    std::memcpy(carry_, cut, carried_);
+    return true;
+}
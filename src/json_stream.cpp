@@ -0,0 +1,252 @@
+#include "json_stream.hpp"
+#include "json_scan.hpp"
+#include <stdexcept>
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+} // namespace
+
+size_t encodeUtf8(uint32_t cp, char* out) {
+    if (cp < 0x80) {
+        out[0] = static_cast<char>(cp);
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (cp >> 6));
+        out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (cp >> 12));
+        out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (cp >> 18));
+    out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+void JsonStreamScanner::fail(const std::string& what, size_t at) const {
+    throw std::runtime_error("Malformed JSON at byte " + std::to_string(consumed_ + at) + ": " + what);
+}
+
+void JsonStreamScanner::emit(const char* data, size_t len) {
+    if (inKey_) {
+        key_.append(data, len);
+    } else {
+        handler_.stringData(data, len);
+    }
+}
+
+void JsonStreamScanner::endString() {
+    if (inKey_) {
+        inKey_ = false;
+        state_ = State::Colon;
+    } else {
+        handler_.endString();
+        state_ = State::AfterValue;
+    }
+}
+
+void JsonStreamScanner::scanEscape(char c) {
+    if (escape_ == 1) {
+        if (highSurrogate_ && c != 'u') throw std::runtime_error("unpaired surrogate");
+        char out;
+        switch (c) {
+        case '"': out = '"'; break;
+        case '\\': out = '\\'; break;
+        case '/': out = '/'; break;
+        case 'b': out = '\b'; break;
+        case 'f': out = '\f'; break;
+        case 'n': out = '\n'; break;
+        case 'r': out = '\r'; break;
+        case 't': out = '\t'; break;
+        case 'u':
+            escape_ = 2;
+            unicode_ = 0;
+            return;
+        default:
+            throw std::runtime_error("invalid escape");
+        }
+        escape_ = 0;
+        emit(&out, 1);
+        return;
+    }
+
+    int v = hexValue(c);
+    if (v < 0) throw std::runtime_error("invalid \\u escape");
+    unicode_ = (unicode_ << 4) | static_cast<uint32_t>(v);
+    if (++escape_ < 6) return;
+    escape_ = 0;
+
+    uint32_t cp = unicode_;
+    if (highSurrogate_) {
+        if (cp < 0xDC00 || cp > 0xDFFF) throw std::runtime_error("unpaired surrogate");
+        cp = 0x10000 + ((highSurrogate_ - 0xD800) << 10) + (cp - 0xDC00);
+        highSurrogate_ = 0;
+    } else if (cp >= 0xD800 && cp <= 0xDBFF) {
+        highSurrogate_ = cp;
+        return;
+    } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+        throw std::runtime_error("unpaired surrogate");
+    }
+    char utf8[4];
+    emit(utf8, encodeUtf8(cp, utf8));
+}
+
+size_t JsonStreamScanner::scanString(const char* data, size_t i, size_t len) {
+    while (i < len) {
+        if (escape_) {
+            try {
+                scanEscape(data[i]);
+            } catch (const std::runtime_error& e) {
+                fail(e.what(), i);
+            }
+            ++i;
+            continue;
+        }
+        if (highSurrogate_ && data[i] != '\\') fail("unpaired surrogate", i);
+
+        // Plain runs go to the handler without copying
+        size_t start = i;
+        i = findStringSpecial(data + i, data + len) - data;
+        if (i > start) emit(data + start, i - start);
+        if (i == len) break;
+
+        char c = data[i];
+        if (static_cast<unsigned char>(c) < 0x20) fail("control character in string", i);
+        ++i;
+        if (c == '"') {
+            endString();
+            return i;
+        }
+        escape_ = 1;
+    }
+    return i;
+}
+
+void JsonStreamScanner::feed(const char* data, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        char c = data[i];
+
+        if (state_ == State::String) {
+            i = scanString(data, i, len);
+            continue;
+        }
+
+        if (state_ == State::Skip) {
+            if (skipInString_) {
+                if (skipEscape_) {
+                    skipEscape_ = false;
+                } else if (c == '\\') {
+                    skipEscape_ = true;
+                } else if (c == '"') {
+                    skipInString_ = false;
+                }
+            } else if (skipDepth_ == 0) {
+                // Scalar: ends at the next delimiter, which AfterValue handles
+                if (c == ',' || c == '}' || c == ']' || isSpace(c)) {
+                    state_ = State::AfterValue;
+                    continue;
+                }
+            } else if (c == '"') {
+                skipInString_ = true;
+            } else if (c == '{' || c == '[') {
+                ++skipDepth_;
+            } else if (c == '}' || c == ']') {
+                if (--skipDepth_ == 0) state_ = State::AfterValue;
+            }
+            ++i;
+            continue;
+        }
+
+        if (isSpace(c)) {
+            ++i;
+            continue;
+        }
+
+        switch (state_) {
+        case State::Start:
+            if (c != '{') fail("expected '{'", i);
+            state_ = State::KeyOrEnd;
+            break;
+        case State::KeyOrEnd:
+            if (c == '}' && !inArray_) {
+                state_ = State::Done;
+                break;
+            }
+            [[fallthrough]];
+        case State::Key:
+            if (c != '"') fail("expected key", i);
+            key_.clear();
+            inKey_ = true;
+            state_ = State::String;
+            break;
+        case State::Colon:
+            if (c != ':') fail("expected ':'", i);
+            state_ = State::Value;
+            break;
+        case State::ElementOrEnd:
+            if (c == ']') {
+                inArray_ = false;
+                state_ = State::AfterValue;
+                break;
+            }
+            [[fallthrough]];
+        case State::Value:
+            if (c == '"') {
+                handler_.beginString(key_, inArray_);
+                state_ = State::String;
+            } else if (c == '[' && !inArray_) {
+                inArray_ = true;
+                state_ = State::ElementOrEnd;
+            } else if (c == '{' || c == '[') {
+                skipDepth_ = 1;
+                state_ = State::Skip;
+            } else if (c == ',' || c == '}' || c == ']' || c == ':') {
+                fail("expected value", i);
+            } else {
+                skipDepth_ = 0;
+                state_ = State::Skip;
+                continue;
+            }
+            break;
+        case State::AfterValue:
+            if (c == ',') {
+                state_ = inArray_ ? State::Value : State::Key;
+            } else if (c == ']' && inArray_) {
+                inArray_ = false;
+            } else if (c == '}' && !inArray_) {
+                state_ = State::Done;
+            } else {
+                fail("expected ',' or end of container", i);
+            }
+            break;
+        case State::Done:
+            fail("trailing data", i);
+        default:
+            break;
+        }
+        ++i;
+    }
+    consumed_ += len;
+}
+
+void JsonStreamScanner::finish() {
+    if (state_ != State::Done) throw std::runtime_error("Truncated JSON after " + std::to_string(consumed_) + " bytes");
+}
@@ -0,0 +1,409 @@
+#include "jsonl_sink.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t kBufferSize = 1 << 20;     // handed to the writer once this full
+constexpr size_t kMaxQueued = 8;            // producer waits beyond this
+constexpr size_t kMaxIov = 64;
+
+std::string errnoText(const std::string& what, int err) {
+    return what + ": " + std::strerror(err);
+}
+
+// Writes every byte of iov starting at index first, retrying short writes
+void writeFully(int fd, std::vector<iovec>& iov, size_t first = 0) {
+    while (first < iov.size()) {
+        int count = static_cast<int>(std::min(iov.size() - first, kMaxIov));
+        ssize_t n = ::writev(fd, iov.data() + first, count);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) throw std::runtime_error(errnoText("write", errno));
+        size_t left = static_cast<size_t>(n);
+        while (first < iov.size() && left >= iov[first].iov_len) left -= iov[first++].iov_len;
+        if (left > 0) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+        }
+    }
+}
+
+void datasync(int fd) {
+    while (::fdatasync(fd) != 0) {
+        if (errno != EINTR) throw std::runtime_error(errnoText("fdatasync", errno));
+    }
+}
+
+} // namespace
+
+// Either plain syscalls or a minimal io_uring: one writev, optionally
+// linked to an fdatasync, submitted and reaped in a single io_uring_enter.
+// The ring is driven directly through the kernel ABI, so there is no
+// liburing dependency.
+class JsonlSink::Backend {
+public:
+    explicit Backend(bool tryUring) {
+        if (tryUring) setupRing();
+    }
+
+    ~Backend() {
+        if (ringFd_ < 0) return;
+        munmap(sqes_, sqesLen_);
+        if (cqPtr_ != sqPtr_) munmap(cqPtr_, cqLen_);
+        munmap(sqPtr_, sqLen_);
+        close(ringFd_);
+    }
+
+    const char* name() const { return ringFd_ >= 0 ? "io_uring" : "writev"; }
+
+    // Returns the number of syscalls or submissions made
+    unsigned write(int fd, std::vector<iovec>& iov, uint64_t offset, bool sync) {
+        if (ringFd_ < 0 || iov.size() > kMaxIov) {
+            writeFully(fd, iov);
+            if (sync) datasync(fd);
+            return 1;
+        }
+
+        size_t total = 0;
+        for (const auto& v : iov) total += v.iov_len;
+
+        unsigned tail = *sqTail_;
+        unsigned count = 0;
+        auto prep = [&](uint8_t op) {
+            unsigned index = (tail + count) & *sqMask_;
+            io_uring_sqe* sqe = &sqes_[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = op;
+            sqe->fd = fd;
+            sqe->user_data = count;
+            sqArray_[index] = index;
+            ++count;
+            return sqe;
+        };
+        io_uring_sqe* w = prep(IORING_OP_WRITEV);
+        w->addr = reinterpret_cast<uint64_t>(iov.data());
+        w->len = static_cast<uint32_t>(iov.size());
+        w->off = offset;
+        if (sync) {
+            w->flags |= IOSQE_IO_LINK;
+            io_uring_sqe* s = prep(IORING_OP_FSYNC);
+            s->fsync_flags = IORING_FSYNC_DATASYNC;
+        }
+        __atomic_store_n(sqTail_, tail + count, __ATOMIC_RELEASE);
+
+        int submitted;
+        do {
+            submitted = static_cast<int>(syscall(__NR_io_uring_enter, ringFd_, count, count, IORING_ENTER_GETEVENTS,
+                                                 nullptr, 0));
+        } while (submitted < 0 && errno == EINTR);
+        if (submitted < 0) throw std::runtime_error(errnoText("io_uring_enter", errno));
+
+        int64_t written = -1, synced = -1;
+        for (unsigned reaped = 0; reaped < count;) {
+            unsigned head = *cqHead_;
+            if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+                if (syscall(__NR_io_uring_enter, ringFd_, 0, count - reaped, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+                    errno != EINTR) {
+                    throw std::runtime_error(errnoText("io_uring_enter", errno));
+                }
+                continue;
+            }
+            const io_uring_cqe& cqe = cqes_[head & *cqMask_];
+            (cqe.user_data == 0 ? written : synced) = cqe.res;
+            __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+            ++reaped;
+        }
+
+        if (written < 0) throw std::runtime_error(errnoText("write", static_cast<int>(-written)));
+        // A short write cancels the linked sync; finish both the plain way
+        if (static_cast<size_t>(written) < total) {
+            size_t first = 0, left = static_cast<size_t>(written);
+            while (left >= iov[first].iov_len) left -= iov[first++].iov_len;
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+            writeFully(fd, iov, first);
+            if (sync) datasync(fd);
+            return 2;
+        }
+        if (sync && synced < 0) throw std::runtime_error(errnoText("fdatasync", static_cast<int>(-synced)));
+        return 1;
+    }
+
+private:
+    void setupRing() {
+        io_uring_params params{};
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, 4, &params));
+        if (fd < 0) return;     // kernel without io_uring, or disabled by policy
+
+        sqLen_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqLen_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqLen_ = cqLen_ = std::max(sqLen_, cqLen_);
+
+        sqPtr_ = mmap(nullptr, sqLen_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqPtr_ == MAP_FAILED) {
+            close(fd);
+            return;
+        }
+        cqPtr_ = single ? sqPtr_
+                        : mmap(nullptr, cqLen_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                               IORING_OFF_CQ_RING);
+        sqesLen_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = cqPtr_ == MAP_FAILED ? MAP_FAILED
+                                          : mmap(nullptr, sqesLen_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                                 fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            if (cqPtr_ != MAP_FAILED && cqPtr_ != sqPtr_) munmap(cqPtr_, cqLen_);
+            munmap(sqPtr_, sqLen_);
+            close(fd);
+            return;
+        }
+
+        auto* sq = static_cast<char*>(sqPtr_);
+        auto* cq = static_cast<char*>(cqPtr_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+        ringFd_ = fd;
+    }
+
+    int ringFd_ = -1;
+    void* sqPtr_ = nullptr;
+    void* cqPtr_ = nullptr;
+    size_t sqLen_ = 0, cqLen_ = 0, sqesLen_ = 0;
+    unsigned *sqTail_ = nullptr, *sqMask_ = nullptr, *sqArray_ = nullptr;
+    unsigned *cqHead_ = nullptr, *cqTail_ = nullptr, *cqMask_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+JsonlSink::JsonlSink(Options options) : options_(std::move(options)), backend_(std::make_unique<Backend>(options_.ioUring)) {
+    openFile();
+    stats_.backend = backend_->name();
+    current_.reserve(kBufferSize + kBufferSize / 8);
+    writer_ = std::thread(&JsonlSink::writerLoop, this);
+}
+
+JsonlSink::~JsonlSink() {
+    try {
+        flush();
+    } catch (const std::exception&) {
+        // The writer's error has nowhere to go from a destructor
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    writer_.join();
+    if (fd_ >= 0) close(fd_);
+}
+
+std::unique_ptr<JsonlSink> JsonlSink::fromConfig() {
+    return std::make_unique<JsonlSink>(Options{Config::logging.output_file,
+                                               static_cast<uint64_t>(Config::logging.max_log_size),
+                                               Config::logging.max_log_files,
+                                               std::chrono::milliseconds(Config::logging.flush_interval_ms),
+                                               Config::logging.use_io_uring});
+}
+
+void JsonlSink::openFile() {
+    fd_ = ::open(options_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) throw std::runtime_error(errnoText("Cannot open " + options_.path, errno));
+    struct stat st;
+    fileSize_ = fstat(fd_, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+void JsonlSink::rotate() {
+    datasync(fd_);
+    close(fd_);
+    fd_ = -1;
+
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    auto numbered = [&](int i) { return options_.path + "." + std::to_string(i); };
+    if (options_.maxFiles <= 1) {
+        fs::remove(options_.path, ec);
+    } else {
+        fs::remove(numbered(options_.maxFiles - 1), ec);
+        for (int i = options_.maxFiles - 2; i >= 1; --i) {
+            if (fs::exists(numbered(i), ec)) fs::rename(numbered(i), numbered(i + 1), ec);
+        }
+        fs::rename(options_.path, numbered(1), ec);
+        if (ec) throw std::runtime_error("Cannot rotate " + options_.path + ": " + ec.message());
+    }
+    openFile();
+}
+
+void JsonlSink::throwIfFailed() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_.empty()) throw std::runtime_error("Cannot write " + options_.path + ": " + error_);
+}
+
+void JsonlSink::write(const LogRecord& record) {
+    appendLogRecordJson(current_, record);
+    current_ += '\n';
+    ++records_;
+    if (current_.size() >= kBufferSize) handOff();
+}
+
+void JsonlSink::handOff() {
+    if (current_.empty()) return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return queue_.size() < kMaxQueued || !error_.empty(); });
+    if (!error_.empty()) throw std::runtime_error("Cannot write " + options_.path + ": " + error_);
+    queue_.push_back(std::move(current_));
+    ++queuedSeq_;
+    if (!free_.empty()) {
+        current_ = std::move(free_.back());
+        free_.pop_back();
+    } else {
+        current_ = std::string();
+        current_.reserve(kBufferSize + kBufferSize / 8);
+    }
+    lock.unlock();
+    wake_.notify_one();
+}
+
+void JsonlSink::flush() {
+    handOff();
+    throwIfFailed();
+}
+
+void JsonlSink::sync() {
+    handOff();
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t target = queuedSeq_;
+    syncWanted_ = std::max(syncWanted_, target);
+    wake_.notify_one();
+    done_.wait(lock, [&] { return syncedSeq_ >= target || !error_.empty(); });
+    if (!error_.empty()) throw std::runtime_error("Cannot write " + options_.path + ": " + error_);
+}
+
+JsonlSink::Stats JsonlSink::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.records = records_;
+    return stats;
+}
+
+void JsonlSink::writerLoop() {
+    auto lastSync = std::chrono::steady_clock::now();
+    bool dirty = false;
+    std::vector<std::string> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        auto ready = [&] { return stopping_ || !queue_.empty() || syncWanted_ > syncedSeq_; };
+        if (dirty) {
+            wake_.wait_until(lock, lastSync + options_.flushInterval, ready);
+        } else {
+            wake_.wait(lock, ready);
+        }
+
+        uint64_t seq = queuedSeq_;
+        bool stopping = stopping_;
+        bool syncRequested = syncWanted_ > syncedSeq_;
+        while (!queue_.empty()) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        lock.unlock();
+
+        auto now = std::chrono::steady_clock::now();
+        bool syncDue = stopping || syncRequested || now - lastSync >= options_.flushInterval;
+        std::string error;
+        bool syncedAlone = false;
+        try {
+            if (!batch.empty()) {
+                writeBatch(batch, syncDue);
+                dirty = !syncDue;
+            } else if (syncDue && dirty) {
+                datasync(fd_);
+                dirty = false;
+                syncedAlone = true;
+            }
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (syncDue && !dirty) lastSync = now;
+
+        lock.lock();
+        if (!error.empty() && error_.empty()) error_ = error;
+        if (syncedAlone) ++stats_.syncs;
+        if (!dirty) syncedSeq_ = std::max(syncedSeq_, seq);
+        for (auto& buffer : batch) {
+            buffer.clear();
+            if (free_.size() < kMaxQueued) free_.push_back(std::move(buffer));
+        }
+        batch.clear();
+        done_.notify_all();
+        if (stopping && queue_.empty()) break;
+    }
+}
+
+void JsonlSink::writeBatch(std::vector<std::string>& batch, bool syncAfter) {
+    std::vector<iovec> iov;
+    uint64_t pending = 0;   // bytes in iov
+    uint64_t bytes = 0, writes = 0, rotations = 0;
+
+    auto submit = [&](bool sync) {
+        if (iov.empty()) return;
+        writes += backend_->write(fd_, iov, fileSize_, sync);
+        fileSize_ += pending;
+        bytes += pending;
+        iov.clear();
+        pending = 0;
+    };
+
+    for (const auto& buffer : batch) {
+        const char* data = buffer.data();
+        size_t left = buffer.size();
+        while (left > 0) {
+            uint64_t room = fileSize_ + pending < options_.maxFileSize ? options_.maxFileSize - fileSize_ - pending : 0;
+            size_t piece = left;
+            if (left > room) {
+                // Cut after the last whole record that still fits
+                const void* nl = room ? memrchr(data, '\n', room) : nullptr;
+                if (nl) {
+                    piece = static_cast<const char*>(nl) - data + 1;
+                } else if (fileSize_ + pending == 0) {
+                    // A single record larger than the limit gets a file of its own
+                    piece = static_cast<const char*>(std::memchr(data, '\n', left)) - data + 1;
+                } else {
+                    submit(false);
+                    rotate();
+                    ++rotations;
+                    continue;
+                }
+            }
+            iov.push_back({const_cast<char*>(data), piece});
+            pending += piece;
+            data += piece;
+            left -= piece;
+            if (iov.size() == kMaxIov) submit(false);
+        }
+    }
+    submit(syncAfter);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.bytes += bytes;
+    stats_.writes += writes;
+    stats_.rotations += rotations;
+    if (syncAfter) ++stats_.syncs;
+}
@@ -0,0 +1,167 @@
+#include "keyring.hpp"
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+
+namespace {
+
+std::atomic<uint64_t> nextKeySerial{1};
+
+// Decrypt contexts owned by the calling thread, keyed by Key::serial.
+// Each context holds a reference on its EVP_PKEY, so it stays valid even
+// if the keyring that created it goes away first.
+struct ThreadContexts {
+    std::unordered_map<uint64_t, EVP_PKEY_CTX*> byKey;
+
+    ~ThreadContexts() {
+        for (auto& [serial, ctx] : byKey) EVP_PKEY_CTX_free(ctx);
+    }
+};
+
+EVP_PKEY_CTX* threadContext(uint64_t serial, EVP_PKEY* pkey) {
+    thread_local ThreadContexts contexts;
+    auto it = contexts.byKey.find(serial);
+    if (it != contexts.byKey.end()) return it->second;
+
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new(pkey, nullptr);
+    if (!ctx) throw std::runtime_error("Failed to create RSA context");
+    if (EVP_PKEY_decrypt_init(ctx) <= 0 ||
+        EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_OAEP_PADDING) <= 0) {
+        EVP_PKEY_CTX_free(ctx);
+        throw std::runtime_error("Failed to initialise RSA context");
+    }
+    contexts.byKey.emplace(serial, ctx);
+    return ctx;
+}
+
+std::string toHex(const unsigned char* data, size_t len) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(len * 2);
+    for (size_t i = 0; i < len; ++i) {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 0x0f];
+    }
+    return out;
+}
+
+std::string keyIdOf(EVP_PKEY* pkey) {
+    unsigned char* der = nullptr;
+    int len = i2d_PUBKEY(pkey, &der);
+    if (len <= 0) throw std::runtime_error("Failed to encode public key");
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(der, len, digest);
+    OPENSSL_free(der);
+    return toHex(digest, 8);
+}
+
+} // namespace
+
+Keyring::Keyring(size_t sessionCacheSize) : sessionCacheSize_(sessionCacheSize) {}
+
+Keyring::~Keyring() {
+    for (auto& key : keys_) EVP_PKEY_free(key.pkey);
+}
+
+std::string Keyring::addKeyFile(const std::string& pemPath) {
+    FILE* fp = fopen(pemPath.c_str(), "r");
+    if (!fp) throw std::runtime_error("Cannot open private key file: " + pemPath);
+
+    EVP_PKEY* pkey = PEM_read_PrivateKey(fp, nullptr, nullptr, nullptr);
+    fclose(fp);
+    if (!pkey) throw std::runtime_error("Failed to read RSA key: " + pemPath);
+    if (EVP_PKEY_base_id(pkey) != EVP_PKEY_RSA) {
+        EVP_PKEY_free(pkey);
+        throw std::runtime_error("Not an RSA key: " + pemPath);
+    }
+
+    std::string id;
+    try {
+        id = keyIdOf(pkey);
+    } catch (...) {
+        EVP_PKEY_free(pkey);
+        throw;
+    }
+    keys_.push_back({nextKeySerial++, id, pkey});
+    return id;
+}
+
+size_t Keyring::loadKeyFiles(const std::vector<std::string>& paths) {
+    size_t added = 0;
+    for (const auto& path : paths) {
+        if (!std::filesystem::exists(path)) continue;
+        addKeyFile(path);
+        ++added;
+    }
+    return added;
+}
+
+bool Keyring::tryUnwrap(const Key& key, const std::vector<unsigned char>& wrapped, std::vector<unsigned char>& out) const {
+    EVP_PKEY_CTX* ctx = threadContext(key.serial, key.pkey);
+    size_t len = 0;
+    if (EVP_PKEY_decrypt(ctx, nullptr, &len, wrapped.data(), wrapped.size()) <= 0) return false;
+    out.resize(len);
+    if (EVP_PKEY_decrypt(ctx, out.data(), &len, wrapped.data(), wrapped.size()) <= 0) return false;
+    out.resize(len);
+    return true;
+}
+
+std::vector<unsigned char> Keyring::unwrap(const std::vector<unsigned char>& wrapped, std::string_view keyId) {
+    if (keys_.empty()) throw std::runtime_error("No private keys loaded");
+
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(wrapped.data(), wrapped.size(), digest);
+    std::string cacheKey(reinterpret_cast<const char*>(digest), sizeof(digest));
+    {
+        std::lock_guard<std::mutex> lock(sessionMutex_);
+        auto it = sessionKeys_.find(cacheKey);
+        if (it != sessionKeys_.end()) {
+            ++hits_;
+            return it->second;
+        }
+        ++misses_;
+    }
+
+    std::vector<unsigned char> aesKey;
+    bool ok = false;
+    for (const auto& key : keys_) {
+        if (!keyId.empty() && key.id != keyId) continue;
+        if ((ok = tryUnwrap(key, wrapped, aesKey))) break;
+    }
+    if (!ok && !keyId.empty()) {
+        // Unknown or mislabelled key id: fall back to trying every key
+        for (const auto& key : keys_) {
+            if (key.id == keyId) continue;
+            if ((ok = tryUnwrap(key, wrapped, aesKey))) break;
+        }
+    }
+    if (!ok) throw std::runtime_error("RSA decryption failed");
+
+    if (sessionCacheSize_ > 0) {
+        std::lock_guard<std::mutex> lock(sessionMutex_);
+        if (sessionKeys_.emplace(cacheKey, aesKey).second) {
+            sessionOrder_.push_back(cacheKey);
+            if (sessionOrder_.size() > sessionCacheSize_) {
+                sessionKeys_.erase(sessionOrder_.front());
+                sessionOrder_.pop_front();
+            }
+        }
+    }
+    return aesKey;
+}
+
+uint64_t Keyring::sessionCacheHits() const {
+    std::lock_guard<std::mutex> lock(sessionMutex_);
+    return hits_;
+}
+
+uint64_t Keyring::sessionCacheMisses() const {
+    std::lock_guard<std::mutex> lock(sessionMutex_);
+    return misses_;
+}
@@ -0,0 +1,122 @@
+#include "log_arena.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+void ChunkPool::Release::operator()(char* chunk) const {
+    if (pool) {
+        pool->give(chunk);
+    } else {
+        delete[] chunk;
+    }
+}
+
+ChunkPool::~ChunkPool() {
+    for (char* chunk : idle_) delete[] chunk;
+}
+
+ChunkPool& ChunkPool::instance() {
+    static ChunkPool* pool =
+        new ChunkPool(static_cast<size_t>(std::max(Config::performance.arena_pool_mb, 0)) * 1024 * 1024);
+    return *pool;
+}
+
+ChunkPool::Chunk ChunkPool::take() {
+    ++taken_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            char* chunk = idle_.back();
+            idle_.pop_back();
+            ++reused_;
+            return Chunk(chunk, Release{this});
+        }
+    }
+    return Chunk(new char[kChunkSize], Release{this});
+}
+
+void ChunkPool::give(char* chunk) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.size() < maxIdle_) {
+            idle_.push_back(chunk);
+            return;
+        }
+    }
+    ++dropped_;
+    delete[] chunk;
+}
+
+ChunkPool::Stats ChunkPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {taken_.load(), reused_.load(), dropped_.load(), idle_.size() * kChunkSize};
+}
+
+// Starts a fresh chunk with room for size bytes, carrying over the last
+// keep bytes of the current one (an unfinished string)
+char* LogArena::grow(size_t size, size_t keep) {
+    size_t capacity = std::max(chunkSize_, size + keep);
+    if (capacity == ChunkPool::kChunkSize) {
+        chunks_.push_back(ChunkPool::instance().take());
+    } else {
+        chunks_.push_back(ChunkPool::Chunk(new char[capacity]));
+    }
+    char* chunk = chunks_.back().get();
+    if (keep) std::memcpy(chunk, cursor_ - keep, keep);
+    reserved_ += capacity;
+    cursor_ = chunk + keep;
+    end_ = chunk + capacity;
+    return chunk;
+}
+
+void* LogArena::allocate(size_t size, size_t align) {
+    auto aligned = [&] {
+        auto p = reinterpret_cast<uintptr_t>(cursor_);
+        return reinterpret_cast<char*>((p + align - 1) & ~(uintptr_t(align) - 1));
+    };
+    char* p = cursor_ ? aligned() : nullptr;
+    if (!p || p + size > end_) {
+        grow(size + align, 0);
+        p = aligned();
+    }
+    cursor_ = p + size;
+    used_ += size;
+    return p;
+}
+
+std::string_view LogArena::copy(std::string_view s) {
+    if (s.empty()) return {};
+    char* p = static_cast<char*>(allocate(s.size(), 1));
+    std::memcpy(p, s.data(), s.size());
+    return {p, s.size()};
+}
+
+void LogArena::beginString() {
+    if (!cursor_) grow(0, 0);
+    open_ = cursor_;
+}
+
+void LogArena::appendString(const char* data, size_t len) {
+    if (static_cast<size_t>(end_ - cursor_) < len) {
+        size_t keep = cursor_ - open_;
+        // Double long strings so that building one stays linear
+        open_ = grow(std::max(len, keep), keep);
+    }
+    std::memcpy(cursor_, data, len);
+    cursor_ += len;
+    used_ += len;
+}
+
+void LogArena::absorb(LogArena&& other) {
+    for (auto& chunk : other.chunks_) chunks_.push_back(std::move(chunk));
+    used_ += other.used_;
+    reserved_ += other.reserved_;
+    other = LogArena(other.chunkSize_);
+}
+
+std::string_view LogArena::endString() {
+    std::string_view s(open_, cursor_ - open_);
+    open_ = nullptr;
+    return s;
+}
@@ -0,0 +1,550 @@
+#include "log_record.hpp"
+#include "json_stream.hpp"
+#include "json.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+constexpr int kMaxDepth = 512;
+// Lines per thread pool task when a block is big enough to split
+constexpr size_t kParseSlice = 2048;
+
+// Type names are interned for the life of the process
+struct TypeTable {
+    std::mutex mutex;
+    std::deque<std::string> names{""};
+    std::unordered_map<std::string_view, uint16_t> ids;
+};
+
+TypeTable& typeTable() {
+    static TypeTable table;
+    return table;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date (H. Hinnant)
+int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = static_cast<unsigned>(y - era * 400);
+    unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+} // namespace
+
+std::optional<int64_t> parseIsoTimestamp(std::string_view s) {
+    auto num = [&](size_t pos, size_t len) -> std::optional<unsigned> {
+        if (pos + len > s.size()) return std::nullopt;
+        unsigned v = 0;
+        for (size_t i = pos; i < pos + len; ++i) {
+            if (!isDigit(s[i])) return std::nullopt;
+            v = v * 10 + (s[i] - '0');
+        }
+        return v;
+    };
+    if (s.size() < 19 || s[4] != '-' || s[7] != '-' || (s[10] != 'T' && s[10] != ' ') || s[13] != ':' || s[16] != ':')
+        return std::nullopt;
+    auto year = num(0, 4), month = num(5, 2), day = num(8, 2);
+    auto hour = num(11, 2), minute = num(14, 2), second = num(17, 2);
+    if (!year || !month || !day || !hour || !minute || !second) return std::nullopt;
+    if (*month < 1 || *month > 12 || *day < 1 || *day > 31 || *hour > 23 || *minute > 59 || *second > 60)
+        return std::nullopt;
+
+    size_t i = 19;
+    if (i < s.size() && s[i] == '.') {
+        ++i;
+        if (i == s.size() || !isDigit(s[i])) return std::nullopt;
+        while (i < s.size() && isDigit(s[i])) ++i;
+    }
+    int64_t offset = 0;
+    if (i < s.size() && s[i] == 'Z') {
+        ++i;
+    } else if (i < s.size() && (s[i] == '+' || s[i] == '-')) {
+        auto oh = num(i + 1, 2), om = num(i + 4, 2);
+        if (!oh || !om || i + 3 >= s.size() || s[i + 3] != ':') return std::nullopt;
+        offset = (s[i] == '+' ? 1 : -1) * static_cast<int64_t>(*oh * 3600 + *om * 60);
+        i += 6;
+    }
+    if (i != s.size()) return std::nullopt;
+
+    return daysFromCivil(*year, *month, *day) * 86400 + *hour * 3600 + *minute * 60 + *second - offset;
+}
+
+namespace {
+
+// Recursive-descent reader over one log line. Strings without escapes come
+// back as views into the line; escaped ones are decoded into a scratch
+// buffer that is reused for the next string.
+class LineReader {
+public:
+    explicit LineReader(std::string_view line) : begin_(line.data()), p_(line.data()), end_(line.data() + line.size()) {}
+
+    [[noreturn]] void fail(const char* what) const {
+        throw std::runtime_error("Malformed log record at byte " + std::to_string(p_ - begin_) + ": " + what);
+    }
+
+    void skipSpace() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) ++p_;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (p_ < end_ && *p_ == c) {
+            ++p_;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c, const char* what) {
+        if (!consume(c)) fail(what);
+    }
+
+    char peek() {
+        skipSpace();
+        if (p_ == end_) fail("unexpected end of input");
+        return *p_;
+    }
+
+    const char* position() const { return p_; }
+    bool atEnd() {
+        skipSpace();
+        return p_ == end_;
+    }
+
+    std::string_view string(std::string& scratch) {
+        ++p_;                                       // opening quote
+        const char* start = p_;
+        while (p_ < end_ && *p_ != '"' && *p_ != '\\') {
+            if (static_cast<unsigned char>(*p_) < 0x20) fail("control character in string");
+            ++p_;
+        }
+        if (p_ == end_) fail("unterminated string");
+        if (*p_ == '"') return {start, static_cast<size_t>(p_++ - start)};
+
+        scratch.assign(start, p_);
+        uint32_t high = 0;
+        while (true) {
+            if (p_ == end_) fail("unterminated string");
+            char c = *p_++;
+            if (c == '"') break;
+            if (static_cast<unsigned char>(c) < 0x20) fail("control character in string");
+            if (high && c != '\\') fail("unpaired surrogate");
+            if (c != '\\') {
+                scratch += c;
+                continue;
+            }
+            if (p_ == end_) fail("unterminated string");
+            c = *p_++;
+            if (high && c != 'u') fail("unpaired surrogate");
+            switch (c) {
+            case '"': scratch += '"'; break;
+            case '\\': scratch += '\\'; break;
+            case '/': scratch += '/'; break;
+            case 'b': scratch += '\b'; break;
+            case 'f': scratch += '\f'; break;
+            case 'n': scratch += '\n'; break;
+            case 'r': scratch += '\r'; break;
+            case 't': scratch += '\t'; break;
+            case 'u': {
+                if (end_ - p_ < 4) fail("truncated \\u escape");
+                uint32_t cp = 0;
+                for (int i = 0; i < 4; ++i) {
+                    int v = hexValue(*p_++);
+                    if (v < 0) fail("invalid \\u escape");
+                    cp = (cp << 4) | static_cast<uint32_t>(v);
+                }
+                if (high) {
+                    if (cp < 0xDC00 || cp > 0xDFFF) fail("unpaired surrogate");
+                    cp = 0x10000 + ((high - 0xD800) << 10) + (cp - 0xDC00);
+                    high = 0;
+                } else if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    high = cp;
+                    break;
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    fail("unpaired surrogate");
+                }
+                char utf8[4];
+                scratch.append(utf8, encodeUtf8(cp, utf8));
+                break;
+            }
+            default:
+                fail("invalid escape");
+            }
+        }
+        if (high) fail("unpaired surrogate");
+        return scratch;
+    }
+
+    // Integer value of a number token, if it is one that fits in int64
+    std::optional<int64_t> number() {
+        const char* start = p_;
+        bool integer = true;
+        if (p_ < end_ && *p_ == '-') ++p_;
+        if (p_ < end_ && *p_ == '0') {
+            ++p_;
+        } else if (p_ < end_ && *p_ >= '1' && *p_ <= '9') {
+            while (p_ < end_ && isDigit(*p_)) ++p_;
+        } else {
+            fail("invalid value");
+        }
+        if (p_ < end_ && *p_ == '.') {
+            ++p_;
+            if (p_ == end_ || !isDigit(*p_)) fail("invalid number");
+            while (p_ < end_ && isDigit(*p_)) ++p_;
+            integer = false;
+        }
+        if (p_ < end_ && (*p_ == 'e' || *p_ == 'E')) {
+            ++p_;
+            if (p_ < end_ && (*p_ == '+' || *p_ == '-')) ++p_;
+            if (p_ == end_ || !isDigit(*p_)) fail("invalid number");
+            while (p_ < end_ && isDigit(*p_)) ++p_;
+            integer = false;
+        }
+        if (!integer) return std::nullopt;
+        int64_t value = 0;
+        auto [ptr, ec] = std::from_chars(start, p_, value);
+        if (ec != std::errc() || ptr != p_) return std::nullopt;
+        return value;
+    }
+
+    void skipValue(int depth = 0) {
+        if (depth > kMaxDepth) fail("nesting too deep");
+        std::string scratch;
+        switch (peek()) {
+        case '"':
+            string(scratch);
+            break;
+        case '{':
+            ++p_;
+            if (consume('}')) break;
+            do {
+                if (peek() != '"') fail("expected key");
+                string(scratch);
+                expect(':', "expected ':'");
+                skipValue(depth + 1);
+            } while (consume(','));
+            expect('}', "expected ',' or '}'");
+            break;
+        case '[':
+            ++p_;
+            if (consume(']')) break;
+            do {
+                skipValue(depth + 1);
+            } while (consume(','));
+            expect(']', "expected ',' or ']'");
+            break;
+        case 't': literal("true"); break;
+        case 'f': literal("false"); break;
+        case 'n': literal("null"); break;
+        default:
+            number();
+        }
+    }
+
+private:
+    void literal(std::string_view word) {
+        if (static_cast<size_t>(end_ - p_) < word.size() || std::string_view(p_, word.size()) != word)
+            fail("invalid literal");
+        p_ += word.size();
+    }
+
+    const char* begin_;
+    const char* p_;
+    const char* end_;
+};
+
+} // namespace
+
+void appendJsonString(std::string& out, std::string_view s) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    size_t run = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out.append(s.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0xF];
+        }
+    }
+    out.append(s.data() + run, s.size() - run);
+    out += '"';
+}
+
+namespace {
+
+// Canonical form of a raw field, as nested one level deep in an object
+// dumped with the given indent (-1 for compact)
+std::string canonicalJson(std::string_view raw, int indent) {
+    auto value = nlohmann::json::parse(raw);
+    if (indent < 0) return value.dump();
+    std::string text = value.dump(indent);
+    std::string out;
+    out.reserve(text.size());
+    for (char c : text) {
+        out += c;
+        if (c == '\n') out.append(indent, ' ');
+    }
+    return out;
+}
+
+// Known fields are rendered from their typed values, without a DOM
+bool appendKnownField(std::string& out, const LogRecord& r, std::string_view key) {
+    if (key == "event_id" && r.has(LogRecord::EventId)) {
+        out += std::to_string(r.eventId);
+    } else if (key == "type" && r.has(LogRecord::Type)) {
+        appendJsonString(out, logTypeName(r.typeId));
+    } else if (key == "message" && r.has(LogRecord::Message)) {
+        appendJsonString(out, r.message);
+    } else if (key == "source" && r.has(LogRecord::Source)) {
+        appendJsonString(out, r.source);
+    } else if (key == "timestamp" && r.has(LogRecord::Timestamp)) {
+        out += std::to_string(r.timestamp);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+const RawField* LogRecord::extra(std::string_view key) const {
+    for (const auto& f : extraFields()) {
+        if (f.key == key) return &f;
+    }
+    return nullptr;
+}
+
+uint16_t internLogType(std::string_view name) {
+    thread_local std::string lastName;
+    thread_local uint16_t lastId = 0;
+    if (lastId && name == lastName) return lastId;
+
+    TypeTable& table = typeTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto it = table.ids.find(name);
+    if (it == table.ids.end()) {
+        if (table.names.size() > UINT16_MAX) return 0;
+        table.names.emplace_back(name);
+        uint16_t id = static_cast<uint16_t>(table.names.size() - 1);
+        it = table.ids.emplace(table.names.back(), id).first;
+    }
+    lastName.assign(name);
+    lastId = it->second;
+    return lastId;
+}
+
+std::string_view logTypeName(uint16_t id) {
+    TypeTable& table = typeTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    return id < table.names.size() ? std::string_view(table.names[id]) : std::string_view();
+}
+
+LogRecord parseLogRecord(std::string_view line, LogArena& arena) {
+    thread_local std::string keyScratch, valueScratch;
+    thread_local std::vector<RawField> extras;
+    extras.clear();
+
+    LogRecord r;
+    LineReader in(line);
+    in.expect('{', "expected '{'");
+
+    // Later duplicates win, as with nlohmann::json
+    auto forget = [&](LogRecord::Field bits, std::string_view key) {
+        r.fields &= ~bits;
+        extras.erase(std::remove_if(extras.begin(), extras.end(), [&](const RawField& f) { return f.key == key; }),
+                     extras.end());
+    };
+
+    if (!in.consume('}')) {
+        do {
+            if (in.peek() != '"') in.fail("expected key");
+            std::string_view key = in.string(keyScratch);
+            in.expect(':', "expected ':'");
+            char next = in.peek();
+            const char* valueStart = in.position();
+            bool known = false;
+
+            if (key == "event_id") {
+                forget(LogRecord::EventId, key);
+                if (next == '-' || isDigit(next)) {
+                    if (auto v = in.number()) {
+                        r.eventId = *v;
+                        r.fields |= LogRecord::EventId;
+                        known = true;
+                    }
+                }
+            } else if (key == "type" || key == "message" || key == "source") {
+                auto bit = key == "type" ? LogRecord::Type : key == "message" ? LogRecord::Message : LogRecord::Source;
+                forget(bit, key);
+                if (next == '"') {
+                    std::string_view value = in.string(valueScratch);
+                    if (bit == LogRecord::Type) {
+                        r.typeId = internLogType(value);
+                        known = r.typeId != 0;
+                    } else {
+                        (bit == LogRecord::Message ? r.message : r.source) = arena.copy(value);
+                        known = true;
+                    }
+                    if (known) r.fields |= bit;
+                }
+            } else if (key == "timestamp") {
+                forget(static_cast<LogRecord::Field>(LogRecord::Timestamp | LogRecord::TimestampText), key);
+                if (next == '-' || isDigit(next)) {
+                    if (auto v = in.number()) {
+                        r.timestamp = *v;
+                        r.fields |= LogRecord::Timestamp;
+                        known = true;
+                    }
+                } else if (next == '"') {
+                    // The text stays authoritative for output; the parsed
+                    // value is there for ordering and windowing
+                    if (auto v = parseIsoTimestamp(in.string(valueScratch))) {
+                        r.timestamp = *v;
+                        r.fields |= LogRecord::TimestampText;
+                    }
+                }
+            } else {
+                forget(LogRecord::Field(0), key);
+            }
+
+            if (!known) {
+                // Whatever was consumed above belongs to this raw value
+                if (in.position() == valueStart) in.skipValue();
+                std::string_view raw(valueStart, in.position() - valueStart);
+                extras.push_back({arena.copy(key), arena.copy(raw)});
+            }
+        } while (in.consume(','));
+        in.expect('}', "expected ',' or '}'");
+    }
+    if (!in.atEnd()) in.fail("unexpected trailing characters");
+
+    if (!extras.empty()) {
+        RawField* fields = arena.allocateArray<RawField>(extras.size());
+        std::copy(extras.begin(), extras.end(), fields);
+        r.extras = fields;
+        r.extraCount = static_cast<uint32_t>(extras.size());
+    }
+    return r;
+}
+
+// Large blocks are parsed in slices on the thread pool, each slice into an
+// arena of its own that then joins the block's
+std::vector<LogRecord> parseAndSortLogs(const std::vector<std::string_view>& lines, LogArena& arena) {
+    std::vector<LogRecord> records(lines.size());
+    size_t slices = lines.size() / kParseSlice;
+    if (slices < 2) {
+        for (size_t i = 0; i < lines.size(); ++i) records[i] = parseLogRecord(lines[i], arena);
+    } else {
+        std::vector<LogArena> arenas(slices);
+        ThreadPool::Group group(ThreadPool::instance());
+        for (size_t s = 0; s < slices; ++s) {
+            group.run([&, s] {
+                size_t end = s + 1 == slices ? lines.size() : (s + 1) * kParseSlice;
+                for (size_t i = s * kParseSlice; i < end; ++i) records[i] = parseLogRecord(lines[i], arenas[s]);
+            });
+        }
+        group.wait();
+        for (auto& sliceArena : arenas) arena.absorb(std::move(sliceArena));
+    }
+    sortLogRecords(records);
+    return records;
+}
+
+std::string logFieldJson(const LogRecord& record, std::string_view key) {
+    std::string out;
+    if (appendKnownField(out, record, key)) return out;
+    if (const RawField* f = record.extra(key)) return canonicalJson(f->json, -1);
+    return "null";
+}
+
+void appendLogRecordJson(std::string& out, const LogRecord& record, int indent) {
+    // In key order, each with the flag that makes appendKnownField write it
+    static const std::pair<std::string_view, LogRecord::Field> knownKeys[] = {
+        {"event_id", LogRecord::EventId}, {"message", LogRecord::Message}, {"source", LogRecord::Source},
+        {"timestamp", LogRecord::Timestamp}, {"type", LogRecord::Type}};
+
+    std::string_view keys[8];
+    std::vector<std::string_view> manyKeys;
+    size_t count = 0;
+    auto add = [&](std::string_view key) {
+        if (count < std::size(keys)) {
+            keys[count] = key;
+        } else {
+            if (manyKeys.empty()) manyKeys.assign(keys, keys + count);
+            manyKeys.push_back(key);
+        }
+        ++count;
+    };
+    for (auto [key, field] : knownKeys) {
+        if (record.has(field)) add(key);
+    }
+    for (const auto& f : record.extraFields()) add(f.key);
+
+    if (count == 0) {
+        out += "{}";
+        return;
+    }
+    std::string_view* sorted = manyKeys.empty() ? keys : manyKeys.data();
+    std::sort(sorted, sorted + count);
+
+    if (indent < 0) {
+        out += '{';
+        for (size_t i = 0; i < count; ++i) {
+            if (i > 0) out += ',';
+            appendJsonString(out, sorted[i]);
+            out += ':';
+            if (!appendKnownField(out, record, sorted[i])) {
+                out += canonicalJson(record.extra(sorted[i])->json, -1);
+            }
+        }
+        out += '}';
+        return;
+    }
+
+    std::string pad(indent, ' ');
+    out += "{\n";
+    for (size_t i = 0; i < count; ++i) {
+        out += pad;
+        appendJsonString(out, sorted[i]);
+        out += ": ";
+        if (!appendKnownField(out, record, sorted[i])) {
+            out += canonicalJson(record.extra(sorted[i])->json, indent);
+        }
+        out += i + 1 < count ? ",\n" : "\n";
+    }
+    out += "}";
+}
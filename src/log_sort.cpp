@@ -0,0 +1,149 @@
+#include "log_sort.hpp"
+#include <algorithm>
+
+namespace {
+
+constexpr size_t kRadixThreshold = 64;
+constexpr int kRadixBits = 11;
+constexpr int kRadixPasses = (64 + kRadixBits - 1) / kRadixBits;
+constexpr size_t kRadixBuckets = size_t(1) << kRadixBits;
+constexpr uint64_t kRadixMask = kRadixBuckets - 1;
+
+// Maps v so that larger values get smaller keys
+uint64_t descending(int64_t v) {
+    return ~(static_cast<uint64_t>(v) ^ (uint64_t(1) << 63));
+}
+
+struct Item {
+    uint64_t key;       // LogOrderKey::primary
+    uint32_t index;
+};
+
+void radixPass(std::vector<Item>& from, std::vector<Item>& to, const uint32_t* counts, int shift) {
+    uint32_t offsets[kRadixBuckets];
+    uint32_t sum = 0;
+    for (size_t b = 0; b < kRadixBuckets; ++b) {
+        offsets[b] = sum;
+        sum += counts[b];
+    }
+    for (const Item& item : from) to[offsets[(item.key >> shift) & kRadixMask]++] = item;
+    from.swap(to);
+}
+
+// Stable LSD radix sort of items on their 64-bit key, eleven bits a pass.
+// Passes on a digit that is the same in every key (the high ones, with
+// event ids of any realistic range) are skipped, so ids below 2^33 take
+// three passes.
+void radixSort(std::vector<Item>& items) {
+    size_t n = items.size();
+    std::vector<uint32_t> counts(kRadixPasses * kRadixBuckets, 0);
+    for (const Item& item : items) {
+        for (int p = 0; p < kRadixPasses; ++p) {
+            ++counts[p * kRadixBuckets + ((item.key >> (kRadixBits * p)) & kRadixMask)];
+        }
+    }
+    std::vector<Item> scratch(n);
+    for (int p = 0; p < kRadixPasses; ++p) {
+        const uint32_t* c = counts.data() + p * kRadixBuckets;
+        if (c[(items[0].key >> (kRadixBits * p)) & kRadixMask] == n) continue;
+        radixPass(items, scratch, c, kRadixBits * p);
+    }
+}
+
+} // namespace
+
+LogOrderKey logOrderKey(const LogRecord& r) {
+    bool hasTime = r.has(LogRecord::Timestamp) || r.has(LogRecord::TimestampText);
+    return {r.has(LogRecord::EventId) ? descending(r.eventId) : UINT64_MAX,
+            hasTime ? descending(r.timestamp) : UINT64_MAX};
+}
+
+// Radix sort on event_id, with timestamps only consulted inside runs of
+// equal ids. Input that is already in order, or in exactly reverse order,
+// is detected in one pass and costs no more.
+void sortLogRecords(std::vector<LogRecord>& records) {
+    size_t n = records.size();
+    if (n < 2) return;
+
+    std::vector<Item> items(n);
+    bool ordered = true, reversed = true;
+    LogOrderKey prev = logOrderKey(records[0]);
+    items[0] = {prev.primary, 0};
+    for (size_t i = 1; i < n; ++i) {
+        LogOrderKey key = logOrderKey(records[i]);
+        items[i] = {key.primary, static_cast<uint32_t>(i)};
+        if (key < prev) ordered = false;
+        if (prev < key) reversed = false;
+        prev = key;
+    }
+    if (ordered) return;
+    if (reversed) {
+        // Reverse, then put runs of equal keys back in input order
+        std::reverse(records.begin(), records.end());
+        for (size_t i = 0, j; i < n; i = j) {
+            LogOrderKey key = logOrderKey(records[i]);
+            for (j = i + 1; j < n && !(key < logOrderKey(records[j])); ++j) {}
+            std::reverse(records.begin() + i, records.begin() + j);
+        }
+        return;
+    }
+
+    if (n < kRadixThreshold) {
+        std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.key < b.key; });
+    } else {
+        radixSort(items);
+    }
+
+    // Equal event ids are rare; order each such run by timestamp
+    auto byTime = [&](const Item& a, const Item& b) {
+        return logOrderKey(records[a.index]).secondary < logOrderKey(records[b.index]).secondary;
+    };
+    for (size_t i = 0, j; i < n; i = j) {
+        for (j = i + 1; j < n && items[j].key == items[i].key; ++j) {}
+        if (j - i > 1) std::stable_sort(items.begin() + i, items.begin() + j, byTime);
+    }
+
+    std::vector<LogRecord> sorted;
+    sorted.reserve(n);
+    for (const Item& item : items) sorted.push_back(records[item.index]);
+    records.swap(sorted);
+}
+
+LogMerger::LogMerger(size_t window, Emit emit) : window_(window ? window : 1), emit_(std::move(emit)) {}
+
+// Heap order: the run whose next record comes first sits at the front
+bool LogMerger::later(const std::unique_ptr<Run>& a, const std::unique_ptr<Run>& b) {
+    return b->key() < a->key();
+}
+
+void LogMerger::releaseFront() {
+    std::pop_heap(runs_.begin(), runs_.end(), later);
+    Run& run = *runs_.back();
+
+    LogOrderKey key = run.key();
+    if (emitted_ && key < last_) ++late_;
+    last_ = key;
+    emitted_ = true;
+    emit_(run.block.logs[run.next], run.block);
+
+    if (++run.next == run.block.logs.size()) {
+        runs_.pop_back();
+    } else {
+        std::push_heap(runs_.begin(), runs_.end(), later);
+    }
+}
+
+void LogMerger::push(ChainBlock block) {
+    if (block.logs.empty()) return;
+    LogOrderKey watermark = logOrderKey(block.logs.front());
+
+    runs_.push_back(std::make_unique<Run>(Run{std::move(block)}));
+    std::push_heap(runs_.begin(), runs_.end(), later);
+
+    while (!runs_.empty() && runs_.front()->key() < watermark) releaseFront();
+    while (runs_.size() > window_) releaseFront();
+}
+
+void LogMerger::finish() {
+    while (!runs_.empty()) releaseFront();
+}
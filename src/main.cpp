@@ -1,7 +1,21 @@
 #include "cli.hpp"
+#include "config.hpp"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Without arguments the interactive shell starts; with them, one command
+// runs headless and its result is the exit status
+int main(int argc, char** argv) {
+    std::string settings = Config::dirs.get_config_path() + "/settings.json";
+    if (std::filesystem::exists(settings)) {
+        Config::load_config_from_file(settings);
+    }
 
-int main() {
     CLI cli;
+    if (argc > 1) {
+        return cli.batch(std::vector<std::string>(argv + 1, argv + argc));
+    }
     cli.run();
     return 0;
 }
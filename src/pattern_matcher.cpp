@@ -0,0 +1,279 @@
+#include "pattern_matcher.hpp"
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PATTERN_X86 1
+#endif
+
+namespace {
+
+constexpr int kBuckets = 8;
+constexpr unsigned char kFold = 0x20;   // folds ASCII case, and some punctuation with it
+
+unsigned char lower(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+// Every kernel reads kBlock + 1 bytes at t and returns a mask with bit k set
+// if a pattern may start at t[k]: some bucket has a pattern whose folded
+// first two bytes have the nibbles of t[k] and t[k + 1]
+constexpr size_t kBlock = 32;
+using Kernel = uint32_t (*)(const uint8_t (*m)[32], const unsigned char* t);
+
+uint32_t scalarBlock(const uint8_t (*m)[32], const unsigned char* t) {
+    uint32_t hits = 0;
+    for (size_t k = 0; k < kBlock; ++k) {
+        unsigned char c0 = t[k] | kFold, c1 = t[k + 1] | kFold;
+        if (m[0][c0 & 15] & m[1][c0 >> 4] & m[2][c1 & 15] & m[3][c1 >> 4]) hits |= 1u << k;
+    }
+    return hits;
+}
+
+#ifdef PATTERN_X86
+
+// Teddy-style: four nibble lookups with pshufb, ANDed per bucket
+__attribute__((target("ssse3")))
+uint32_t ssse3Block(const uint8_t (*m)[32], const unsigned char* t) {
+    const __m128i lo0 = _mm_load_si128(reinterpret_cast<const __m128i*>(m[0]));
+    const __m128i hi0 = _mm_load_si128(reinterpret_cast<const __m128i*>(m[1]));
+    const __m128i lo1 = _mm_load_si128(reinterpret_cast<const __m128i*>(m[2]));
+    const __m128i hi1 = _mm_load_si128(reinterpret_cast<const __m128i*>(m[3]));
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i fold = _mm_set1_epi8(kFold);
+    uint32_t hits = 0;
+    for (size_t k = 0; k < kBlock; k += 16) {
+        __m128i v0 = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(t + k)), fold);
+        __m128i v1 = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(t + k + 1)), fold);
+        __m128i r = _mm_and_si128(_mm_shuffle_epi8(lo0, _mm_and_si128(v0, nibble)),
+                                  _mm_shuffle_epi8(hi0, _mm_and_si128(_mm_srli_epi16(v0, 4), nibble)));
+        r = _mm_and_si128(r, _mm_shuffle_epi8(lo1, _mm_and_si128(v1, nibble)));
+        r = _mm_and_si128(r, _mm_shuffle_epi8(hi1, _mm_and_si128(_mm_srli_epi16(v1, 4), nibble)));
+        uint32_t none = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(r, _mm_setzero_si128())));
+        hits |= (~none & 0xffff) << k;
+    }
+    return hits;
+}
+
+__attribute__((target("avx2")))
+uint32_t avx2Block(const uint8_t (*m)[32], const unsigned char* t) {
+    const __m256i lo0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(m[0]));
+    const __m256i hi0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(m[1]));
+    const __m256i lo1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(m[2]));
+    const __m256i hi1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(m[3]));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i fold = _mm256_set1_epi8(kFold);
+    __m256i v0 = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(t)), fold);
+    __m256i v1 = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(t + 1)), fold);
+    __m256i r = _mm256_and_si256(_mm256_shuffle_epi8(lo0, _mm256_and_si256(v0, nibble)),
+                                 _mm256_shuffle_epi8(hi0, _mm256_and_si256(_mm256_srli_epi16(v0, 4), nibble)));
+    r = _mm256_and_si256(r, _mm256_shuffle_epi8(lo1, _mm256_and_si256(v1, nibble)));
+    r = _mm256_and_si256(r, _mm256_shuffle_epi8(hi1, _mm256_and_si256(_mm256_srli_epi16(v1, 4), nibble)));
+    return ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(r, _mm256_setzero_si256())));
+}
+
+#endif
+
+struct Dispatch {
+    Kernel kernel = scalarBlock;
+    const char* name = "scalar";
+
+    Dispatch() {
+#ifdef PATTERN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            kernel = avx2Block;
+            name = "avx2";
+        } else if (__builtin_cpu_supports("ssse3")) {
+            kernel = ssse3Block;
+            name = "ssse3";
+        }
+#endif
+    }
+};
+
+const Dispatch& dispatch() {
+    static const Dispatch d;
+    return d;
+}
+
+} // namespace
+
+PatternMatcher::PatternMatcher(const std::vector<std::string>& patterns) {
+    if (patterns.size() > UINT16_MAX) {
+        throw std::runtime_error("Too many patterns: " + std::to_string(patterns.size()));
+    }
+    for (const auto& p : patterns) {
+        std::string folded(p);
+        for (auto& c : folded) c = static_cast<char>(lower(static_cast<unsigned char>(c)));
+        patterns_.push_back(std::move(folded));
+    }
+
+    // Byte classes: one per distinct pattern byte, class 0 for the rest
+    uint32_t classCount = 1;
+    for (const auto& p : patterns_) {
+        for (unsigned char c : p) {
+            if (classes_[c]) continue;
+            if (classCount > UINT8_MAX) throw std::runtime_error("Patterns use too many distinct bytes");
+            classes_[c] = static_cast<uint8_t>(classCount++);
+        }
+    }
+    for (int c = 'A'; c <= 'Z'; ++c) classes_[c] = classes_[lower(c)];
+    stride_ = (classCount + 1) & ~1u;   // even, so bit 0 of a row offset is free
+
+    // Trie, then failure links breadth-first, filling in every transition
+    std::vector<int32_t> next(stride_, -1);
+    std::vector<std::vector<uint16_t>> out(1);
+    for (size_t id = 0; id < patterns_.size(); ++id) {
+        if (patterns_[id].empty()) continue;
+        size_t s = 0;
+        for (unsigned char c : patterns_[id]) {
+            int32_t& n = next[s * stride_ + classes_[c]];
+            if (n < 0) {
+                n = static_cast<int32_t>(out.size());
+                out.emplace_back();
+                next.resize(next.size() + stride_, -1);
+            }
+            s = static_cast<size_t>(next[s * stride_ + classes_[c]]);
+        }
+        out[s].push_back(static_cast<uint16_t>(id));
+    }
+
+    size_t states = out.size();
+    std::vector<uint32_t> fail(states, 0);
+    std::deque<uint32_t> queue;
+    for (uint32_t c = 0; c < stride_; ++c) {
+        int32_t& n = next[c];
+        if (n < 0) {
+            n = 0;
+        } else {
+            queue.push_back(static_cast<uint32_t>(n));
+        }
+    }
+    while (!queue.empty()) {
+        uint32_t s = queue.front();
+        queue.pop_front();
+        const auto& inherited = out[fail[s]];
+        out[s].insert(out[s].end(), inherited.begin(), inherited.end());
+        for (uint32_t c = 0; c < stride_; ++c) {
+            int32_t& n = next[s * stride_ + c];
+            uint32_t viaFail = static_cast<uint32_t>(next[fail[s] * stride_ + c]);
+            if (n < 0) {
+                n = static_cast<int32_t>(viaFail);
+            } else {
+                fail[n] = viaFail;
+                queue.push_back(static_cast<uint32_t>(n));
+            }
+        }
+    }
+
+    delta_.resize(states * stride_);
+    for (size_t i = 0; i < delta_.size(); ++i) {
+        uint32_t target = static_cast<uint32_t>(next[i]);
+        delta_[i] = target * stride_ | (out[target].empty() ? 0 : 1);
+    }
+    outputBegin_.resize(states + 1);
+    for (size_t s = 0; s < states; ++s) {
+        outputBegin_[s] = static_cast<uint32_t>(outputs_.size());
+        outputs_.insert(outputs_.end(), out[s].begin(), out[s].end());
+    }
+    outputBegin_[states] = static_cast<uint32_t>(outputs_.size());
+
+    // Prefilter buckets: patterns sorted by their first two bytes and cut
+    // into contiguous runs, so patterns sharing a bucket mostly share a
+    // prefix and their nibble masks combine into few false candidates
+    std::vector<size_t> order;
+    for (size_t id = 0; id < patterns_.size(); ++id) {
+        if (!patterns_[id].empty()) order.push_back(id);
+    }
+    empty_ = order.empty();
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return patterns_[a].compare(0, 2, patterns_[b], 0, 2) < 0;
+    });
+    for (size_t k = 0; k < order.size(); ++k) {
+        const std::string& p = patterns_[order[k]];
+        uint8_t bit = static_cast<uint8_t>(1u << (k * kBuckets / order.size()));
+        unsigned char c0 = static_cast<unsigned char>(p[0]) | kFold;
+        masks_[0][c0 & 15] |= bit;
+        masks_[1][c0 >> 4] |= bit;
+        if (p.size() == 1) {
+            for (int n = 0; n < 16; ++n) {
+                masks_[2][n] |= bit;
+                masks_[3][n] |= bit;
+            }
+        } else {
+            unsigned char c1 = static_cast<unsigned char>(p[1]) | kFold;
+            masks_[2][c1 & 15] |= bit;
+            masks_[3][c1 >> 4] |= bit;
+        }
+    }
+    for (auto& row : masks_) std::copy(row, row + 16, row + 16);
+}
+
+const char* PatternMatcher::kernelName() {
+    return dispatch().name;
+}
+
+// Calls onMatch(state) for every accepting state reached; stops early if it
+// returns false. Text is taken kBlock bytes at a time. A block entered at
+// the root, where no pattern is in progress, is skipped if it holds no
+// candidate and otherwise run from its first one; within a block the DFA
+// steps every byte, as branching on the root state per byte costs more in
+// mispredictions than it saves on text as dense in candidates as prose.
+template <typename OnMatch>
+void PatternMatcher::run(std::string_view text, OnMatch&& onMatch) const {
+    if (empty_) return;
+    Kernel kernel = dispatch().kernel;
+    const uint32_t* delta = delta_.data();
+    const uint8_t* classes = classes_.data();
+    auto* t = reinterpret_cast<const unsigned char*>(text.data());
+    size_t len = text.size();
+    uint32_t s = 0;
+    for (size_t i = 0; i < len; i += kBlock) {
+        size_t end = std::min(i + kBlock, len);
+        size_t p = i;
+        if (s == 0) {
+            uint32_t candidates;
+            if (end < len) {
+                candidates = kernel(masks_, t + i);
+            } else {
+                // Zero padding folds to spaces, which cannot hide a
+                // candidate: only one-byte patterns can start at the last
+                // byte, and they accept any second byte
+                unsigned char tail[kBlock + 1] = {};
+                std::copy(t + i, t + len, tail);
+                candidates = kernel(masks_, tail) & (~0u >> (kBlock - (len - i)));
+            }
+            if (!candidates) continue;
+            p += __builtin_ctz(candidates);
+        }
+        for (; p < end; ++p) {
+            uint32_t n = delta[s + classes[t[p]]];
+            s = n & ~1u;
+            if ((n & 1) && !onMatch(s / stride_)) return;
+        }
+    }
+}
+
+void PatternMatcher::match(std::string_view text, std::vector<uint16_t>& ids) const {
+    ids.clear();
+    run(text, [&](uint32_t state) {
+        ids.insert(ids.end(), outputs_.begin() + outputBegin_[state], outputs_.begin() + outputBegin_[state + 1]);
+        return true;
+    });
+    if (ids.size() > 1) {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+}
+
+bool PatternMatcher::matchesAny(std::string_view text) const {
+    bool found = false;
+    run(text, [&](uint32_t) {
+        found = true;
+        return false;
+    });
+    return found;
+}
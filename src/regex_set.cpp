@@ -0,0 +1,713 @@
+#include "regex_set.hpp"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+constexpr int kMaxRepeat = 1000;
+constexpr size_t kMaxNfaStates = 1 << 20;
+constexpr size_t kMaxLiterals = 16;     // strings in a required-literal set
+
+unsigned char lower(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+unsigned char firstByte(const std::bitset<256>& bytes) {
+    int b = 0;
+    while (b < 255 && !bytes.test(b)) ++b;
+    return static_cast<unsigned char>(b);
+}
+
+// Adds the other case of every ASCII letter in the set
+void foldCase(std::bitset<256>& bytes) {
+    for (int c = 'a'; c <= 'z'; ++c) {
+        if (bytes.test(c) || bytes.test(c - 'a' + 'A')) {
+            bytes.set(c);
+            bytes.set(c - 'a' + 'A');
+        }
+    }
+}
+
+} // namespace
+
+struct RegexSet::Node {
+    enum Kind { Empty, Bytes, Concat, Alt, Repeat } kind = Empty;
+    std::bitset<256> bytes;
+    std::vector<Node> kids;
+    int min = 0, max = 0;       // Repeat; max < 0 is unbounded
+};
+
+// Recursive descent over one pattern, plus the required-literal analysis
+// of the tree it produces
+class RegexSet::Parser {
+public:
+    explicit Parser(std::string_view pattern) : p_(pattern) {}
+
+    Node parse() {
+        if (!p_.empty() && p_.front() == '^') {
+            anchoredStart = true;
+            p_.remove_prefix(1);
+        }
+        size_t escapes = 0;
+        for (size_t i = p_.size(); i > 1 && p_[i - 2] == '\\'; --i) ++escapes;
+        if (!p_.empty() && p_.back() == '$' && escapes % 2 == 0) {
+            anchoredEnd = true;
+            p_.remove_suffix(1);
+        }
+        Node root = alternation();
+        if (i_ < p_.size()) fail("unbalanced )");
+        if ((anchoredStart || anchoredEnd) && topLevelAlt_) fail("anchored alternation must be grouped");
+        return root;
+    }
+
+    bool anchoredStart = false;
+    bool anchoredEnd = false;
+
+    struct Literals {
+        bool exact = true;                  // exactSet is every string the node matches
+        std::vector<std::string> exactSet{""};
+        std::vector<std::string> required;  // one of them is in every match
+    };
+
+    static Literals literals(const Node& node);
+    static std::vector<std::string> best(const std::vector<std::string>& a, const std::vector<std::string>& b);
+    static size_t score(const std::vector<std::string>& set);
+
+private:
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error(what + " at offset " + std::to_string(i_));
+    }
+
+    bool more() const { return i_ < p_.size(); }
+    char peek() const { return p_[i_]; }
+
+    Node alternation() {
+        Node first = concatenation();
+        if (!more() || peek() != '|') return first;
+        // ^a|b would read as (^a)|b elsewhere; a group is unambiguous
+        if (depth_ == 0) topLevelAlt_ = true;
+        Node alt;
+        alt.kind = Node::Alt;
+        alt.kids.push_back(std::move(first));
+        while (more() && peek() == '|') {
+            ++i_;
+            alt.kids.push_back(concatenation());
+        }
+        return alt;
+    }
+
+    Node concatenation() {
+        Node cat;
+        cat.kind = Node::Concat;
+        while (more() && peek() != '|' && peek() != ')') {
+            cat.kids.push_back(repetition());
+        }
+        if (cat.kids.empty()) return Node{};
+        if (cat.kids.size() == 1) return std::move(cat.kids[0]);
+        return cat;
+    }
+
+    Node repetition() {
+        Node atom = this->atom();
+        while (more()) {
+            int min, max;
+            char c = peek();
+            if (c == '*') {
+                min = 0, max = -1;
+                ++i_;
+            } else if (c == '+') {
+                min = 1, max = -1;
+                ++i_;
+            } else if (c == '?') {
+                min = 0, max = 1;
+                ++i_;
+            } else if (c != '{' || !bounds(min, max)) {
+                break;
+            }
+            if (more() && peek() == '?') ++i_;     // lazy: same set of matching texts
+            Node rep;
+            rep.kind = Node::Repeat;
+            rep.min = min;
+            rep.max = max;
+            rep.kids.push_back(std::move(atom));
+            atom = std::move(rep);
+        }
+        return atom;
+    }
+
+    // {n}, {n,} or {n,m}; anything else leaves { to be read as a literal
+    bool bounds(int& min, int& max) {
+        size_t j = i_ + 1;
+        auto number = [&](int& out) {
+            size_t from = j;
+            out = 0;
+            while (j < p_.size() && p_[j] >= '0' && p_[j] <= '9') out = std::min(out * 10 + (p_[j++] - '0'), kMaxRepeat + 1);
+            return j > from;
+        };
+        if (!number(min)) return false;
+        max = min;
+        if (j < p_.size() && p_[j] == ',') {
+            ++j;
+            if (!number(max)) max = -1;
+        }
+        if (j >= p_.size() || p_[j] != '}') return false;
+        if (min > kMaxRepeat || max > kMaxRepeat) fail("repeat count above " + std::to_string(kMaxRepeat));
+        if (max >= 0 && max < min) fail("repeat bounds out of order");
+        i_ = j + 1;
+        return true;
+    }
+
+    Node atom() {
+        Node node;
+        node.kind = Node::Bytes;
+        char c = p_[i_++];
+        switch (c) {
+        case '(': {
+            if (p_.substr(i_, 2) == "?:") {
+                i_ += 2;
+            } else if (more() && peek() == '?') {
+                fail("unsupported group");
+            }
+            ++depth_;
+            Node inner = alternation();
+            --depth_;
+            if (!more() || peek() != ')') fail("missing )");
+            ++i_;
+            return inner;
+        }
+        case ')':
+            fail("unbalanced )");
+        case '*':
+        case '+':
+        case '?':
+            fail("nothing to repeat");
+        case '^':
+        case '$':
+            fail("anchors are only supported at the start and end");
+        case '.':
+            node.bytes.set();
+            node.bytes.reset('\n');
+            return node;
+        case '[':
+            node.bytes = charClass();
+            break;
+        case '\\':
+            node.bytes = escape();
+            break;
+        default:
+            node.bytes.set(static_cast<unsigned char>(c));
+            break;
+        }
+        foldCase(node.bytes);
+        return node;
+    }
+
+    std::bitset<256> charClass() {
+        std::bitset<256> set;
+        bool negate = more() && peek() == '^';
+        if (negate) ++i_;
+        bool first = true;
+        while (more() && (peek() != ']' || first)) {
+            first = false;
+            std::bitset<256> item;
+            unsigned char lo = static_cast<unsigned char>(p_[i_++]);
+            if (lo == '\\') {
+                item = escape();
+                if (item.count() != 1) {
+                    set |= item;
+                    continue;
+                }
+                lo = firstByte(item);
+            }
+            if (i_ + 1 < p_.size() && peek() == '-' && p_[i_ + 1] != ']') {
+                ++i_;
+                unsigned char hi = static_cast<unsigned char>(p_[i_++]);
+                if (hi == '\\') {
+                    item = escape();
+                    if (item.count() != 1) fail("bad range");
+                    hi = firstByte(item);
+                }
+                if (hi < lo) fail("bad range");
+                for (int b = lo; b <= hi; ++b) set.set(b);
+            } else {
+                set.set(lo);
+            }
+        }
+        if (!more()) fail("missing ]");
+        ++i_;
+        foldCase(set);
+        return negate ? ~set : set;
+    }
+
+    std::bitset<256> escape() {
+        if (!more()) fail("trailing \\");
+        char c = p_[i_++];
+        std::bitset<256> set;
+        auto range = [&](int lo, int hi) {
+            for (int b = lo; b <= hi; ++b) set.set(b);
+        };
+        switch (c) {
+        case 'd':
+        case 'D':
+            range('0', '9');
+            break;
+        case 'w':
+        case 'W':
+            range('0', '9');
+            range('A', 'Z');
+            range('a', 'z');
+            set.set('_');
+            break;
+        case 's':
+        case 'S':
+            for (char s : {' ', '\t', '\n', '\r', '\f', '\v'}) set.set(static_cast<unsigned char>(s));
+            break;
+        case 'n':
+            set.set('\n');
+            return set;
+        case 't':
+            set.set('\t');
+            return set;
+        case 'r':
+            set.set('\r');
+            return set;
+        case 'x': {
+            auto hex = [&](char h) -> int {
+                if (h >= '0' && h <= '9') return h - '0';
+                h = static_cast<char>(lower(static_cast<unsigned char>(h)));
+                if (h >= 'a' && h <= 'f') return h - 'a' + 10;
+                fail("bad \\x escape");
+            };
+            if (i_ + 2 > p_.size()) fail("bad \\x escape");
+            set.set(hex(p_[i_]) * 16 + hex(p_[i_ + 1]));
+            i_ += 2;
+            return set;
+        }
+        default:
+            if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+                fail(std::string("unsupported escape \\") + c);
+            }
+            set.set(static_cast<unsigned char>(c));
+            return set;
+        }
+        return c >= 'A' && c <= 'Z' ? ~set : set;
+    }
+
+    std::string_view p_;
+    size_t i_ = 0;
+    int depth_ = 0;             // open groups around i_
+    bool topLevelAlt_ = false;  // a | outside every group
+};
+
+size_t RegexSet::Parser::score(const std::vector<std::string>& set) {
+    if (set.empty()) return 0;
+    size_t shortest = SIZE_MAX;
+    for (const auto& s : set) shortest = std::min(shortest, s.size());
+    return shortest;
+}
+
+// The more selective set: longer shortest string, then fewer strings
+std::vector<std::string> RegexSet::Parser::best(const std::vector<std::string>& a,
+                                                const std::vector<std::string>& b) {
+    size_t sa = score(a), sb = score(b);
+    if (sa != sb) return sa > sb ? a : b;
+    return a.size() <= b.size() ? a : b;
+}
+
+namespace {
+
+// Every concatenation of a string of a with one of b, or false if there
+// would be too many
+bool cross(const std::vector<std::string>& a, const std::vector<std::string>& b, std::vector<std::string>& out) {
+    if (a.size() * b.size() > kMaxLiterals) return false;
+    out.clear();
+    for (const auto& x : a) {
+        for (const auto& y : b) out.push_back(x + y);
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return true;
+}
+
+} // namespace
+
+// Bottom-up: what exactly a node matches while that is a small set of
+// strings, and otherwise the best set of strings one of which must occur.
+// Concatenations join neighbouring exact runs, so the literal part of
+// ".*buffer overflow.*" survives the wildcards around it.
+RegexSet::Parser::Literals RegexSet::Parser::literals(const Node& node) {
+    Literals out;
+    switch (node.kind) {
+    case Node::Empty:
+        break;
+    case Node::Bytes: {
+        std::vector<std::string> chars;
+        for (int b = 0; b < 256 && chars.size() <= 4; ++b) {
+            if (node.bytes.test(b) && lower(b) == b) chars.emplace_back(1, static_cast<char>(b));
+        }
+        if (chars.size() <= 4) {
+            out.exactSet = std::move(chars);
+        } else {
+            out.exact = false;
+            out.exactSet.clear();
+        }
+        break;
+    }
+    case Node::Concat: {
+        std::vector<std::string> run{""}, joined;
+        for (const auto& kid : node.kids) {
+            Literals k = literals(kid);
+            out.required = best(out.required, k.required);
+            if (k.exact && cross(run, k.exactSet, joined)) {
+                run.swap(joined);
+                continue;
+            }
+            out.exact = false;
+            out.required = best(out.required, run);
+            run = k.exact ? k.exactSet : std::vector<std::string>{""};
+        }
+        out.required = best(out.required, run);
+        if (out.exact) {
+            out.exactSet = std::move(run);
+        } else {
+            out.exactSet.clear();
+        }
+        break;
+    }
+    case Node::Alt: {
+        // Each branch needs a usable literal for the node to have one
+        bool usable = true;
+        out.exactSet.clear();
+        for (const auto& kid : node.kids) {
+            Literals k = literals(kid);
+            if (out.exact && k.exact) {
+                out.exactSet.insert(out.exactSet.end(), k.exactSet.begin(), k.exactSet.end());
+            } else {
+                out.exact = false;
+            }
+            const auto& need = best(k.required, k.exact ? k.exactSet : std::vector<std::string>{});
+            usable = usable && score(need) > 0;
+            if (usable) out.required.insert(out.required.end(), need.begin(), need.end());
+        }
+        for (auto* set : {&out.exactSet, &out.required}) {
+            std::sort(set->begin(), set->end());
+            set->erase(std::unique(set->begin(), set->end()), set->end());
+        }
+        if (out.exactSet.size() > kMaxLiterals) {
+            out.exact = false;
+            out.exactSet.clear();
+        }
+        if (!usable || out.required.size() > kMaxLiterals) out.required.clear();
+        break;
+    }
+    case Node::Repeat: {
+        Literals k = literals(node.kids[0]);
+        out.exact = false;
+        out.exactSet.clear();
+        if (node.min == 0) break;
+        out.required = best(k.required, k.exact ? k.exactSet : std::vector<std::string>{});
+        if (node.min == node.max && k.exact) {
+            std::vector<std::string> run{""}, joined;
+            int n = 0;
+            while (n < node.min && cross(run, k.exactSet, joined)) {
+                run.swap(joined);
+                ++n;
+            }
+            if (n == node.min) {
+                out.exact = true;
+                out.exactSet = std::move(run);
+            }
+        }
+        break;
+    }
+    }
+    return out;
+}
+
+struct RegexSet::Cache {
+    std::vector<std::vector<uint32_t>> sets;        // NFA states of each DFA state
+    std::vector<int32_t> next;                      // per state and byte class; -1 until built
+    std::vector<uint8_t> accepting;
+    std::vector<std::vector<uint16_t>> accepts;
+    std::vector<std::vector<uint16_t>> acceptsAtEnd;
+    std::unordered_map<std::string, uint32_t> index;
+    uint32_t start = 0;
+
+    // Scratch
+    std::vector<uint32_t> set, stack, visited;
+    std::vector<uint8_t> seen;
+    std::vector<uint8_t> found;
+};
+
+void RegexSet::validate(std::string_view pattern) {
+    Parser(pattern).parse();
+}
+
+RegexSet::RegexSet(const std::vector<std::string>& patterns, size_t maxStates)
+    : maxStates_(std::max<size_t>(maxStates, 2)) {
+    if (patterns.size() > UINT16_MAX) {
+        throw std::runtime_error("Too many regexes: " + std::to_string(patterns.size()));
+    }
+    std::vector<uint32_t> anchored;
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        Parser parser(patterns[i]);
+        Node root;
+        try {
+            root = parser.parse();
+        } catch (const std::exception& e) {
+            throw std::runtime_error("Bad regex '" + patterns[i] + "': " + e.what());
+        }
+        Parser::Literals lits = Parser::literals(root);
+        const auto& need = Parser::best(lits.required, lits.exact ? lits.exactSet : std::vector<std::string>{});
+        // Single bytes occur in almost every message and would filter nothing
+        required_.push_back(Parser::score(need) >= 2 ? need : std::vector<std::string>{});
+
+        NfaState match(NfaState::Match);
+        match.atEnd = parser.anchoredEnd;
+        match.pattern = static_cast<uint16_t>(i);
+        uint32_t start = compile(root, addState(match));
+        (parser.anchoredStart ? anchored : restarts_).push_back(start);
+    }
+
+    // Byte classes: bytes no pattern tells apart share a column of the DFA
+    std::array<uint16_t, 256> cls{};
+    uint16_t classCount = 1;
+    std::vector<std::bitset<256>> distinct;
+    for (const auto& s : nfa_) {
+        if (s.op == NfaState::Byte && std::find(distinct.begin(), distinct.end(), s.bytes) == distinct.end()) {
+            distinct.push_back(s.bytes);
+        }
+    }
+    for (const auto& bytes : distinct) {
+        std::map<std::pair<uint16_t, bool>, uint16_t> renumber;
+        for (int b = 0; b < 256; ++b) {
+            auto [it, added] = renumber.emplace(std::pair{cls[b], bytes.test(b)}, renumber.size());
+            cls[b] = it->second;
+        }
+        classCount = static_cast<uint16_t>(renumber.size());
+    }
+    representative_.assign(classCount, 0);
+    std::vector<bool> filled(classCount);
+    for (int b = 0; b < 256; ++b) {
+        classes_[b] = static_cast<uint8_t>(cls[b]);
+        if (!filled[cls[b]]) {
+            filled[cls[b]] = true;
+            representative_[cls[b]] = static_cast<unsigned char>(b);
+        }
+    }
+
+    starts_ = restarts_;
+    starts_.insert(starts_.end(), anchored.begin(), anchored.end());
+}
+
+RegexSet::~RegexSet() = default;
+
+uint32_t RegexSet::addState(NfaState state) {
+    if (nfa_.size() >= kMaxNfaStates) throw std::runtime_error("Regexes too large to compile");
+    nfa_.push_back(std::move(state));
+    return static_cast<uint32_t>(nfa_.size() - 1);
+}
+
+// Thompson construction, back to front: returns the entry state of node
+// followed by next
+uint32_t RegexSet::compile(const Node& node, uint32_t next) {
+    switch (node.kind) {
+    case Node::Empty:
+        return next;
+    case Node::Bytes: {
+        NfaState s(NfaState::Byte);
+        s.out = next;
+        s.bytes = node.bytes;
+        return addState(std::move(s));
+    }
+    case Node::Concat:
+        for (auto kid = node.kids.rbegin(); kid != node.kids.rend(); ++kid) next = compile(*kid, next);
+        return next;
+    case Node::Alt: {
+        uint32_t entry = compile(node.kids.back(), next);
+        for (size_t k = node.kids.size() - 1; k-- > 0;) {
+            NfaState split(NfaState::Split);
+            split.out = compile(node.kids[k], next);
+            split.out1 = entry;
+            entry = addState(std::move(split));
+        }
+        return entry;
+    }
+    case Node::Repeat: {
+        const Node& kid = node.kids[0];
+        uint32_t tail = next;
+        if (node.max < 0) {
+            NfaState split(NfaState::Split);
+            split.out1 = next;
+            uint32_t loop = addState(std::move(split));
+            uint32_t body = compile(kid, loop);
+            nfa_[loop].out = body;
+            tail = loop;
+        } else {
+            for (int k = node.min; k < node.max; ++k) {
+                NfaState split(NfaState::Split);
+                split.out = compile(kid, tail);
+                split.out1 = next;
+                tail = addState(std::move(split));
+            }
+        }
+        for (int k = 0; k < node.min; ++k) tail = compile(kid, tail);
+        return tail;
+    }
+    }
+    return next;
+}
+
+// Adds the Byte and Match states reachable from start without input to
+// cache.set; cache.visited collects every state marked in cache.seen
+void RegexSet::closure(Cache& cache, uint32_t start) const {
+    auto& stack = cache.stack;
+    auto& set = cache.set;
+    stack.push_back(start);
+    while (!stack.empty()) {
+        uint32_t s = stack.back();
+        stack.pop_back();
+        if (cache.seen[s]) continue;
+        cache.seen[s] = 1;
+        cache.visited.push_back(s);
+        const NfaState& state = nfa_[s];
+        if (state.op == NfaState::Split) {
+            stack.push_back(state.out1);
+            stack.push_back(state.out);
+        } else {
+            set.push_back(s);
+        }
+    }
+}
+
+void RegexSet::clearSeen(Cache& cache) const {
+    for (uint32_t s : cache.visited) cache.seen[s] = 0;
+    cache.visited.clear();
+}
+
+// Sorts set and returns its key in Cache::index
+std::string RegexSet::stateKey(std::vector<uint32_t>& set) {
+    std::sort(set.begin(), set.end());
+    return std::string(reinterpret_cast<const char*>(set.data()), set.size() * sizeof(uint32_t));
+}
+
+uint32_t RegexSet::addDfaState(Cache& cache, const std::vector<uint32_t>& set, std::string key) const {
+    auto [it, added] = cache.index.emplace(std::move(key), static_cast<uint32_t>(cache.sets.size()));
+    if (!added) return it->second;
+
+    std::vector<uint16_t> accepts, atEnd;
+    for (uint32_t s : set) {
+        if (nfa_[s].op == NfaState::Match) (nfa_[s].atEnd ? atEnd : accepts).push_back(nfa_[s].pattern);
+    }
+    cache.accepting.push_back(!accepts.empty());
+    cache.accepts.push_back(std::move(accepts));
+    cache.acceptsAtEnd.push_back(std::move(atEnd));
+    cache.sets.push_back(set);
+    cache.next.resize(cache.next.size() + representative_.size(), -1);
+    return it->second;
+}
+
+void RegexSet::reset(Cache& cache) const {
+    cache.sets.clear();
+    cache.next.clear();
+    cache.accepting.clear();
+    cache.accepts.clear();
+    cache.acceptsAtEnd.clear();
+    cache.index.clear();
+    cache.seen.assign(nfa_.size(), 0);
+
+    cache.set.clear();
+    for (uint32_t s : starts_) closure(cache, s);
+    clearSeen(cache);
+    cache.start = addDfaState(cache, cache.set, stateKey(cache.set));
+}
+
+// Builds the transition of DFA state from on byte
+uint32_t RegexSet::step(Cache& cache, uint32_t from, unsigned char byte) const {
+    uint8_t cls = classes_[byte];
+    unsigned char rep = representative_[cls];
+    auto& set = cache.set;
+    set.clear();
+    for (uint32_t s : cache.sets[from]) {
+        if (nfa_[s].op == NfaState::Byte && nfa_[s].bytes.test(rep)) closure(cache, nfa_[s].out);
+    }
+    for (uint32_t s : restarts_) closure(cache, s);
+    clearSeen(cache);
+
+    // Only a state that is not cached yet can overflow the cache
+    std::string key = stateKey(set);
+    auto known = cache.index.find(key);
+    uint32_t to;
+    if (known != cache.index.end()) {
+        to = known->second;
+    } else if (cache.sets.size() >= maxStates_) {
+        std::vector<uint32_t> keep = std::move(set);
+        reset(cache);
+        ++cacheResets_;
+        return addDfaState(cache, keep, std::move(key));
+    } else {
+        to = addDfaState(cache, set, std::move(key));
+    }
+    cache.next[from * representative_.size() + cls] = static_cast<int32_t>(to);
+    return to;
+}
+
+std::unique_ptr<RegexSet::Cache> RegexSet::takeCache() const {
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        if (!idle_.empty()) {
+            auto cache = std::move(idle_.back());
+            idle_.pop_back();
+            return cache;
+        }
+    }
+    auto cache = std::make_unique<Cache>();
+    cache->found.assign(size(), 0);
+    reset(*cache);
+    return cache;
+}
+
+void RegexSet::returnCache(std::unique_ptr<Cache> cache) const {
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    idle_.push_back(std::move(cache));
+}
+
+void RegexSet::match(std::string_view text, std::vector<uint16_t>& ids) const {
+    ids.clear();
+    if (required_.empty()) return;
+    auto cache = takeCache();
+    auto report = [&](const std::vector<uint16_t>& patterns) {
+        for (uint16_t p : patterns) {
+            if (!cache->found[p]) {
+                cache->found[p] = 1;
+                ids.push_back(p);
+            }
+        }
+    };
+
+    const size_t stride = representative_.size();
+    uint32_t s = cache->start;
+    if (cache->accepting[s]) report(cache->accepts[s]);
+    for (unsigned char c : text) {
+        int32_t n = cache->next[s * stride + classes_[c]];
+        s = n >= 0 ? static_cast<uint32_t>(n) : step(*cache, s, c);
+        if (cache->accepting[s]) {
+            report(cache->accepts[s]);
+            if (ids.size() == size()) break;
+        }
+    }
+    report(cache->acceptsAtEnd[s]);
+
+    for (uint16_t p : ids) cache->found[p] = 0;
+    std::sort(ids.begin(), ids.end());
+    returnCache(std::move(cache));
+}
+
+RegexSet::Stats RegexSet::stats() const {
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    Stats stats{nfa_.size(), 0, cacheResets_.load()};
+    for (const auto& cache : idle_) stats.dfaStates += cache->sets.size();
+    return stats;
+}
@@ -0,0 +1,371 @@
+#include "rpc_server.hpp"
+#include "json.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace {
+
+constexpr size_t kMaxRequest = 1 << 20;
+
+std::string errnoText(const std::string& what, int err) {
+    return what + ": " + std::strerror(err);
+}
+
+std::string frame(uint64_t id, std::string_view type, std::string_view fields) {
+    std::string out(4, '\0');
+    out += "{\"id\":";
+    out += std::to_string(id);
+    out += ",\"type\":\"";
+    out += type;
+    out += '"';
+    if (!fields.empty()) {
+        out += ',';
+        out += fields;
+    }
+    out += '}';
+    uint32_t size = static_cast<uint32_t>(out.size() - 4);
+    for (int i = 0; i < 4; ++i) out[i] = static_cast<char>(size >> (24 - 8 * i));
+    return out;
+}
+
+std::string errorFields(const std::string& message) {
+    return "\"message\":" + json(message).dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+} // namespace
+
+// Shared by the event loop, which owns fd and in, and the workers
+// streaming replies into out
+struct RpcServer::Stream::Connection {
+    RpcServer& server;
+    int fd;
+    std::string in;
+    bool eof = false;           // the client shut down its side; replies still go out
+
+    std::mutex mutex;
+    std::condition_variable drained;
+    std::deque<std::string> out;
+    size_t outOffset = 0;       // into out.front()
+    size_t outBytes = 0;
+    bool closed = false;
+    std::unordered_map<uint64_t, std::shared_ptr<std::atomic<bool>>> active;
+
+    Connection(RpcServer& server, int fd) : server(server), fd(fd) {}
+
+    // Caller holds mutex
+    void queue(std::string data) {
+        bool wake = out.empty();
+        outBytes += data.size();
+        server.bytesOut_ += data.size();
+        ++server.framesOut_;
+        out.push_back(std::move(data));
+        if (wake) {
+            uint64_t one = 1;
+            [[maybe_unused]] ssize_t n = ::write(server.wakeFd_, &one, sizeof(one));
+        }
+    }
+};
+
+RpcServer::Stream::Stream(std::shared_ptr<Connection> connection, uint64_t id,
+                          std::shared_ptr<std::atomic<bool>> cancelled, size_t maxPending)
+    : connection_(std::move(connection)), id_(id), cancelled_(std::move(cancelled)), maxPending_(maxPending) {}
+
+bool RpcServer::Stream::send(std::string_view type, std::string_view fields) {
+    std::string data = frame(id_, type, fields);
+    std::unique_lock<std::mutex> lock(connection_->mutex);
+    connection_->drained.wait(lock, [&] {
+        return connection_->closed || *cancelled_ || connection_->outBytes < maxPending_;
+    });
+    if (connection_->closed || *cancelled_) return false;
+    connection_->queue(std::move(data));
+    return true;
+}
+
+bool RpcServer::Stream::cancelled() const {
+    return *cancelled_;
+}
+
+RpcServer::RpcServer(Options options, Handler handler) : options_(std::move(options)), handler_(std::move(handler)) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (options_.socketPath.empty() || options_.socketPath.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Invalid socket path: " + options_.socketPath);
+    }
+    std::memcpy(addr.sun_path, options_.socketPath.c_str(), options_.socketPath.size() + 1);
+    std::error_code ec;
+    auto dir = std::filesystem::path(options_.socketPath).parent_path();
+    if (!dir.empty()) std::filesystem::create_directories(dir, ec);
+
+    // A socket file nobody accepts on is left over from a server that died
+    int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool live = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    if (probe >= 0) ::close(probe);
+    if (live) throw std::runtime_error("A server is already listening on " + options_.socketPath);
+    ::unlink(options_.socketPath.c_str());
+
+    listenFd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) throw std::runtime_error(errnoText("socket", errno));
+    // Only the owner may connect: clients get decrypted logs
+    mode_t mask = ::umask(077);
+    int bound = ::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    int err = errno;
+    ::umask(mask);
+    if (bound != 0 || ::listen(listenFd_, SOMAXCONN) != 0) {
+        if (bound == 0) err = errno;
+        ::close(listenFd_);
+        throw std::runtime_error(errnoText("Cannot listen on " + options_.socketPath, err));
+    }
+    wakeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ < 0) {
+        err = errno;
+        ::close(listenFd_);
+        ::unlink(options_.socketPath.c_str());
+        throw std::runtime_error(errnoText("eventfd", err));
+    }
+}
+
+RpcServer::~RpcServer() {
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        closing_ = true;
+    }
+    jobsReady_.notify_all();
+    for (auto& worker : workers_) worker.join();
+    for (auto& connection : connections_) ::close(connection->fd);
+    ::close(listenFd_);
+    ::close(wakeFd_);
+    ::unlink(options_.socketPath.c_str());
+}
+
+void RpcServer::stop() {
+    stopping_ = true;
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = ::write(wakeFd_, &one, sizeof(one));
+}
+
+RpcServer::Stats RpcServer::stats() const {
+    return {clients_, connectionCount_, requests_, errors_, framesOut_, bytesOut_};
+}
+
+void RpcServer::run() {
+    for (size_t i = 0; i < std::max<size_t>(options_.workers, 1); ++i) {
+        workers_.emplace_back([this] { workerLoop(); });
+    }
+
+    std::vector<pollfd> fds;
+    while (!stopping_) {
+        fds.assign({{listenFd_, POLLIN, 0}, {wakeFd_, POLLIN, 0}});
+        for (const auto& connection : connections_) {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            short events = (connection->eof ? 0 : POLLIN) | (connection->out.empty() ? 0 : POLLOUT);
+            fds.push_back({connection->fd, events, 0});
+        }
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(errnoText("poll", errno));
+        }
+        if (fds[1].revents) {
+            uint64_t count;
+            [[maybe_unused]] ssize_t n = ::read(wakeFd_, &count, sizeof(count));
+        }
+
+        for (size_t i = connections_.size(); i-- > 0;) {
+            auto connection = connections_[i];
+            short revents = fds[i + 2].revents;
+            bool open = true;
+            // POLLHUP: both directions are shut, so nothing can be delivered any more
+            if (revents & (POLLHUP | POLLERR)) open = false;
+            else if (revents & POLLIN) open = readFrom(connection);
+            if (open && (revents & POLLOUT)) open = writeTo(*connection);
+            if (open) {
+                std::lock_guard<std::mutex> lock(connection->mutex);
+                open = !(connection->eof && connection->active.empty() && connection->out.empty());
+            }
+            if (!open) {
+                {
+                    std::lock_guard<std::mutex> lock(connection->mutex);
+                    connection->closed = true;
+                    for (auto& [id, cancelled] : connection->active) *cancelled = true;
+                }
+                connection->drained.notify_all();
+                ::close(connection->fd);
+                connections_.erase(connections_.begin() + i);
+                --clients_;
+            }
+        }
+
+        if (fds[0].revents & POLLIN) accept();
+    }
+
+    for (auto& connection : connections_) {
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            connection->closed = true;
+            for (auto& [id, cancelled] : connection->active) *cancelled = true;
+        }
+        connection->drained.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        closing_ = true;
+    }
+    jobsReady_.notify_all();
+    for (auto& worker : workers_) worker.join();
+    workers_.clear();
+}
+
+void RpcServer::accept() {
+    while (true) {
+        int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        if (connections_.size() >= options_.maxClients) {
+            ::close(fd);
+            continue;
+        }
+        connections_.push_back(std::make_shared<Connection>(*this, fd));
+        ++connectionCount_;
+        ++clients_;
+    }
+}
+
+// False once the connection is to be closed
+bool RpcServer::readFrom(const std::shared_ptr<Connection>& self) {
+    Connection& connection = *self;
+    char buffer[65536];
+    while (true) {
+        ssize_t n = ::read(connection.fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            connection.in.append(buffer, n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0) return false;
+        std::lock_guard<std::mutex> lock(connection.mutex);
+        connection.eof = true;
+        break;
+    }
+
+    size_t offset = 0;
+    while (connection.in.size() - offset >= 4) {
+        const auto* p = reinterpret_cast<const unsigned char*>(connection.in.data() + offset);
+        size_t size = (size_t(p[0]) << 24) | (size_t(p[1]) << 16) | (size_t(p[2]) << 8) | p[3];
+        if (size > kMaxRequest) return false;
+        if (connection.in.size() - offset - 4 < size) break;
+        dispatch(self, std::string_view(connection.in).substr(offset + 4, size));
+        offset += 4 + size;
+    }
+    connection.in.erase(0, offset);
+    return true;
+}
+
+bool RpcServer::writeTo(Connection& connection) {
+    std::unique_lock<std::mutex> lock(connection.mutex);
+    while (!connection.out.empty()) {
+        const std::string& front = connection.out.front();
+        // MSG_NOSIGNAL: a client that went away must not kill the server
+        ssize_t n = ::send(connection.fd, front.data() + connection.outOffset, front.size() - connection.outOffset,
+                           MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0) return false;
+        connection.outOffset += n;
+        connection.outBytes -= n;
+        if (connection.outOffset == front.size()) {
+            connection.out.pop_front();
+            connection.outOffset = 0;
+        }
+    }
+    lock.unlock();
+    connection.drained.notify_all();
+    return true;
+}
+
+void RpcServer::dispatch(const std::shared_ptr<Connection>& connection, std::string_view text) {
+    json message = json::parse(text, nullptr, false);
+    if (!message.is_object() || !message.contains("id") || !message["id"].is_number_unsigned()) {
+        reject(*connection, 0, "A request needs an unsigned id");
+        return;
+    }
+    uint64_t id = message["id"].get<uint64_t>();
+    if (!message.contains("method") || !message["method"].is_string()) {
+        reject(*connection, id, "A request needs a method");
+        return;
+    }
+    std::string method = message["method"].get<std::string>();
+
+    std::unique_lock<std::mutex> lock(connection->mutex);
+    auto it = connection->active.find(id);
+    if (method == "cancel") {
+        if (it != connection->active.end()) *it->second = true;
+        lock.unlock();
+        connection->drained.notify_all();
+        return;
+    }
+    if (it != connection->active.end() || connection->active.size() >= options_.maxInFlight) {
+        lock.unlock();
+        reject(*connection, id, it != connection->active.end() ? "Request id already in flight"
+                                                                : "Too many requests in flight");
+        return;
+    }
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    connection->active.emplace(id, cancelled);
+    lock.unlock();
+
+    Request request{id, std::move(method), message.contains("params") ? message["params"].dump() : "{}"};
+    ++requests_;
+    {
+        std::lock_guard<std::mutex> jobsLock(jobsMutex_);
+        jobs_.push_back({connection, std::move(request), std::move(cancelled)});
+    }
+    jobsReady_.notify_one();
+}
+
+void RpcServer::reject(Connection& connection, uint64_t id, const std::string& message) {
+    ++errors_;
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    if (!connection.closed) connection.queue(frame(id, "error", errorFields(message)));
+}
+
+void RpcServer::workerLoop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(jobsMutex_);
+            jobsReady_.wait(lock, [&] { return closing_ || !jobs_.empty(); });
+            if (closing_) return;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        Stream stream(job.connection, job.request.id, job.cancelled, options_.maxPending);
+        try {
+            std::string fields = handler_(job.request, stream);
+            finish(job, !*job.cancelled, *job.cancelled ? errorFields("Cancelled") : fields);
+        } catch (const std::exception& e) {
+            ++errors_;
+            finish(job, false, errorFields(e.what()));
+        }
+    }
+}
+
+// The final frame goes out even past maxPending, so no request is left
+// without an answer
+void RpcServer::finish(const Job& job, bool ok, const std::string& fields) {
+    Connection& connection = *job.connection;
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    connection.active.erase(job.request.id);
+    if (!connection.closed) connection.queue(frame(job.request.id, ok ? "done" : "error", fields));
+}
@@ -0,0 +1,150 @@
+#include "rule_set.hpp"
+#include "config.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+std::vector<RuleSet::Rule> RuleSet::parseRules(std::istream& in) {
+    std::vector<Rule> rules;
+    int number = 0;
+    for (std::string line; std::getline(in, line);) {
+        ++number;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') continue;
+        line.erase(line.find_last_not_of(" \t") + 1);
+        bool regex = line.find_first_of("\\^$.|?*+()[]{}") != std::string::npos;
+        rules.push_back({line.substr(first), regex, number});
+    }
+    return rules;
+}
+
+RuleSet::RuleSet(std::vector<Rule> rules, size_t maxDfaStates) {
+    std::vector<std::string> literals, regexes;
+    for (auto& rule : rules) {
+        if (rule.text.empty()) continue;
+        if (rule.regex) {
+            try {
+                RegexSet::validate(rule.text);
+            } catch (const std::exception& e) {
+                errors_.push_back((rule.line ? "line " + std::to_string(rule.line) + ": " : "") + rule.text + ": " +
+                                  e.what());
+                continue;
+            }
+        }
+        if (rules_.size() >= kRegexHint) throw std::runtime_error("Too many rules");
+        uint16_t id = static_cast<uint16_t>(rules_.size());
+        if (rule.regex) {
+            regexes.push_back(rule.text);
+            regexRule_.push_back(id);
+        } else {
+            literals.push_back(rule.text);
+            literalRule_.push_back(id);
+        }
+        rules_.push_back(std::move(rule));
+    }
+
+    if (!regexes.empty()) {
+        regexes_ = std::make_unique<RegexSet>(regexes, maxDfaStates);
+        for (size_t i = 0; i < regexes.size(); ++i) {
+            const auto& hints = regexes_->requiredLiterals(i);
+            unfiltered_ += hints.empty();
+            for (const auto& hint : hints) {
+                literals.push_back(hint);
+                literalRule_.push_back(kRegexHint);
+            }
+        }
+    }
+    literals_ = std::make_unique<PatternMatcher>(literals);
+}
+
+static std::vector<RuleSet::Rule> configuredRules() {
+    std::vector<RuleSet::Rule> rules;
+    for (const auto& pattern : Config::logging.default_patterns) rules.push_back({pattern, false, 0});
+    std::ifstream file(Config::logging.patterns_file);
+    if (file) {
+        auto extra = RuleSet::parseRules(file);
+        rules.insert(rules.end(), std::make_move_iterator(extra.begin()), std::make_move_iterator(extra.end()));
+    }
+    return rules;
+}
+
+const RuleSet& RuleSet::instance() {
+    static const RuleSet rules(configuredRules(), static_cast<size_t>(Config::logging.regex_cache_states));
+    return rules;
+}
+
+void RuleSet::match(std::string_view text, std::vector<uint16_t>& ids) const {
+    thread_local std::vector<uint16_t> hits;
+    ids.clear();
+    messages_.fetch_add(1, std::memory_order_relaxed);
+    literals_->match(text, hits);
+    bool runRegexes = unfiltered_ > 0;
+    for (uint16_t hit : hits) {
+        uint16_t rule = literalRule_[hit];
+        if (rule == kRegexHint) {
+            runRegexes = true;
+        } else {
+            ids.push_back(rule);
+        }
+    }
+    if (!runRegexes || !regexes_) return;
+
+    regexRuns_.fetch_add(1, std::memory_order_relaxed);
+    regexes_->match(text, hits);
+    for (uint16_t hit : hits) ids.push_back(regexRule_[hit]);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+RuleSet::Stats RuleSet::stats() const {
+    Stats stats{};
+    stats.literals = rules_.size() - regexRule_.size();
+    stats.regexes = regexRule_.size();
+    stats.unfiltered = unfiltered_;
+    stats.messages = messages_.load();
+    stats.regexRuns = regexRuns_.load();
+    if (regexes_) stats.dfa = regexes_->stats();
+    return stats;
+}
+
+namespace {
+
+// Records per thread pool task when a block is big enough to split
+constexpr size_t kTagSlice = 2048;
+
+void tagRange(LogRecord* begin, LogRecord* end, LogArena& arena) {
+    const RuleSet& rules = RuleSet::instance();
+    std::vector<uint16_t> ids;
+    for (LogRecord* record = begin; record != end; ++record) {
+        if (!record->has(LogRecord::Message)) continue;
+        rules.match(record->message, ids);
+        if (ids.empty()) continue;
+        size_t count = std::min<size_t>(ids.size(), UINT8_MAX);
+        uint16_t* tagged = arena.allocateArray<uint16_t>(count);
+        std::copy(ids.begin(), ids.begin() + count, tagged);
+        record->patterns = tagged;
+        record->patternCount = static_cast<uint8_t>(count);
+    }
+}
+
+} // namespace
+
+void tagLogPatterns(std::vector<LogRecord>& records, LogArena& arena) {
+    if (!Config::security.enable_pattern_matching) return;
+    size_t slices = records.size() / kTagSlice;
+    if (slices < 2) {
+        tagRange(records.data(), records.data() + records.size(), arena);
+        return;
+    }
+    std::vector<LogArena> arenas(slices);
+    ThreadPool::Group group(ThreadPool::instance());
+    for (size_t s = 0; s < slices; ++s) {
+        LogRecord* begin = records.data() + s * kTagSlice;
+        LogRecord* end = s + 1 == slices ? records.data() + records.size() : begin + kTagSlice;
+        group.run([begin, end, &sliceArena = arenas[s]] { tagRange(begin, end, sliceArena); });
+    }
+    group.wait();
+    for (auto& sliceArena : arenas) arena.absorb(std::move(sliceArena));
+}
@@ -0,0 +1,640 @@
+#include "segment_store.hpp"
+#include "config.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Segment file layout, little-endian, every section 8-byte aligned:
+//   SegmentHeader
+//   int64  eventIds[count]
+//   int64  timestamps[count]
+//   uint32 lineOffsets[count]    offset of the record in its inflated frame
+//   uint16 types[count]          index into the type names
+//   uint8  fields[count]         LogRecord::Field bits
+//   FrameIndex frames[frameCount]
+//   type names, each NUL-terminated
+//   frame data
+constexpr char kMagic[8] = {'N', 'X', 'S', 'E', 'G', '\0', '\0', '\1'};
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kCompressed = 1;
+constexpr const char* kSuffix = ".lseg";
+constexpr uint32_t kNoBlock = UINT32_MAX;
+constexpr size_t kMergeFanIn = 8;       // short segments merged at once
+
+struct SegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t count;
+    uint32_t stride;
+    uint32_t frameCount;
+    uint32_t typeCount;
+    int64_t minEventId, maxEventId;
+    int64_t minTimestamp, maxTimestamp;
+    uint64_t eventIdsAt, timestampsAt, lineOffsetsAt, typesAt, fieldsAt, framesAt, typeNamesAt, dataAt;
+    uint64_t rawBytes;
+};
+static_assert(sizeof(SegmentHeader) == 136);
+
+struct FrameIndex {
+    int64_t minEventId, maxEventId;
+    int64_t minTimestamp, maxTimestamp;
+    uint64_t dataAt;
+    uint32_t size;
+    uint32_t rawSize;
+};
+static_assert(sizeof(FrameIndex) == 48);
+
+// Empty ranges (no record has the field) have min > max and match nothing
+struct Range {
+    int64_t min = std::numeric_limits<int64_t>::max();
+    int64_t max = std::numeric_limits<int64_t>::min();
+
+    void add(int64_t v) {
+        min = std::min(min, v);
+        max = std::max(max, v);
+    }
+};
+
+size_t align8(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+bool hasTime(uint8_t fields) {
+    return fields & (LogRecord::Timestamp | LogRecord::TimestampText);
+}
+
+} // namespace
+
+struct SegmentStore::Segment {
+    std::string path;
+    uint32_t seq;           // first and last sequence number it holds the
+    uint32_t last;          // records of; more than one after a compaction
+    MappedFile file;
+    const SegmentHeader* header;
+
+    // Maps the segment at path; nullptr if there is no such file
+    static std::unique_ptr<Segment> map(std::string path, uint32_t seq, uint32_t last) {
+        auto file = MappedFile::open(path);
+        if (!file) return nullptr;
+        auto segment = std::make_unique<Segment>();
+        segment->path = std::move(path);
+        segment->seq = seq;
+        segment->last = last;
+        segment->file = std::move(*file);
+        segment->header = segment->at<SegmentHeader>(0);
+        return segment;
+    }
+
+    template <typename T>
+    const T* at(uint64_t offset) const {
+        return reinterpret_cast<const T*>(file.data() + offset);
+    }
+
+    // Throws if the mapping is not a complete segment
+    void validate() const {
+        auto fail = [&] { throw std::runtime_error("Corrupt segment " + path); };
+        if (file.size() < sizeof(SegmentHeader)) fail();
+        const SegmentHeader& h = *header;
+        if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion || h.stride == 0) fail();
+        uint64_t n = h.count;
+        auto within = [&](uint64_t at, uint64_t bytes) { return at % 8 == 0 && at <= file.size() && bytes <= file.size() - at; };
+        if (h.frameCount != (n + h.stride - 1) / h.stride || !within(h.eventIdsAt, n * 8) ||
+            !within(h.timestampsAt, n * 8) || !within(h.lineOffsetsAt, n * 4) || !within(h.typesAt, n * 2) ||
+            !within(h.fieldsAt, n) || !within(h.framesAt, uint64_t(h.frameCount) * sizeof(FrameIndex)) ||
+            h.typeNamesAt > file.size() || h.dataAt > file.size()) {
+            fail();
+        }
+        const FrameIndex* frames = at<FrameIndex>(h.framesAt);
+        for (uint32_t f = 0; f < h.frameCount; ++f) {
+            if (frames[f].dataAt < h.dataAt || frames[f].dataAt > file.size() ||
+                frames[f].size > file.size() - frames[f].dataAt) {
+                fail();
+            }
+        }
+        const uint16_t* types = at<uint16_t>(h.typesAt);
+        for (uint64_t i = 0; i < n; ++i) {
+            if (types[i] >= h.typeCount) fail();
+        }
+    }
+
+    std::vector<std::string_view> typeNames() const {
+        std::vector<std::string_view> names;
+        const char* p = file.data() + header->typeNamesAt;
+        const char* end = file.data() + header->dataAt;
+        for (uint32_t i = 0; i < header->typeCount && p < end; ++i) {
+            size_t len = strnlen(p, end - p);
+            names.emplace_back(p, len);
+            p += len + 1;
+        }
+        names.resize(header->typeCount);
+        return names;
+    }
+
+    std::string inflateFrame(uint32_t f) const {
+        const FrameIndex& frame = at<FrameIndex>(header->framesAt)[f];
+        const char* data = file.data() + frame.dataAt;
+        if (!(header->flags & kCompressed)) return std::string(data, frame.size);
+        std::string raw(frame.rawSize, '\0');
+        uLongf rawSize = frame.rawSize;
+        if (uncompress(reinterpret_cast<Bytef*>(raw.data()), &rawSize, reinterpret_cast<const Bytef*>(data),
+                       frame.size) != Z_OK ||
+            rawSize != frame.rawSize) {
+            throw std::runtime_error("Corrupt frame " + std::to_string(f) + " in " + path);
+        }
+        return raw;
+    }
+
+    // The record at index i as its JSON line, given its inflated frame
+    std::string_view line(const std::string& frame, uint64_t i) const {
+        const uint32_t* offsets = at<uint32_t>(header->lineOffsetsAt);
+        uint64_t end = (i + 1) % header->stride == 0 || i + 1 == header->count ? frame.size() : offsets[i + 1];
+        uint32_t begin = offsets[i];
+        if (begin > end || end > frame.size()) throw std::runtime_error("Corrupt line index in " + path);
+        return std::string_view(frame).substr(begin, end - begin);
+    }
+};
+
+SegmentStore::SegmentStore(Options options) : options_(std::move(options)) {
+    std::error_code ec;
+    fs::create_directories(options_.dir, ec);
+    if (ec) throw std::runtime_error("Cannot create " + options_.dir + ": " + ec.message());
+    load();
+}
+
+SegmentStore::~SegmentStore() = default;
+
+std::unique_ptr<SegmentStore> SegmentStore::fromConfig() {
+    return std::make_unique<SegmentStore>(Options{Config::store.store_dir,
+                                                  static_cast<size_t>(Config::store.segment_records),
+                                                  static_cast<size_t>(Config::store.index_stride),
+                                                  Config::store.compress,
+                                                  Config::store.full_text_index});
+}
+
+void SegmentStore::load() {
+    struct Found {
+        uint32_t seq, last;
+        std::string path;
+    };
+    std::vector<Found> found;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(options_.dir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.find(".tmp.") != std::string::npos) {
+            // Leftover from a seal interrupted by a crash
+            fs::remove(entry.path(), ec);
+            continue;
+        }
+        unsigned seq, last;
+        char suffix[8] = {};
+        if (std::sscanf(name.c_str(), "seg-%8u-%8u%7s", &seq, &last, suffix) == 3) {
+            if (last < seq) continue;
+        } else if (std::sscanf(name.c_str(), "seg-%8u%7s", &seq, suffix) == 2) {
+            last = seq;
+        } else {
+            continue;
+        }
+        if (std::strcmp(suffix, kSuffix) != 0) continue;
+        found.push_back({seq, last, entry.path().string()});
+    }
+    // A compaction's output sorts before the segments it replaced
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) {
+        return a.seq != b.seq ? a.seq < b.seq : a.last > b.last;
+    });
+
+    for (auto& [seq, last, path] : found) {
+        nextSeq_ = std::max(nextSeq_, last + 1);
+        if (!segments_.empty() && seq <= segments_.back()->last) {
+            // Input of a compaction cut short before it was removed
+            if (last <= segments_.back()->last) fs::remove(path, ec);
+            continue;
+        }
+        try {
+            auto segment = Segment::map(path, seq, last);
+            if (!segment) continue;
+            segment->validate();
+            segments_.push_back(std::move(segment));
+        } catch (const std::exception&) {
+            // A damaged segment only costs its own records
+        }
+    }
+
+    // Each line of blocks is a CID followed by the segments holding its
+    // records. A block that lost a segment counts as not stored, so the
+    // next walk stores it again; its records in the surviving segments
+    // then appear twice, as after a crash before the blocks file is written.
+    // Lines without segments predate this and are taken as they are.
+    std::unordered_set<uint32_t> sealed;
+    for (const auto& segment : segments_) {
+        for (uint32_t seq = segment->seq; seq <= segment->last; ++seq) sealed.insert(seq);
+    }
+    std::ifstream blocks(options_.dir + "/blocks");
+    for (std::string line; std::getline(blocks, line);) {
+        std::istringstream fields(line);
+        std::string cid;
+        if (!(fields >> cid)) continue;
+        bool intact = true;
+        for (uint32_t seq; fields >> seq;) intact = intact && sealed.count(seq);
+        if (intact) blocks_.insert(cid);
+    }
+
+    for (const auto& segment : segments_) sealedRecords_ += segment->header->count;
+    if (options_.index) loadIndex();
+}
+
+// Index ids are positions in the store, so an index covering more records
+// than the segments hold no longer lines up and is rebuilt; one covering
+// fewer (a crash between sealing and saving it) is completed
+void SegmentStore::loadIndex() {
+    index_ = std::make_unique<TextIndex>(options_.dir);
+    if (index_->size() > sealedRecords_) index_->clear();
+
+    uint64_t from = index_->size(), id = 0;
+    for (const auto& segment : segments_) {
+        const SegmentHeader& h = *segment->header;
+        if (id + h.count <= from) {
+            id += h.count;
+            continue;
+        }
+        for (uint32_t f = 0; f < h.frameCount; ++f) {
+            uint64_t end = std::min<uint64_t>(h.count, uint64_t(f + 1) * h.stride);
+            if (id + end <= from) continue;
+            std::string frame = segment->inflateFrame(f);
+            LogArena arena;
+            for (uint64_t i = uint64_t(f) * h.stride; i < end; ++i) {
+                if (id + i < from) continue;
+                index_->add(static_cast<uint32_t>(id + i), parseLogRecord(segment->line(frame, i), arena));
+            }
+        }
+        id += h.count;
+    }
+    index_->save();
+}
+
+std::string SegmentStore::segmentPath(uint32_t first, uint32_t last) const {
+    char name[40];
+    if (first == last) {
+        std::snprintf(name, sizeof(name), "seg-%08u%s", first, kSuffix);
+    } else {
+        std::snprintf(name, sizeof(name), "seg-%08u-%08u%s", first, last, kSuffix);
+    }
+    return options_.dir + "/" + name;
+}
+
+void SegmentStore::append(const LogRecord& record, const std::string& cid) {
+    Row row;
+    row.eventId = record.has(LogRecord::EventId) ? record.eventId : 0;
+    row.timestamp = hasTime(record.fields) ? record.timestamp : 0;
+    row.type = record.has(LogRecord::Type) ? std::string(logTypeName(record.typeId)) : std::string();
+    row.fields = record.fields;
+    row.offset = pending_.text.size();
+    appendLogRecordJson(pending_.text, record);
+    row.length = pending_.text.size() - row.offset;
+    // Merged streams interleave blocks, so one may come back after another
+    auto [block, added] = pendingBlockIds_.try_emplace(cid, static_cast<uint32_t>(pendingBlocks_.size()));
+    if (added) pendingBlocks_.push_back({cid, {}});
+    row.block = block->second;
+    if (index_) index_->add(static_cast<uint32_t>(sealedRecords_ + pending_.rows.size()), record);
+    pending_.rows.push_back(std::move(row));
+
+    if (pending_.rows.size() >= options_.segmentRecords) seal();
+}
+
+bool SegmentStore::hasBlock(const std::string& cid) const {
+    return blocks_.count(cid) != 0;
+}
+
+void SegmentStore::flush() {
+    seal();
+    if (index_) index_->save();
+
+    // Blocks are listed only after their records are sealed; a crash in
+    // between costs a duplicate on the next walk, never a lost record
+    std::string added;
+    for (const auto& block : pendingBlocks_) {
+        if (!blocks_.insert(block.cid).second) continue;
+        added += block.cid;
+        for (uint32_t seq : block.segments) added += " " + std::to_string(seq);
+        added += "\n";
+    }
+    pendingBlocks_.clear();
+    pendingBlockIds_.clear();
+    if (!added.empty()) {
+        std::ofstream out(options_.dir + "/blocks", std::ios::app);
+        out << added;
+        if (!out) throw std::runtime_error("Cannot write " + options_.dir + "/blocks");
+    }
+    compact();
+}
+
+void SegmentStore::readRows(const Segment& segment, Pending& out) const {
+    const SegmentHeader& h = *segment.header;
+    auto names = segment.typeNames();
+    const int64_t* ids = segment.at<int64_t>(h.eventIdsAt);
+    const int64_t* times = segment.at<int64_t>(h.timestampsAt);
+    const uint16_t* types = segment.at<uint16_t>(h.typesAt);
+    const uint8_t* fields = segment.at<uint8_t>(h.fieldsAt);
+    for (uint32_t f = 0; f < h.frameCount; ++f) {
+        std::string frame = segment.inflateFrame(f);
+        uint64_t end = std::min<uint64_t>(h.count, uint64_t(f + 1) * h.stride);
+        for (uint64_t i = uint64_t(f) * h.stride; i < end; ++i) {
+            std::string_view line = segment.line(frame, i);
+            out.rows.push_back({ids[i], times[i], std::string(names[types[i]]), fields[i], out.text.size(), line.size(),
+                                kNoBlock});
+            out.text += line;
+        }
+    }
+}
+
+// Writes what is pending as new segments. The store takes each over only
+// once it is committed and mapped, so rows whose write failed stay pending.
+void SegmentStore::seal() {
+    size_t sealed = 0;
+    try {
+        while (sealed < pending_.rows.size()) {
+            size_t count = std::min(options_.segmentRecords, pending_.rows.size() - sealed);
+            uint32_t seq = nextSeq_++;
+            std::string path = segmentPath(seq, seq);
+            writeSegment(path, pending_, sealed, count);
+            auto segment = Segment::map(path, seq, seq);
+            if (!segment) {
+                // Its rows stay pending and must not come back on load
+                std::error_code ec;
+                fs::remove(path, ec);
+                throw std::runtime_error("Cannot map segment " + path);
+            }
+
+            for (size_t i = sealed; i < sealed + count; ++i) {
+                auto& segments = pendingBlocks_[pending_.rows[i].block].segments;
+                if (segments.empty() || segments.back() != seq) segments.push_back(seq);
+            }
+            segments_.push_back(std::move(segment));
+            sealedRecords_ += count;
+            sealed += count;
+        }
+    } catch (...) {
+        pending_.rows.erase(pending_.rows.begin(), pending_.rows.begin() + sealed);
+        throw;
+    }
+    pending_ = Pending{};
+}
+
+// Merges the newest short segments once kMergeFanIn of them qualify. A
+// segment joins only while it holds no more records than the newer ones
+// together, so every merge at least doubles the segment a record is in,
+// and a record is rewritten at most log2(segmentRecords) times.
+void SegmentStore::compact() {
+    size_t end = segments_.size(), begin = end;
+    uint64_t newer = 0;
+    while (begin > 0) {
+        uint64_t count = segments_[begin - 1]->header->count;
+        if (count >= options_.segmentRecords || newer + count > options_.segmentRecords ||
+            (begin < end && count > newer)) {
+            break;
+        }
+        newer += count;
+        --begin;
+    }
+    if (end - begin < kMergeFanIn) return;
+
+    Pending rows;
+    for (size_t i = begin; i < end; ++i) readRows(*segments_[i], rows);
+    uint32_t first = segments_[begin]->seq, last = segments_[end - 1]->last;
+    std::string path = segmentPath(first, last);
+    writeSegment(path, rows, 0, rows.rows.size());
+    auto merged = Segment::map(path, first, last);
+    if (!merged) throw std::runtime_error("Segment " + path + " vanished");
+
+    // From here on the merged segment supersedes its inputs, on load too
+    std::vector<std::string> inputs;
+    for (size_t i = begin; i < end; ++i) inputs.push_back(segments_[i]->path);
+    segments_.erase(segments_.begin() + begin, segments_.end());
+    segments_.push_back(std::move(merged));
+    std::error_code ec;
+    for (const auto& input : inputs) fs::remove(input, ec);
+}
+
+void SegmentStore::writeSegment(const std::string& path, const Pending& pending, size_t first, size_t count) {
+    size_t stride = options_.indexStride;
+    size_t frameCount = (count + stride - 1) / stride;
+
+    SegmentHeader h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.flags = options_.compress ? kCompressed : 0;
+    h.count = static_cast<uint32_t>(count);
+    h.stride = static_cast<uint32_t>(stride);
+    h.frameCount = static_cast<uint32_t>(frameCount);
+
+    std::vector<int64_t> ids(count), times(count);
+    std::vector<uint32_t> offsets(count);
+    std::vector<uint16_t> types(count);
+    std::vector<uint8_t> fields(count);
+    std::vector<FrameIndex> frames(frameCount);
+    std::vector<std::string> typeNames;
+    std::unordered_map<std::string, uint16_t> typeIds;
+    std::vector<std::string> data(frameCount);
+
+    for (size_t f = 0; f < frameCount; ++f) {
+        Range frameIds, frameTimes;
+        std::string raw;
+        for (size_t i = f * stride; i < std::min(count, (f + 1) * stride); ++i) {
+            const Row& row = pending.rows[first + i];
+            ids[i] = row.eventId;
+            times[i] = row.timestamp;
+            fields[i] = row.fields;
+            if (row.fields & LogRecord::EventId) frameIds.add(row.eventId);
+            if (hasTime(row.fields)) frameTimes.add(row.timestamp);
+            auto [it, added] = typeIds.try_emplace(row.type, static_cast<uint16_t>(typeNames.size()));
+            if (added) typeNames.push_back(row.type);
+            types[i] = it->second;
+            offsets[i] = static_cast<uint32_t>(raw.size());
+            raw.append(pending.text, row.offset, row.length);
+        }
+        frames[f] = {frameIds.min, frameIds.max, frameTimes.min, frameTimes.max, 0, 0,
+                     static_cast<uint32_t>(raw.size())};
+        h.rawBytes += raw.size();
+
+        if (options_.compress) {
+            uLongf size = compressBound(raw.size());
+            data[f].resize(size);
+            if (compress2(reinterpret_cast<Bytef*>(data[f].data()), &size, reinterpret_cast<const Bytef*>(raw.data()),
+                          raw.size(), Z_BEST_SPEED) != Z_OK) {
+                throw std::runtime_error("Cannot compress segment frame");
+            }
+            data[f].resize(size);
+        } else {
+            data[f] = std::move(raw);
+        }
+    }
+    Range segmentIds, segmentTimes;
+    for (const auto& frame : frames) {
+        if (frame.minEventId <= frame.maxEventId) {
+            segmentIds.add(frame.minEventId);
+            segmentIds.add(frame.maxEventId);
+        }
+        if (frame.minTimestamp <= frame.maxTimestamp) {
+            segmentTimes.add(frame.minTimestamp);
+            segmentTimes.add(frame.maxTimestamp);
+        }
+    }
+    h.minEventId = segmentIds.min;
+    h.maxEventId = segmentIds.max;
+    h.minTimestamp = segmentTimes.min;
+    h.maxTimestamp = segmentTimes.max;
+
+    std::string names;
+    for (const auto& name : typeNames) {
+        names += name;
+        names += '\0';
+    }
+    h.typeCount = static_cast<uint32_t>(typeNames.size());
+
+    size_t at = align8(sizeof(h));
+    auto place = [&](uint64_t& field, size_t bytes) {
+        field = at;
+        at = align8(at + bytes);
+    };
+    place(h.eventIdsAt, count * 8);
+    place(h.timestampsAt, count * 8);
+    place(h.lineOffsetsAt, count * 4);
+    place(h.typesAt, count * 2);
+    place(h.fieldsAt, count);
+    place(h.framesAt, frameCount * sizeof(FrameIndex));
+    place(h.typeNamesAt, names.size());
+    h.dataAt = at;
+    for (size_t f = 0; f < frameCount; ++f) {
+        frames[f].dataAt = at;
+        frames[f].size = static_cast<uint32_t>(data[f].size());
+        at += data[f].size();
+    }
+
+    AtomicFile file(path);
+    uint64_t written = 0;
+    auto put = [&](uint64_t offset, const void* bytes, size_t len) {
+        static const char zeros[8] = {};
+        if (offset > written) file.write(zeros, offset - written);
+        file.write(static_cast<const char*>(bytes), len);
+        written = offset + len;
+    };
+    put(0, &h, sizeof(h));
+    put(h.eventIdsAt, ids.data(), count * 8);
+    put(h.timestampsAt, times.data(), count * 8);
+    put(h.lineOffsetsAt, offsets.data(), count * 4);
+    put(h.typesAt, types.data(), count * 2);
+    put(h.fieldsAt, fields.data(), count);
+    put(h.framesAt, frames.data(), frameCount * sizeof(FrameIndex));
+    put(h.typeNamesAt, names.data(), names.size());
+    for (size_t f = 0; f < frameCount; ++f) put(frames[f].dataAt, data[f].data(), data[f].size());
+    file.commit();
+}
+
+template <typename Match>
+std::vector<std::string> SegmentStore::scan(Match&& match, size_t limit) const {
+    std::vector<std::string> out;
+    for (const auto& segment : segments_) {
+        const SegmentHeader& h = *segment->header;
+        if (!match.range(h.minEventId, h.maxEventId, h.minTimestamp, h.maxTimestamp)) continue;
+        const FrameIndex* frames = segment->at<FrameIndex>(h.framesAt);
+        const int64_t* ids = segment->at<int64_t>(h.eventIdsAt);
+        const int64_t* times = segment->at<int64_t>(h.timestampsAt);
+        const uint8_t* fields = segment->at<uint8_t>(h.fieldsAt);
+
+        for (uint32_t f = 0; f < h.frameCount; ++f) {
+            const FrameIndex& frame = frames[f];
+            if (!match.range(frame.minEventId, frame.maxEventId, frame.minTimestamp, frame.maxTimestamp)) continue;
+            std::string raw;
+            uint64_t end = std::min<uint64_t>(h.count, uint64_t(f + 1) * h.stride);
+            for (uint64_t i = uint64_t(f) * h.stride; i < end; ++i) {
+                if (!match.record(ids[i], times[i], fields[i])) continue;
+                if (raw.empty()) raw = segment->inflateFrame(f);
+                out.emplace_back(segment->line(raw, i));
+                if (out.size() >= limit) return out;
+            }
+        }
+    }
+    return out;
+}
+
+std::vector<std::string> SegmentStore::findEventId(int64_t eventId) const {
+    struct {
+        int64_t id;
+        bool range(int64_t lo, int64_t hi, int64_t, int64_t) const { return lo <= id && id <= hi; }
+        bool record(int64_t v, int64_t, uint8_t fields) const { return (fields & LogRecord::EventId) && v == id; }
+    } match{eventId};
+    return scan(match, std::numeric_limits<size_t>::max());
+}
+
+std::vector<std::string> SegmentStore::findTimeRange(int64_t from, int64_t to, size_t limit) const {
+    struct {
+        int64_t from, to;
+        bool range(int64_t, int64_t, int64_t lo, int64_t hi) const { return lo <= to && from <= hi && lo <= hi; }
+        bool record(int64_t, int64_t t, uint8_t fields) const { return hasTime(fields) && from <= t && t <= to; }
+    } match{from, to};
+    return scan(match, limit);
+}
+
+void SegmentStore::forEach(const std::function<void(std::string_view)>& visit) const {
+    for (const auto& segment : segments_) {
+        const SegmentHeader& h = *segment->header;
+        for (uint32_t f = 0; f < h.frameCount; ++f) {
+            std::string frame = segment->inflateFrame(f);
+            uint64_t end = std::min<uint64_t>(h.count, uint64_t(f + 1) * h.stride);
+            for (uint64_t i = uint64_t(f) * h.stride; i < end; ++i) {
+                visit(segment->line(frame, i));
+            }
+        }
+    }
+}
+
+SegmentStore::SearchResult SegmentStore::search(std::string_view query, size_t limit) const {
+    if (!index_) throw std::runtime_error("The segment store has no full-text index");
+    std::vector<uint32_t> ids = index_->search(query);
+    // Records still pending have ids but no segment yet
+    ids.erase(std::lower_bound(ids.begin(), ids.end(), sealedRecords_), ids.end());
+
+    SearchResult result{{}, ids.size()};
+    ids.resize(std::min(ids.size(), limit));
+    uint64_t first = 0;
+    auto id = ids.begin();
+    for (const auto& segment : segments_) {
+        const SegmentHeader& h = *segment->header;
+        std::string frame;
+        uint32_t inflated = UINT32_MAX;
+        for (; id != ids.end() && *id < first + h.count; ++id) {
+            uint64_t i = *id - first;
+            uint32_t f = static_cast<uint32_t>(i / h.stride);
+            if (f != inflated) {
+                frame = segment->inflateFrame(f);
+                inflated = f;
+            }
+            result.records.emplace_back(segment->line(frame, i));
+        }
+        first += h.count;
+    }
+    return result;
+}
+
+SegmentStore::Stats SegmentStore::stats() const {
+    Stats stats{segments_.size(), 0, 0, 0, blocks_.size(), {}};
+    if (index_) stats.index = index_->stats();
+    for (const auto& segment : segments_) {
+        stats.records += segment->header->count;
+        stats.diskBytes += segment->file.size();
+        stats.rawBytes += segment->header->rawBytes;
+    }
+    return stats;
+}
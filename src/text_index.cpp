@@ -0,0 +1,386 @@
+#include "text_index.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Index file layout, native byte order:
+//   FileHeader
+//   per term: uint16 length, the term, uint32 count, uint32 base,
+//             uint32 byte length, count varint deltas starting from base
+constexpr char kMagic[8] = {'N', 'X', 'T', 'I', 'X', '\0', '\0', '\1'};
+constexpr const char* kSuffix = ".tix";
+
+struct FileHeader {
+    char magic[8];
+    uint32_t first;         // ids below it are in earlier files; 0 = full index
+    uint32_t end;
+    uint32_t termCount;
+    uint32_t reserved;
+};
+static_assert(sizeof(FileHeader) == 24);
+
+bool tokenByte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80 || c == '.' ||
+           c == '_' || c == '-' || c == '@';
+}
+
+void putVarint(std::string& out, uint32_t v) {
+    while (v >= 0x80) {
+        out += static_cast<char>(v | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+// Unchecked; postings in memory are always well formed
+uint32_t readVarint(const uint8_t*& p) {
+    uint32_t v = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t b = *p++;
+        v |= uint32_t(b & 0x7f) << shift;
+        if (b < 0x80) return v;
+    }
+}
+
+// Checked, for files
+uint32_t readVarint(const uint8_t*& p, const uint8_t* end) {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p == end) break;
+        uint8_t b = *p++;
+        v |= uint32_t(b & 0x7f) << shift;
+        if (b < 0x80) return v;
+    }
+    throw std::runtime_error("Corrupt posting list");
+}
+
+template <typename T>
+T readPod(const char*& p, const char* end) {
+    T v;
+    if (static_cast<size_t>(end - p) < sizeof(T)) throw std::runtime_error("Truncated index file");
+    std::memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return v;
+}
+
+} // namespace
+
+// Walks one posting list in id order
+class TextIndex::Cursor {
+public:
+    explicit Cursor(const Postings& postings)
+        : postings_(&postings), pos_(reinterpret_cast<const uint8_t*>(postings.bytes.data())) {
+        advance();
+    }
+
+    bool done() const { return done_; }
+    uint32_t id() const { return id_; }
+
+    void advance() {
+        if (next_ == postings_->count) {
+            done_ = true;
+            return;
+        }
+        id_ += readVarint(pos_);
+        ++next_;
+    }
+
+    // Moves to the first id >= target, jumping over whole blocks whose ids
+    // are all below it
+    void seek(uint32_t target) {
+        if (done_ || id_ >= target) return;
+        const auto& skips = postings_->skips;
+        auto after = std::partition_point(skips.begin(), skips.end(), [&](const Skip& s) { return s.base < target; });
+        uint32_t block = static_cast<uint32_t>(after - skips.begin());
+        if (block > 0 && block * kBlock > next_) {
+            const Skip& skip = skips[block - 1];
+            pos_ = reinterpret_cast<const uint8_t*>(postings_->bytes.data()) + skip.offset;
+            id_ = skip.base;
+            next_ = block * kBlock;
+            advance();
+        }
+        while (!done_ && id_ < target) advance();
+    }
+
+private:
+    const Postings* postings_;
+    const uint8_t* pos_;
+    uint32_t next_ = 0;     // postings decoded so far
+    uint32_t id_ = 0;
+    bool done_ = false;
+};
+
+TextIndex::TextIndex(std::string dir) : dir_(std::move(dir)) {
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec) throw std::runtime_error("Cannot create " + dir_ + ": " + ec.message());
+    try {
+        load();
+    } catch (const std::exception&) {
+        // Anything unreadable is rebuilt by the caller from size() on
+        clear();
+    }
+}
+
+void TextIndex::tokenize(std::string_view text, std::string& lowered, std::vector<std::string_view>& tokens) {
+    lowered.assign(text);
+    tokens.clear();
+    for (char& c : lowered) {
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    }
+    auto trimmed = [](char c) { return c == '.' || c == '-'; };
+    size_t i = 0, n = lowered.size();
+    while (i < n) {
+        while (i < n && !tokenByte(lowered[i])) ++i;
+        size_t begin = i;
+        while (i < n && tokenByte(lowered[i])) ++i;
+        size_t end = i;
+        while (begin < end && trimmed(lowered[begin])) ++begin;
+        while (end > begin && trimmed(lowered[end - 1])) --end;
+        if (end > begin && end - begin <= kMaxToken) tokens.emplace_back(lowered.data() + begin, end - begin);
+    }
+}
+
+void TextIndex::append(Postings& postings, uint32_t id) {
+    if (postings.count > 0 && postings.count % kBlock == 0) {
+        postings.skips.push_back({postings.last, static_cast<uint32_t>(postings.bytes.size())});
+    }
+    putVarint(postings.bytes, id - postings.last);
+    postings.last = id;
+    ++postings.count;
+}
+
+void TextIndex::add(uint32_t id, const LogRecord& record) {
+    if (id < end_) throw std::runtime_error("Index ids must increase");
+    end_ = id + 1;
+
+    text_.clear();
+    if (record.has(LogRecord::Message)) text_.append(record.message) += ' ';
+    if (record.has(LogRecord::Source)) text_.append(record.source) += ' ';
+    if (record.has(LogRecord::Type)) text_.append(logTypeName(record.typeId));
+    tokenize(text_, lowered_, tokens_);
+    std::sort(tokens_.begin(), tokens_.end());
+    tokens_.erase(std::unique(tokens_.begin(), tokens_.end()), tokens_.end());
+
+    for (std::string_view token : tokens_) {
+        auto it = terms_.find(token);
+        if (it == terms_.end()) it = terms_.emplace(std::string(token), Postings{}).first;
+        append(it->second, id);
+    }
+}
+
+void TextIndex::clear() {
+    terms_.clear();
+    end_ = savedEnd_ = 0;
+    std::error_code ec;
+    for (const auto& path : files_) fs::remove(path, ec);
+    files_.clear();
+}
+
+void TextIndex::save() {
+    if (end_ == savedEnd_) return;
+    writeFile(files_.size() >= kMaxFiles);
+}
+
+// Writes the postings not yet saved, or all of them if full, and drops the
+// files a full write replaces once it is in place
+void TextIndex::writeFile(bool full) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "index-%08u%s", nextSeq_++, kSuffix);
+    std::string path = dir_ + "/" + name;
+
+    FileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.first = full ? 0 : savedEnd_;
+    header.end = end_;
+
+    std::string body;
+    for (const auto& [term, postings] : terms_) {
+        uint32_t from = full ? 0 : postings.saved;
+        if (from == postings.count) continue;
+
+        // Find where posting `from` starts: its block's skip, then decode
+        uint32_t block = from / kBlock;
+        uint32_t base = block ? postings.skips[block - 1].base : 0;
+        const uint8_t* begin = reinterpret_cast<const uint8_t*>(postings.bytes.data());
+        const uint8_t* p = begin + (block ? postings.skips[block - 1].offset : 0);
+        for (uint32_t i = block * kBlock; i < from; ++i) base += readVarint(p);
+
+        uint16_t length = static_cast<uint16_t>(term.size());
+        uint32_t count = postings.count - from;
+        uint32_t bytes = static_cast<uint32_t>(postings.bytes.size() - (p - begin));
+        body.append(reinterpret_cast<const char*>(&length), sizeof(length)).append(term);
+        body.append(reinterpret_cast<const char*>(&count), sizeof(count));
+        body.append(reinterpret_cast<const char*>(&base), sizeof(base));
+        body.append(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+        body.append(reinterpret_cast<const char*>(p), bytes);
+        ++header.termCount;
+    }
+
+    AtomicFile file(path);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(body.data(), body.size());
+    file.commit();
+
+    if (full) {
+        std::error_code ec;
+        for (const auto& old : files_) fs::remove(old, ec);
+        files_.clear();
+    }
+    files_.push_back(path);
+    for (auto& [term, postings] : terms_) postings.saved = postings.count;
+    savedEnd_ = end_;
+}
+
+void TextIndex::load() {
+    std::vector<std::pair<uint32_t, std::string>> found;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir_, ec)) {
+        std::string name = entry.path().filename().string();
+        unsigned seq;
+        char suffix[8] = {};
+        if (std::sscanf(name.c_str(), "index-%8u%7s", &seq, suffix) != 2 || std::strcmp(suffix, kSuffix) != 0) continue;
+        found.emplace_back(seq, entry.path().string());
+    }
+    std::sort(found.begin(), found.end());
+
+    for (size_t f = 0; f < found.size(); ++f) {
+        const auto& [seq, path] = found[f];
+        nextSeq_ = std::max(nextSeq_, seq + 1);
+        std::ifstream in(path, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        const char* p = data.data();
+        const char* end = p + data.size();
+        auto header = readPod<FileHeader>(p, end);
+        if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) throw std::runtime_error("Bad index file " + path);
+
+        if (header.first == 0) {
+            // A full file supersedes everything before it; those are only
+            // left over if a compaction was interrupted
+            for (const auto& old : files_) fs::remove(old, ec);
+            files_.clear();
+            terms_.clear();
+            end_ = 0;
+        } else if (header.first != end_) {
+            // A gap: this and later files cannot be applied
+            for (size_t g = f; g < found.size(); ++g) fs::remove(found[g].second, ec);
+            break;
+        }
+        files_.push_back(path);
+
+        terms_.reserve(terms_.size() + header.termCount);
+        for (uint32_t t = 0; t < header.termCount; ++t) {
+            auto length = readPod<uint16_t>(p, end);
+            if (static_cast<size_t>(end - p) < length) throw std::runtime_error("Truncated index file");
+            std::string_view term(p, length);
+            p += length;
+            auto count = readPod<uint32_t>(p, end);
+            uint32_t id = readPod<uint32_t>(p, end);
+            auto bytes = readPod<uint32_t>(p, end);
+            if (static_cast<size_t>(end - p) < bytes) throw std::runtime_error("Truncated index file");
+            const uint8_t* q = reinterpret_cast<const uint8_t*>(p);
+            const uint8_t* qEnd = q + bytes;
+            p += bytes;
+
+            auto it = terms_.find(term);
+            if (it == terms_.end()) it = terms_.emplace(std::string(term), Postings{}).first;
+            Postings& postings = it->second;
+            if (id != postings.last) throw std::runtime_error("Corrupt posting list");
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t delta = readVarint(q, qEnd);
+                if ((postings.count > 0 || i > 0) && delta == 0) throw std::runtime_error("Corrupt posting list");
+                id += delta;
+                if (id < header.first || id >= header.end) throw std::runtime_error("Corrupt posting list");
+                append(postings, id);
+            }
+        }
+        end_ = header.end;
+    }
+    for (auto& [term, postings] : terms_) postings.saved = postings.count;
+    savedEnd_ = end_;
+}
+
+std::vector<uint32_t> TextIndex::intersect(const std::vector<std::string>& tokens) const {
+    std::vector<const Postings*> lists;
+    for (const auto& token : tokens) {
+        auto it = terms_.find(token);
+        if (it == terms_.end()) return {};
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](const Postings* a, const Postings* b) { return a->count < b->count; });
+    lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+    // Leapfrog: the shortest list proposes an id, every other list seeks to
+    // it, and the first one to overshoot proposes the next
+    std::vector<Cursor> cursors;
+    for (const Postings* postings : lists) cursors.emplace_back(*postings);
+    std::vector<uint32_t> out;
+    uint32_t target = cursors[0].id();
+    while (true) {
+        bool agreed = true;
+        for (auto& cursor : cursors) {
+            cursor.seek(target);
+            if (cursor.done()) return out;
+            if (cursor.id() != target) {
+                target = cursor.id();
+                agreed = false;
+                break;
+            }
+        }
+        if (agreed) {
+            out.push_back(target);
+            cursors[0].advance();
+            if (cursors[0].done()) return out;
+            target = cursors[0].id();
+        }
+    }
+}
+
+std::vector<uint32_t> TextIndex::search(std::string_view query) const {
+    std::vector<std::vector<std::string>> groups(1);
+    bool wantTerm = true;
+    std::string lowered;
+    std::vector<std::string_view> tokens;
+    std::istringstream words{std::string(query)};
+    for (std::string word; words >> word;) {
+        if (word == "AND" || word == "OR") {
+            if (wantTerm) throw std::runtime_error("Expected a term before " + word);
+            if (word == "OR") groups.emplace_back();
+            wantTerm = true;
+            continue;
+        }
+        tokenize(word, lowered, tokens);
+        if (tokens.empty()) throw std::runtime_error("Nothing to search for in '" + word + "'");
+        for (std::string_view token : tokens) groups.back().emplace_back(token);
+        wantTerm = false;
+    }
+    if (wantTerm) throw std::runtime_error(groups.size() == 1 && groups[0].empty() ? "Empty query" : "Query ends in an operator");
+
+    std::vector<uint32_t> ids = intersect(groups[0]);
+    for (size_t g = 1; g < groups.size(); ++g) {
+        std::vector<uint32_t> more = intersect(groups[g]), merged;
+        merged.reserve(ids.size() + more.size());
+        std::set_union(ids.begin(), ids.end(), more.begin(), more.end(), std::back_inserter(merged));
+        ids.swap(merged);
+    }
+    return ids;
+}
+
+TextIndex::Stats TextIndex::stats() const {
+    Stats stats{terms_.size(), 0, 0, files_.size()};
+    for (const auto& [term, postings] : terms_) {
+        stats.postings += postings.count;
+        stats.bytes += postings.bytes.size() + postings.skips.size() * sizeof(Skip);
+    }
+    return stats;
+}
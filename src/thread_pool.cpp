@@ -0,0 +1,164 @@
+#include "thread_pool.hpp"
+#include "config.hpp"
+#include <algorithm>
+
+namespace {
+
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local size_t currentWorker = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t workers) : started_(std::chrono::steady_clock::now()) {
+    workers_.reserve(std::max<size_t>(workers, 1));
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); ++i) workers_.push_back(std::make_unique<Worker>());
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->thread = std::thread(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) worker->thread.join();
+}
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(static_cast<size_t>(std::max(Config::performance.thread_pool_size, 1)));
+    return pool;
+}
+
+void ThreadPool::post(Task task, Priority priority) {
+    size_t target = currentPool == this ? currentWorker : nextWorker_++ % workers_.size();
+    {
+        std::lock_guard<std::mutex> lock(workers_[target]->mutex);
+        workers_[target]->queues[static_cast<size_t>(priority)].push_back(std::move(task));
+        ++queued_;
+    }
+    ++submitted_;
+    // Taking the lock orders this against a worker checking queued_ before
+    // it sleeps
+    { std::lock_guard<std::mutex> lock(sleepMutex_); }
+    wake_.notify_one();
+}
+
+bool ThreadPool::take(size_t self, size_t first, size_t last, Task& task) {
+    if (queued_ == 0) return false;
+    size_t n = workers_.size();
+    for (size_t p = first; p <= last; ++p) {
+        if (self < n) {
+            Worker& own = *workers_[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.queues[p].empty()) {
+                task = std::move(own.queues[p].back());
+                own.queues[p].pop_back();
+                --queued_;
+                return true;
+            }
+        }
+        size_t start = self < n ? self + 1 : nextWorker_.load();
+        for (size_t k = 0; k < n; ++k) {
+            size_t v = (start + k) % n;
+            if (v == self) continue;
+            Worker& victim = *workers_[v];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.queues[p].empty()) {
+                task = std::move(victim.queues[p].front());
+                victim.queues[p].pop_front();
+                --queued_;
+                if (self < n) ++workers_[self]->steals;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t self) {
+    currentPool = this;
+    currentWorker = self;
+    Worker& worker = *workers_[self];
+    Task task;
+    while (true) {
+        if (take(self, 0, kPriorities - 1, task)) {
+            auto start = std::chrono::steady_clock::now();
+            task();
+            task = nullptr;
+            worker.busyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now() - start).count();
+            ++worker.tasks;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        if (stopping_ && queued_ == 0) return;
+        wake_.wait(lock, [&] { return stopping_ || queued_ > 0; });
+    }
+}
+
+bool ThreadPool::runOne(Priority priority) {
+    size_t self = currentPool == this ? currentWorker : workers_.size();
+    Task task;
+    if (!take(self, static_cast<size_t>(priority), static_cast<size_t>(priority), task)) return false;
+    task();
+    ++helped_;
+    return true;
+}
+
+ThreadPool::Stats ThreadPool::stats() const {
+    Stats stats{};
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started_).count();
+    for (const auto& worker : workers_) {
+        stats.workers.push_back({worker->tasks.load(), worker->steals.load(),
+                                 elapsed > 0 ? worker->busyNs.load() / elapsed : 0.0});
+    }
+    stats.submitted = submitted_.load();
+    stats.helped = helped_.load();
+    return stats;
+}
+
+ThreadPool::Group::~Group() {
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+void ThreadPool::Group::run(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++pending_;
+    }
+    pool_.post([this, task = std::move(task)] {
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        // Notified under the lock: the group may be gone once wait() sees 0
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error && !error_) error_ = error;
+        if (--pending_ == 0) done_.notify_all();
+    }, priority_);
+}
+
+// Only tasks of the group's priority are run meanwhile: they include the
+// group's own, and a helper should not be stuck in, say, a network fetch
+void ThreadPool::Group::wait() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (pending_ == 0) break;
+        }
+        if (pool_.runOne(priority_)) continue;
+        // Nothing of ours is queued any more, so the rest is running
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [&] { return pending_ == 0; });
+        break;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
@@ -1,31 +1,67 @@
 #include "utils.hpp"
-#include <openssl/bio.h>
-#include <openssl/evp.h>
-#include <openssl/buffer.h>
-#include "json.hpp"
+#include "base64.hpp"
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
 
 std::vector<unsigned char> base64Decode(const std::string& input) {
-    BIO* bio = BIO_new_mem_buf(input.data(), input.size());
-    BIO* b64 = BIO_new(BIO_f_base64());
-    BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-    bio = BIO_push(b64, bio);
+    std::vector<unsigned char> output(base64MaxDecodedSize(input.size()));
+    output.resize(base64Decode(input.data(), input.size(), output.data()));
+    return output;
+}
 
-    std::vector<unsigned char> output(input.size());
-    int len = BIO_read(bio, output.data(), input.size());
-    output.resize(len);
+AtomicFile::AtomicFile(std::string path) : path_(std::move(path)) {
+    static std::atomic<unsigned> counter{0};
+    tmp_ = path_ + ".tmp." + std::to_string(getpid()) + "." + std::to_string(counter++);
+    fd_ = open(tmp_.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd_ < 0) throw std::runtime_error("Cannot create " + tmp_ + ": " + std::strerror(errno));
+}
 
-    BIO_free_all(bio);
-    return output;
+AtomicFile::~AtomicFile() {
+    if (fd_ >= 0) {
+        close(fd_);
+        unlink(tmp_.c_str());
+    }
+}
+
+void AtomicFile::write(const char* data, size_t len) {
+    if (fd_ < 0) throw std::runtime_error("Write to closed file " + tmp_);
+    while (len > 0) {
+        ssize_t n = ::write(fd_, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Cannot write " + tmp_ + ": " + std::strerror(errno));
+        data += n;
+        len -= n;
+        size_ += n;
+    }
 }
 
-std::vector<nlohmann::json> parseAndSortLogs(const nlohmann::json& logsArray) {
-    std::vector<nlohmann::json> logs;
-    for (const auto& s : logsArray) {
-        logs.push_back(nlohmann::json::parse(s.get<std::string>()));
+void AtomicFile::commit() {
+    if (fd_ < 0) throw std::runtime_error("File " + path_ + " already committed");
+    int synced = fsync(fd_);
+    int closed = close(fd_);
+    fd_ = -1;
+    if (closed != 0 || synced != 0) {
+        unlink(tmp_.c_str());
+        throw std::runtime_error("Cannot sync " + tmp_);
+    }
+    if (rename(tmp_.c_str(), path_.c_str()) != 0) {
+        int err = errno;
+        unlink(tmp_.c_str());
+        throw std::runtime_error("Cannot rename " + tmp_ + ": " + std::strerror(err));
+    }
+
+    // Make the rename itself durable
+    std::string dir = std::filesystem::path(path_).parent_path().string();
+    int dfd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
     }
-    std::sort(logs.begin(), logs.end(), [](const auto& a, const auto& b) {
-        return a["event_id"] > b["event_id"];
-    });
-    return logs;
 }
+
@@ -0,0 +1,117 @@
+import net from 'net';
+import { spawn } from 'child_process';
+
+// Frame from the CLI daemon: {"id", "type", ...}; "done" and "error" end a request
+export interface Frame {
+  id: number;
+  type: string;
+  [key: string]: unknown;
+}
+
+type FrameHandler = (frame: Frame) => void;
+
+// One connection to `cli-netsectool daemon`, shared by every WebSocket
+// client. Messages are 4-byte big-endian lengths followed by JSON; requests
+// are multiplexed by id and their replies streamed back frame by frame.
+export class DaemonClient {
+  private socket: net.Socket | null = null;
+  private connecting: Promise<net.Socket> | null = null;
+  private buffer = Buffer.alloc(0);
+  private nextId = 1;
+  private handlers = new Map<number, FrameHandler>();
+
+  constructor(private socketPath: string, private binary: string, private cwd: string) {}
+
+  // Sends a request; onFrame gets every frame of the reply. Returns its id.
+  async request(method: string, params: object, onFrame: FrameHandler): Promise<number> {
+    const socket = await this.connect();
+    const id = this.nextId++;
+    this.handlers.set(id, onFrame);
+    this.write(socket, { id, method, params });
+    return id;
+  }
+
+  cancel(id: number) {
+    if (this.socket && this.handlers.has(id)) this.write(this.socket, { id, method: 'cancel' });
+  }
+
+  private write(socket: net.Socket, message: object) {
+    const body = Buffer.from(JSON.stringify(message));
+    const header = Buffer.alloc(4);
+    header.writeUInt32BE(body.length);
+    socket.write(Buffer.concat([header, body]));
+  }
+
+  // Starts the daemon if nobody is listening on the socket yet
+  private connect(): Promise<net.Socket> {
+    if (this.socket) return Promise.resolve(this.socket);
+    if (!this.connecting) {
+      this.connecting = this.open(true).finally(() => {
+        this.connecting = null;
+      });
+    }
+    return this.connecting;
+  }
+
+  private open(startDaemon: boolean): Promise<net.Socket> {
+    return new Promise((resolve, reject) => {
+      const socket = net.createConnection(this.socketPath);
+      const failed = (error: Error) => {
+        if (!startDaemon) return reject(error);
+        console.log('Starting the CLI daemon');
+        const daemon = spawn(this.binary, ['daemon', '--socket', this.socketPath], {
+          cwd: this.cwd,
+          detached: true,
+          stdio: 'ignore',
+        });
+        daemon.unref();
+        this.retry(20).then(resolve, reject);
+      };
+      socket.once('error', failed);
+      socket.once('connect', () => {
+        socket.removeListener('error', failed);
+        this.socket = socket;
+        socket.on('data', (chunk) => this.receive(chunk));
+        socket.on('close', () => this.closed());
+        socket.on('error', (error) => console.error('Daemon connection error:', error.message));
+        resolve(socket);
+      });
+    });
+  }
+
+  private async retry(attempts: number): Promise<net.Socket> {
+    for (let i = 0; ; i++) {
+      await new Promise((done) => setTimeout(done, 100));
+      try {
+        return await this.open(false);
+      } catch (error) {
+        if (i + 1 >= attempts) throw error;
+      }
+    }
+  }
+
+  private receive(chunk: Buffer) {
+    this.buffer = this.buffer.length ? Buffer.concat([this.buffer, chunk]) : chunk;
+    let offset = 0;
+    while (this.buffer.length - offset >= 4) {
+      const size = this.buffer.readUInt32BE(offset);
+      if (this.buffer.length - offset - 4 < size) break;
+      const frame: Frame = JSON.parse(this.buffer.toString('utf8', offset + 4, offset + 4 + size));
+      offset += 4 + size;
+      const handler = this.handlers.get(frame.id);
+      if (frame.type === 'done' || frame.type === 'error') this.handlers.delete(frame.id);
+      if (handler) handler(frame);
+    }
+    this.buffer = this.buffer.subarray(offset);
+  }
+
+  // Requests in flight fail; the next request reconnects
+  private closed() {
+    this.socket = null;
+    this.buffer = Buffer.alloc(0);
+    for (const [id, handler] of this.handlers) {
+      handler({ id, type: 'error', message: 'Connection to the daemon was lost' });
+    }
+    this.handlers.clear();
+  }
+}
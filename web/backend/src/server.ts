@@ -1,9 +1,10 @@
 import express from 'express';
 import cors from 'cors';
-import { WebSocketServer } from 'ws';
-import { spawn } from 'child_process';
+import { WebSocketServer, WebSocket } from 'ws';
 import path from 'path';
 import { Server } from 'http';
+import { DaemonClient, Frame } from './daemon';
+import { CliSession, CliEvent } from './session';
 
 const app = express();
 const port = process.env.PORT || 3001;
@@ -12,7 +13,33 @@ app.use(cors());
 app.use(express.json());
 
 // CLI путь относительно корня проекта
-const CLI_PATH = path.join(__dirname, '../../../CLI-NetSecTool');
+const CLI_PATH = path.join(__dirname, '../../..');
+const CLI_BINARY = path.join(CLI_PATH, 'bin/cli-netsectool');
+const DAEMON_SOCKET = process.env.NETSECTOOL_SOCKET || path.join(CLI_PATH, 'cache/daemon.sock');
+
+// Every WebSocket client shares one CLI daemon, its keys and its caches
+const daemon = new DaemonClient(DAEMON_SOCKET, CLI_BINARY, CLI_PATH);
+
+// Maps a terminal command to a daemon request, or to an error answered
+// here; prevCID is where 'fetch --chain' continues for this client. The
+// daemon walks from the IPNS head when given no 'from', so a chain without
+// a previous position is refused as the CLI does.
+function toRequest(
+  command: string,
+  prevCID: string
+): { method: string; params: object } | { error: string } | null {
+  const words = command.trim().split(/\s+/);
+  if (words[0] === 'fetch' && words[1] === '--resolve') return { method: 'resolve', params: {} };
+  if (words[0] === 'fetch' && words[1] === '--chain') {
+    if (!prevCID) return { error: 'No previous logs.' };
+    const depth = words[2] === '--all' ? 0 : words[2] === '--depth' ? Number(words[3]) || 1 : 1;
+    return { method: 'chain', params: { from: prevCID, depth } };
+  }
+  if (words[0] === 'fetch' && words.length === 2) return { method: 'fetch', params: { cid: words[1] } };
+  if (words[0] === 'search' && words.length > 1) return { method: 'search', params: { query: words.slice(1).join(' ') } };
+  if (words[0] === 'stats') return { method: 'stats', params: {} };
+  return null;
+}
 
 // REST API endpoints
 app.get('/api/ipfs/stats', async (req, res) => {
@@ -63,35 +90,75 @@ const server = new Server(app);
 // Настройка WebSocket сервера
 const wss = new WebSocketServer({ server });
 
-wss.on('connection', (ws) => {
+wss.on('connection', (ws: WebSocket) => {
   console.log('New WebSocket connection');
+  let prevCID = '';
+  const inFlight = new Set<number>();
+  let session: CliSession | null = null;
 
-  // Создаем процесс CLI при подключении
-  const cli = spawn('./CLI-NetSecTool', [], { cwd: CLI_PATH });
+  const send = (type: 'output' | 'error', data: string) => {
+    if (ws.readyState === WebSocket.OPEN) ws.send(JSON.stringify({ type, data }));
+  };
 
-  // Отправляем вывод CLI клиенту
-  cli.stdout.on('data', (data) => {
-    ws.send(JSON.stringify({ type: 'output', data: data.toString() }));
-  });
+  const onFrame = (frame: Frame) => {
+    if (frame.type === 'block' || frame.type === 'records') {
+      const records = frame.records as object[];
+      send('output', records.map((record) => JSON.stringify(record)).join('\n') + '\n');
+    } else if (frame.type === 'error') {
+      inFlight.delete(frame.id);
+      send('error', String(frame.message) + '\n');
+    } else if (frame.type === 'done') {
+      inFlight.delete(frame.id);
+      if (typeof frame.cid === 'string') prevCID = frame.cid;
+      if (typeof frame.prev_cid === 'string') prevCID = frame.prev_cid;
+      const { id, type, ...summary } = frame;
+      send('output', JSON.stringify(summary) + '\n');
+    }
+  };
 
-  cli.stderr.on('data', (data) => {
-    ws.send(JSON.stringify({ type: 'error', data: data.toString() }));
-  });
+  // Other commands go to a CLI shell of this client's own
+  const onEvent = (event: CliEvent) => {
+    if (event.event === 'records') {
+      const records = event.records as object[];
+      send('output', records.map((record) => JSON.stringify(record)).join('\n') + '\n');
+    } else if (event.event === 'error') {
+      send('error', String(event.text) + '\n');
+    } else if (event.event === 'prev_cid') {
+      prevCID = String(event.cid);
+    } else if (typeof event.text === 'string') {
+      send('output', event.text.endsWith('\n') ? event.text : event.text + '\n');
+    } else if (event.event === 'alert' || event.event === 'done') {
+      const { event: type, ...fields } = event;
+      send('output', JSON.stringify(type === 'alert' ? event : fields) + '\n');
+    }
+  };
 
   // Обрабатываем команды от клиента
-  ws.on('message', (message) => {
+  ws.on('message', async (message) => {
     try {
       const { command } = JSON.parse(message.toString());
-      cli.stdin.write(command + '\n');
+      const request = toRequest(command, prevCID);
+      if (!request) {
+        if (!session) session = new CliSession(CLI_BINARY, CLI_PATH);
+        session.run(command, onEvent);
+        return;
+      }
+      if ('error' in request) {
+        send('error', request.error + '\n');
+        return;
+      }
+      inFlight.add(await daemon.request(request.method, request.params, onFrame));
     } catch (error) {
       console.error('Failed to process command:', error);
+      send('error', `Failed to reach the CLI daemon: ${(error as Error).message}\n`);
     }
   });
 
   // Очистка при отключении
   ws.on('close', () => {
     console.log('Client disconnected');
-    cli.kill();
+    for (const id of inFlight) daemon.cancel(id);
+    session?.close();
   });
 });
 
@@ -0,0 +1,53 @@
+import { spawn, ChildProcess } from 'child_process';
+import readline from 'readline';
+
+// Event from `cli-netsectool --protocol ndjson`: {"event", ...}; "done" ends a command
+export interface CliEvent {
+  event: string;
+  [key: string]: unknown;
+}
+
+type EventHandler = (event: CliEvent) => void;
+
+// A CLI shell speaking the ndjson protocol, for the commands the daemon does
+// not serve. The CLI answers commands in order, so the reply to each one is
+// every event up to the next "done".
+export class CliSession {
+  private child: ChildProcess | null = null;
+  private waiting: EventHandler[] = [];
+
+  constructor(private binary: string, private cwd: string) {}
+
+  run(command: string, onEvent: EventHandler) {
+    const child = this.start();
+    this.waiting.push(onEvent);
+    child.stdin!.write(command.replace(/[\r\n]+/g, ' ') + '\n');
+  }
+
+  close() {
+    this.child?.stdin!.end();
+    this.child = null;
+  }
+
+  private start(): ChildProcess {
+    if (this.child) return this.child;
+    const child = spawn(this.binary, ['--protocol', 'ndjson'], { cwd: this.cwd, stdio: ['pipe', 'pipe', 'ignore'] });
+    readline.createInterface({ input: child.stdout! }).on('line', (line) => {
+      const event: CliEvent = JSON.parse(line);
+      const handler = this.waiting[0];
+      if (event.event === 'done') this.waiting.shift();
+      if (handler) handler(event);
+    });
+    child.on('error', (error) => console.error('CLI session error:', error.message));
+    // Commands still waiting fail; the next command starts a new shell
+    child.on('close', () => {
+      if (this.child === child) this.child = null;
+      for (const handler of this.waiting.splice(0)) {
+        handler({ event: 'error', text: 'The CLI exited' });
+        handler({ event: 'done', ok: false });
+      }
+    });
+    this.child = child;
+    return child;
+  }
+}